@@ -0,0 +1,553 @@
+/*
+    APEMoST - Automated Parameter Estimation and Model Selection Toolkit
+    Copyright (C) 2009  Johannes Buchner
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <string.h>
+#include <libgen.h>
+#include <omp.h>
+#include <gsl/gsl_rng.h>
+#include "mcmc.h"
+#include "debug.h"
+#include "gsl_helper.h"
+#include "utils.h"
+#include "parallel_tempering.h"
+#include "parallel_tempering_interaction.h"
+#include "define_defaults.h"
+
+#ifndef BENCHMARK_SECONDS
+/**
+ * Minimum duration of each measurement of the benchmark suite, in seconds.
+ */
+#define BENCHMARK_SECONDS 1.0
+#endif
+
+#ifndef BENCHMARK_TOLERANCE
+/**
+ * Relative change that the benchmark comparison reports as regression.
+ */
+#define BENCHMARK_TOLERANCE 0.1
+#endif
+
+#define MAX_METRICS 256
+#define MAX_METRIC_NAME 128
+
+typedef struct {
+	char name[MAX_METRIC_NAME];
+	double value;
+} metric;
+
+char * progname;
+
+void usage() {
+	fprintf(stderr, "SYNOPSIS: %s run <rows> <columns> <output.json>\n"
+		"          %s compare <old.json> <new.json> [<tolerance>]\n"
+		"\n", progname, progname);
+	fprintf(stderr,
+			"run: measures the model and engine speed and writes the results to\n"
+				"\tthe given JSON file. The parameters are read from "
+				PARAMS_FILENAME ".\n"
+				"\tThe data set is made of the given number of rows and columns:\n"
+				"\tIf the file " DATA_FILENAME " exists, its rows are resampled,\n"
+				"\totherwise synthetic values are generated.\n"
+				"\n");
+	fprintf(stderr,
+			"compare: compares the results of two builds and reports changes\n"
+				"\tlarger than the tolerance (default: %.2f) as regressions.\n"
+				"\tExits with status 1 if there are regressions.\n"
+				"\n", BENCHMARK_TOLERANCE);
+	fprintf(stderr,
+			"APEMoST  Copyright (C) 2009  Johannes Buchner\n"
+				"This program comes with ABSOLUTELY NO WARRANTY; for details see the file LICENSE.\n"
+				"This is free software, and you are welcome to redistribute it\n"
+				"under certain conditions; see the file LICENSE.\n");
+	exit(1);
+}
+
+/**
+ * creates a data set of the requested size.
+ */
+static gsl_matrix * create_data(const unsigned int rows,
+		const unsigned int columns, gsl_rng * random) {
+	unsigned int i;
+	unsigned int j;
+	unsigned int k;
+	double x;
+	gsl_matrix * data = gsl_matrix_alloc(rows, columns);
+	mcmc * original;
+
+	if (access(DATA_FILENAME, R_OK) == 0) {
+		original = mcmc_load_params(PARAMS_FILENAME);
+		mcmc_load_data(original, DATA_FILENAME);
+		if (original->data->size2 != columns) {
+			fprintf(stderr, "%s has %d columns, not %d\n", DATA_FILENAME,
+					(int) original->data->size2, columns);
+			exit(1);
+		}
+		for (i = 0; i < rows; i++) {
+			k = gsl_rng_uniform_int(random, original->data->size1);
+			for (j = 0; j < columns; j++) {
+				gsl_matrix_set(data, i, j, gsl_matrix_get(original->data, k,
+						j));
+			}
+		}
+		/* the random number generator is still in use */
+		set_random(original, NULL);
+		original = mcmc_free(original);
+	} else {
+		for (i = 0; i < rows; i++) {
+			x = i * 1.0 / rows;
+			gsl_matrix_set(data, i, 0, x);
+			for (j = 1; j < columns; j++) {
+				gsl_matrix_set(data, i, j, 1 + 0.5 * sin(2 * M_PI * x * (j
+						+ 6)) + 0.1 * gsl_rng_uniform(random));
+			}
+		}
+	}
+	return data;
+}
+
+/**
+ * chains with the betas the sampler would use; each with its own random
+ * number generator, so that they can run in parallel.
+ */
+static mcmc ** create_chains(const mcmc * template, const unsigned int n) {
+	unsigned int i;
+	mcmc ** chains = (mcmc**) mem_calloc(n, sizeof(mcmc*));
+	gsl_rng * random;
+
+	for (i = 0; i < n; i++) {
+		chains[i] = mcmc_clone(template);
+		chains[i]->additional_data = mem_malloc(
+				sizeof(parallel_tempering_mcmc));
+		set_beta(chains[i], get_chain_beta(i, n, BETA_0 < 0 ? 0.001 : BETA_0));
+		random = gsl_rng_alloc(gsl_rng_default);
+		gsl_rng_set(random, gsl_rng_get(get_random(template)) + i);
+		set_random(chains[i], random);
+		calc_model(chains[i], NULL);
+	}
+	return chains;
+}
+
+static void free_chains(mcmc ** chains, const unsigned int n) {
+	unsigned int i;
+	for (i = 0; i < n; i++) {
+		gsl_rng_free(get_random(chains[i]));
+		set_random(chains[i], NULL);
+		mem_free(chains[i]->additional_data);
+		set_data(chains[i], NULL);
+		chains[i] = mcmc_free(chains[i]);
+	}
+	mem_free(chains);
+}
+
+static void step(mcmc * m) {
+#ifdef HMC
+	markov_chain_hmc_step(m);
+#elif defined(ENSEMBLE)
+	markov_chain_ensemble_step(m);
+#else
+	markov_chain_step(m);
+#endif
+}
+
+/**
+ * runs the given operation often enough to last at least
+ * #BENCHMARK_SECONDS.
+ *
+ * @return seconds per operation
+ */
+static double measure(void(*operation)(mcmc ** chains, unsigned int n_beta,
+		unsigned long n), mcmc ** chains, const unsigned int n_beta) {
+	unsigned long n = 16;
+	double start;
+	double duration;
+
+	while (1) {
+		start = omp_get_wtime();
+		operation(chains, n_beta, n);
+		duration = omp_get_wtime() - start;
+		if (duration >= BENCHMARK_SECONDS)
+			return duration / n;
+		n *= 2;
+	}
+}
+
+static void operation_model(mcmc ** chains, unsigned int n_beta,
+		unsigned long n) {
+	unsigned long i;
+	(void) n_beta;
+	for (i = 0; i < n; i++) {
+		calc_model(chains[0], NULL);
+	}
+}
+
+static void operation_proposal(mcmc ** chains, unsigned int n_beta,
+		unsigned long n) {
+	unsigned long i;
+	(void) n_beta;
+	for (i = 0; i < n; i++) {
+		step(chains[0]);
+	}
+}
+
+static void operation_swap(mcmc ** chains, unsigned int n_beta,
+		unsigned long n) {
+	unsigned long i;
+	for (i = 0; i < n; i++) {
+		tempering_interaction(chains, n_beta, i);
+	}
+}
+
+static void operation_dump(mcmc ** chains, unsigned int n_beta,
+		unsigned long n) {
+	unsigned long i;
+	(void) n_beta;
+	mcmc_open_dump_files(chains[0], "-benchmark", 0, "w");
+	for (i = 0; i < n; i++) {
+		mcmc_dump_current(chains[0]);
+	}
+	mcmc_dump_flush(chains[0]);
+}
+
+/**
+ * @return written megabytes per second
+ */
+static double measure_dump(mcmc ** chains) {
+	unsigned int i;
+	unsigned long n = 16;
+	long bytes;
+	double start;
+	double duration;
+	char filename[MAX_METRIC_NAME * 2];
+
+	while (1) {
+		start = omp_get_wtime();
+		operation_dump(chains, 1, n);
+		duration = omp_get_wtime() - start;
+		bytes = 0;
+		for (i = 0; i < get_n_par(chains[0]); i++) {
+			bytes += ftell(chains[0]->files[i]);
+		}
+		mcmc_dump_close(chains[0]);
+		if (duration >= BENCHMARK_SECONDS)
+			break;
+		n *= 2;
+	}
+	for (i = 0; i < get_n_par(chains[0]); i++) {
+		sprintf(filename, "%s-benchmark-0.prob.dump",
+				get_params_descr(chains[0])[i]);
+		remove(filename);
+	}
+	return bytes / duration / 1024 / 1024;
+}
+
+/**
+ * The calibration exits the program if it does not converge, so it runs in
+ * a child process.
+ *
+ * @return seconds, or a negative value if the calibration failed
+ */
+static double measure_calibration(const mcmc * template) {
+	double start;
+	int status;
+	pid_t pid;
+	mcmc ** chains = create_chains(template, 1);
+
+	fflush(NULL);
+	start = omp_get_wtime();
+	pid = fork();
+	if (pid == 0) {
+		markov_chain_calibrate(chains[0], BURN_IN_ITERATIONS,
+				TARGET_ACCEPTANCE_RATE, MAX_AR_DEVIATION, ITER_LIMIT, MUL,
+				DEFAULT_ADJUST_STEP);
+		fflush(NULL);
+		_exit(0);
+	}
+	if (pid < 0 || waitpid(pid, &status, 0) != pid || !WIFEXITED(status)
+			|| WEXITSTATUS(status) != 0) {
+		start = -1;
+	} else {
+		start = omp_get_wtime() - start;
+	}
+	free_chains(chains, 1);
+	return start;
+}
+
+/**
+ * runs the given number of steps on each chain, using the given number of
+ * threads.
+ *
+ * @return seconds
+ */
+static double measure_parallel(const mcmc * template, const int n_threads,
+		const int n_chains, const unsigned long n_steps) {
+	int i;
+	unsigned long j;
+	double start;
+	mcmc ** chains = create_chains(template, n_chains);
+
+	omp_set_num_threads(n_threads);
+	start = omp_get_wtime();
+#pragma omp parallel for private(j)
+	for (i = 0; i < n_chains; i++) {
+		for (j = 0; j < n_steps; j++) {
+			step(chains[i]);
+		}
+	}
+	start = omp_get_wtime() - start;
+	free_chains(chains, n_chains);
+	return start;
+}
+
+static void write_scaling(FILE * f, const mcmc * template, const int weak,
+		const unsigned long n_steps) {
+	int n_threads;
+	const int max_threads = omp_get_max_threads();
+
+	fprintf(f, "\t\"%s_scaling_seconds\": {", weak ? "weak" : "strong");
+	for (n_threads = 1; ; n_threads *= 2) {
+		if (n_threads > max_threads)
+			n_threads = max_threads;
+		printf("%s scaling: %d threads\n", weak ? "weak" : "strong",
+				n_threads);
+		fflush(stdout);
+		fprintf(f, "%s\n\t\t\"%d\": %.6f", n_threads == 1 ? "" : ",",
+				n_threads, measure_parallel(template, n_threads, weak
+						? n_threads : N_BETA, n_steps));
+		if (n_threads == max_threads)
+			break;
+	}
+	omp_set_num_threads(max_threads);
+	fprintf(f, "\n\t}");
+}
+
+static void run(const unsigned int rows, const unsigned int columns,
+		const char * filename) {
+	FILE * f;
+	mcmc * template;
+	mcmc ** chains;
+	double seconds_per_proposal;
+	double seconds;
+	unsigned long n_steps;
+	char * model = basename(progname);
+
+	if (strncmp(model, "benchmark_suite_", strlen("benchmark_suite_")) == 0)
+		model += strlen("benchmark_suite_");
+	if (strchr(model, '.') != NULL)
+		*strchr(model, '.') = 0;
+
+	template = mcmc_load_params(PARAMS_FILENAME);
+	set_data(template, create_data(rows, columns, get_random(template)));
+	mcmc_check(template);
+	template->additional_data = mem_malloc(sizeof(parallel_tempering_mcmc));
+	set_beta(template, 1.0);
+	calc_model(template, NULL);
+
+	f = fopen(filename, "w");
+	if (f == NULL) {
+		perror("could not open output file");
+		exit(1);
+	}
+	fprintf(f, "{\n\t\"model\": \"%s\",\n", model);
+	fprintf(f, "\t\"rows\": %u,\n\t\"columns\": %u,\n", rows, columns);
+	fprintf(f, "\t\"n_par\": %u,\n\t\"n_beta\": %d,\n", get_n_par(template),
+			N_BETA);
+	fprintf(f, "\t\"max_threads\": %d,\n", omp_get_max_threads());
+
+	chains = create_chains(template, N_BETA);
+	printf("measuring model evaluations\n");
+	fflush(stdout);
+	fprintf(f, "\t\"model_ns_per_eval\": %.3f,\n", 1e9 * measure(
+			operation_model, chains, N_BETA));
+	printf("measuring proposals\n");
+	fflush(stdout);
+	seconds_per_proposal = measure(operation_proposal, chains, N_BETA);
+	fprintf(f, "\t\"proposals_per_second\": %.3f,\n", 1 / seconds_per_proposal);
+	printf("measuring swaps\n");
+	fflush(stdout);
+	fprintf(f, "\t\"swaps_per_second\": %.3f,\n", 1 / measure(operation_swap,
+			chains, N_BETA));
+	printf("measuring dumps\n");
+	fflush(stdout);
+	fprintf(f, "\t\"dump_mb_per_second\": %.3f,\n", measure_dump(chains));
+	free_chains(chains, N_BETA);
+
+	printf("measuring calibration\n");
+	fflush(stdout);
+	seconds = measure_calibration(template);
+	if (seconds < 0) {
+		printf("calibration failed\n");
+		fprintf(f, "\t\"calibration_seconds\": null,\n");
+	} else {
+		fprintf(f, "\t\"calibration_seconds\": %.3f,\n", seconds);
+	}
+
+	/* make one chain on one thread last about BENCHMARK_SECONDS / N_BETA */
+	n_steps = BENCHMARK_SECONDS / N_BETA / seconds_per_proposal + 1;
+	write_scaling(f, template, 0, n_steps);
+	fprintf(f, ",\n");
+	write_scaling(f, template, 1, n_steps);
+	fprintf(f, "\n}\n");
+	fclose(f);
+
+	mem_free(template->additional_data);
+	template = mcmc_free(template);
+	printf("results written to %s\n", filename);
+}
+
+/**
+ * reads the numbers of a JSON file. Names of nested objects are joined with
+ * '.'. Strings and arrays are skipped.
+ *
+ * @return number of metrics read
+ */
+static unsigned int read_metrics(const char * filename, metric * metrics) {
+	FILE * f = openfile(filename);
+	char name[MAX_METRIC_NAME] = "";
+	char prefix[MAX_METRIC_NAME] = "";
+	unsigned int prefix_lengths[10];
+	unsigned int depth = 0;
+	unsigned int n = 0;
+	unsigned int len;
+	double value;
+	int c;
+	int is_key = 1;
+
+	while ((c = getc(f)) != EOF) {
+		if (c == '{') {
+			if (depth > 0) {
+				prefix_lengths[depth - 1] = strlen(prefix);
+				if (strlen(prefix) + strlen(name) + 1 < MAX_METRIC_NAME) {
+					strcat(prefix, name);
+					strcat(prefix, ".");
+				}
+			}
+			depth++;
+			assert(depth < 10);
+			is_key = 1;
+		} else if (c == '}') {
+			depth--;
+			if (depth > 0)
+				prefix[prefix_lengths[depth - 1]] = 0;
+			is_key = 0;
+		} else if (c == ',') {
+			is_key = 1;
+		} else if (c == ':') {
+			is_key = 0;
+		} else if (c == '"') {
+			len = 0;
+			while ((c = getc(f)) != EOF && c != '"') {
+				if (len < MAX_METRIC_NAME - 1)
+					name[len++] = c;
+			}
+			name[len] = 0;
+			if (!is_key)
+				name[0] = 0;
+		} else if (!is_key && (c == '-' || (c >= '0' && c <= '9'))) {
+			ungetc(c, f);
+			if (fscanf(f, "%lf", &value) == 1 && n < MAX_METRICS
+					&& strlen(prefix) + strlen(name) < MAX_METRIC_NAME) {
+				strcpy(metrics[n].name, prefix);
+				strcat(metrics[n].name, name);
+				metrics[n].value = value;
+				n++;
+			}
+		}
+	}
+	fclose(f);
+	return n;
+}
+
+/**
+ * throughputs get better when they increase, durations when they decrease.
+ */
+static int higher_is_better(const char * name) {
+	return strstr(name, "per_second") != NULL;
+}
+
+static int is_setting(const char * name) {
+	return strcmp(name, "rows") == 0 || strcmp(name, "columns") == 0
+			|| strcmp(name, "n_par") == 0 || strcmp(name, "n_beta") == 0
+			|| strcmp(name, "max_threads") == 0;
+}
+
+static int compare(const char * old_filename, const char * new_filename,
+		const double tolerance) {
+	metric old_metrics[MAX_METRICS];
+	metric new_metrics[MAX_METRICS];
+	unsigned int n_old = read_metrics(old_filename, old_metrics);
+	unsigned int n_new = read_metrics(new_filename, new_metrics);
+	unsigned int i;
+	unsigned int j;
+	unsigned int regressions = 0;
+	double change;
+
+	printf("%-32s %14s %14s %9s\n", "metric", "old", "new", "change");
+	for (i = 0; i < n_new; i++) {
+		for (j = 0; j < n_old; j++) {
+			if (strcmp(new_metrics[i].name, old_metrics[j].name) == 0)
+				break;
+		}
+		if (j == n_old) {
+			printf("%-32s %14s %14g\n", new_metrics[i].name, "-",
+					new_metrics[i].value);
+			continue;
+		}
+		if (is_setting(new_metrics[i].name)) {
+			if (new_metrics[i].value != old_metrics[j].value)
+				printf("%-32s %14g %14g  settings differ, results are not "
+					"comparable\n", new_metrics[i].name, old_metrics[j].value,
+						new_metrics[i].value);
+			continue;
+		}
+		change = (new_metrics[i].value - old_metrics[j].value)
+				/ old_metrics[j].value;
+		printf("%-32s %14g %14g %+8.1f%%", new_metrics[i].name,
+				old_metrics[j].value, new_metrics[i].value, change * 100);
+		if (!higher_is_better(new_metrics[i].name))
+			change = -change;
+		if (change < -tolerance) {
+			printf("  REGRESSION");
+			regressions++;
+		} else if (change > tolerance) {
+			printf("  improvement");
+		}
+		printf("\n");
+	}
+	printf("%d regressions\n", regressions);
+	return regressions > 0 ? 1 : 0;
+}
+
+int main(int argc, char ** argv) {
+	progname = argv[0];
+
+	if (argc == 5 && strcmp(argv[1], "run") == 0) {
+		if (atoi(argv[2]) <= 0 || atoi(argv[3]) <= 0)
+			usage();
+		run(atoi(argv[2]), atoi(argv[3]), argv[4]);
+	} else if (argc == 4 && strcmp(argv[1], "compare") == 0) {
+		return compare(argv[2], argv[3], BENCHMARK_TOLERANCE);
+	} else if (argc == 5 && strcmp(argv[1], "compare") == 0) {
+		return compare(argv[2], argv[3], atof(argv[4]));
+	} else {
+		usage();
+	}
+	return 0;
+}
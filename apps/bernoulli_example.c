@@ -7,21 +7,29 @@
 
 #define SIGMA 2
 
-void calc_model(mcmc * m, const gsl_vector * old_values) {
+double calc_model_prior(mcmc * m) {
+	unsigned int j;
+	double prior = 0;
+
+	for (j = 1; j < m->data->size2; j++) {
+		prior += -pow(get_params_for(m, j) / SIGMA, 2) / 2;
+	}
+	return prior;
+}
+
+/**
+ * a sum of non-positive terms, so LIKELIHOOD_MAX=0 can be used and the
+ * sum can be stopped once it is below the bound
+ */
+double calc_model_likelihood_bounded(mcmc * m, const double bound) {
 	unsigned int i;
 	unsigned int j;
 	unsigned int n_par = get_n_par(m);
 	double eta_i;
 	double p_i;
 	double l_i;
-	double prior = 0;
 	double prob = 0;
-
-	(void) old_values;
-	for (j = 1; j < m->data->size2; j++) {
-		prior += -pow(get_params_for(m, j) / SIGMA, 2) / 2;
-	}
-	set_prior(m, prior);
+	const double beta = get_beta(m);
 
 	assert(n_par == m->data->size2 - 1 + 1);
 
@@ -42,9 +50,17 @@ void calc_model(mcmc * m, const gsl_vector * old_values) {
 		else
 			l_i = log(p_i);
 		prob += l_i;
+		if (beta * prob < bound)
+			break;
 	}
 
-	set_prob(m, prior + get_beta(m) * prob);
+	return beta * prob;
+}
+
+void calc_model(mcmc * m, const gsl_vector * old_values) {
+	(void) old_values;
+	set_prior(m, calc_model_prior(m));
+	set_prob(m, get_prior(m) + calc_model_likelihood_bounded(m, -HUGE_VAL));
 }
 
 void calc_model_for(mcmc * m, const unsigned int i, const double old_value) {
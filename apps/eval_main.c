@@ -23,6 +23,7 @@
 #include "parallel_tempering.h"
 #include "parallel_tempering_interaction.h"
 #include "define_defaults.h"
+#include "format_double.h"
 
 int main(int argc, char ** argv) {
 	mcmc * m;
@@ -61,7 +62,10 @@ int main(int argc, char ** argv) {
 		}
 		if(i == get_n_par(m)) {
 			calc_model(m, NULL);
-			printf(DUMP_FORMAT "\t" DUMP_FORMAT "\n", get_prob(m), get_prior(m));
+			fprint_double(stdout, get_prob(m));
+			putchar('\t');
+			fprint_double(stdout, get_prior(m));
+			putchar('\n');
 		}
 	}
 	return 0;
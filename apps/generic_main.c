@@ -22,6 +22,11 @@
 #include "debug.h"
 #include "parallel_tempering.h"
 #include "parallel_tempering_interaction.h"
+#include "parallel_tempering_config.h"
+#include "timing.h"
+#include "trace.h"
+#include "parallel_tempering_metrics.h"
+#include "parallel_tempering_control.h"
 
 /**
  * \mainpage
@@ -54,20 +59,42 @@
  * <li>#MUL</li>
  * <li>#N_SWAP</li>
  * <li>#N_PARAMETERS</li>
+ * <li>#SINGLE_PRECISION</li>
+ * <li>#SINGLE_PRECISION_CHECK_INTERVAL</li>
+ * <li>#SINGLE_PRECISION_TOLERANCE</li>
+ * <li>#CACHE_LINE_SIZE</li>
+ * <li>#LIKELIHOOD_MAX</li>
+ * <li>#NUMA</li>
  * <li>#SKIP_CALIBRATE_ALLCHAINS</li>
  * <li>#PROPOSAL</li>
+ * <li>#NESTED_LIVE_POINTS</li>
+ * <li>#NESTED_MCMC_STEPS</li>
+ * <li>#NESTED_PARALLEL</li>
+ * <li>#NESTED_TOLERANCE</li>
  * </ul>
  * \subsection alg Defining algorithm behaviour
  * <ul>
  * <li>#RANDOMSWAP</li>
  * <li>#ADAPT</li>
  * <li>#RWM</li>
+ * <li>#HMC</li>
+ * <li>#ENSEMBLE</li>
+ * <li>#BLOCK_RANDOM</li>
  * </ul>
  * \subsection Running
  * <ul>
  * <li>#MAX_ITERATIONS</li>
  * <li>#DUMP_ALL_CHAINS</li>
  * <li>#PRINT_PROB_INTERVAL</li>
+ * <li>#PHASE_TIMING</li>
+ * <li>#TRACE</li>
+ * <li>#METRICS_PORT</li>
+ * <li>#METRICS_SOCKET</li>
+ * <li>#CONTROL_FIFO</li>
+ * <li>#CHECKPOINT_FILE</li>
+ * <li>#DUMP_PRINTF</li>
+ * <li>#CALIBRATION_CACHE</li>
+ * <li>#CALIBRATION_CACHE_DIR</li>
  * </ul>
  * \subsection Analyzing
  * <ul>
@@ -133,6 +160,16 @@ int main(int argc, char ** argv) {
 				fprintf(stderr, "Did you want to write --append?\n");
 				usage();
 			}
+		} else if (0 == strcmp(argv[1], "batch")) {
+			if (argc == 3)
+				run_batch(argv[2], MAX_ITERATIONS);
+			else {
+				fprintf(stderr, "You are doing it wrong.\n");
+				fprintf(stderr, "Did you forget the manifest file?\n");
+				usage();
+			}
+		} else if (0 == strcmp(argv[1], "nested")) {
+			nested_sampling(MAX_ITERATIONS);
 		} else if (0 == strcmp(argv[1], "analyse")) {
 			if (argc == 3 && strcmp(argv[2], "marginal") == 0)
 				analyse_marginal_distributions();
@@ -168,7 +205,10 @@ void usage() {
 		"\t\tcalibrate_rest \tcalibrate remaining chains (beta < 1)\n"
 		"\t\trun [--append] \tcreate and dump sampling data\n"
 		"\t\t               \twithout adding --append, existing data is overwritten\n"
-		"\t\tanalyse        \tanalyse the available data probability\n"
+		"\t\tanalyse        \tanalyse the available data probability\n");
+	fprintf(stderr,
+		"\t\tbatch <manifest>\trun all phases in each listed directory\n"
+		"\t\tnested         \tmodel probability by nested sampling (no calibration)\n"
 		"\t\thelp <phase>   \tprint more information about a phase\n"
 		"\n");
 	fprintf(stderr,
@@ -266,6 +306,35 @@ void help_phase(char * phase) {
 			"\tmarginal\tcalculate marginal distribution only\n"
 			"\tmodel\tcalculate model probability only\n"
 			"\n");
+	} else if (0 == strcmp(phase, "nested")) {
+		printf("Phase 'nested'\n\n"
+			"Prerequisites: \n"
+			"\tparameters file " PARAMS_FILENAME "\n"
+			"\tdata file " DATA_FILENAME "\n"
+			"\tNESTED_LIVE_POINTS, NESTED_MCMC_STEPS, NESTED_TOLERANCE\n"
+			"Provides: \n"
+			"\tmodel probability with error estimate\n"
+			"\tweighted posterior samples in " NESTED_SAMPLES_FILE "\n"
+			"Does:\n"
+			"\tNested sampling with the limits of the parameters as prior.\n"
+			"\tNo calibration and no tempering ladder is needed. The live\n"
+			"\tpoints are replaced in parallel by constrained Metropolis walks.\n"
+			"\n");
+	} else if (0 == strcmp(phase, "batch")) {
+		printf("Phase 'batch'\n\n"
+			"Prerequisites: \n"
+			"\tmanifest file listing one directory per line\n"
+			"\tparameters file " PARAMS_FILENAME " and data file "
+			DATA_FILENAME " in each\n"
+			"\tMAX_ITERATIONS\n"
+			"Provides: \n"
+			"\tthe results of all phases, in each directory\n"
+			"Does:\n"
+			"\tRuns calibrate_first, calibrate_rest, run and analyse for\n"
+			"\tall directories. Each job is a process using one thread;\n"
+			"\tall threads are kept busy with jobs. Failed jobs are\n"
+			"\treported.\n"
+			"\n");
 	} else {
 		printf("No help available for unknown phase.\n");
 		usage();
@@ -281,11 +350,20 @@ void checkfile(char * filename) {
 #define OUTPUT_PARAMI(P) printf("\t%s: %d\n", #P, P);
 
 void check() {
+#ifdef CALIBRATION_CACHE
+	char cache[FILENAME_MAX];
+	const char * cache_status[] = { "none", "same data", "other data" };
+#endif
 	printf("%s: Checking environment:\n", progname);
 
 	printf("\nFiles:\n");
 	checkfile(PARAMS_FILENAME);
 	checkfile(DATA_FILENAME);
+#ifdef CALIBRATION_CACHE
+	cache[0] = 0;
+	printf("\tcached calibration\t%s %s\n", cache_status[
+			calibration_cache_find(cache)], cache);
+#endif
 
 	printf("\nFine-tuning the algorithm:\n");
 	printf("\tBETA_ALIGNMENT: %s\n", TOSTRING(BETA_ALIGNMENT));
@@ -297,6 +375,10 @@ void check() {
 	OUTPUT_PARAMI(ITER_LIMIT);
 	OUTPUT_PARAMD(MUL);
 	OUTPUT_PARAMI(N_SWAP);
+	OUTPUT_PARAMI(NESTED_LIVE_POINTS);
+	OUTPUT_PARAMI(NESTED_MCMC_STEPS);
+	OUTPUT_PARAMI(NESTED_PARALLEL);
+	OUTPUT_PARAMD(NESTED_TOLERANCE);
 #ifdef SKIP_CALIBRATE_ALLCHAINS
 	printf("\tSKIP_CALIBRATE_ALLCHAINS: enabled (calibrating only 2 chains)\n");
 #else
@@ -315,6 +397,26 @@ void check() {
 #else
 	printf("\tN_PARAMETERS: Compiled for variable number of parameters\n");
 #endif
+	OUTPUT_PARAMI(CACHE_LINE_SIZE);
+	printf("\tLIKELIHOOD_MAX: Rejecting by the prior alone: ");
+#ifdef LIKELIHOOD_MAX
+	printf("below %f\n", (double) LIKELIHOOD_MAX);
+#else
+	printf("only outside of the prior\n");
+#endif
+	printf("\tSINGLE_PRECISION: Single precision copy of the data: ");
+#ifdef SINGLE_PRECISION
+	printf("on, compared to double precision every %d iterations\n",
+			SINGLE_PRECISION_CHECK_INTERVAL);
+#else
+	printf("off\n");
+#endif
+	printf("\tNUMA: Chains and data local to the node of their thread: ");
+#ifdef NUMA
+	printf("on\n");
+#else
+	printf("off\n");
+#endif
 
 	printf("\nDefining algorithm behaviour:\n");
 	printf("\tRANDOMSWAP: Random swapping: ");
@@ -322,6 +424,27 @@ void check() {
 	printf("on\n");
 #else
 	printf("off\n");
+#endif
+	printf("\tHMC: Hamiltonian Monte Carlo: ");
+#ifdef HMC
+	printf("on, %d leapfrog steps\n", HMC_LEAPFROG_STEPS);
+#else
+	printf("off\n");
+#endif
+	printf("\tENSEMBLE: Affine-invariant ensemble sampler: ");
+#ifdef ENSEMBLE
+	if (ENSEMBLE_WALK_SIZE > 0)
+		printf("on, walk move with %d walkers\n", ENSEMBLE_WALK_SIZE);
+	else
+		printf("on, stretch move with a = %f\n", ENSEMBLE_STRETCH);
+#else
+	printf("off\n");
+#endif
+	printf("\tBLOCK_RANDOM: Buffered random numbers: ");
+#ifdef BLOCK_RANDOM
+	printf("on, blocks of %d\n", RANDOM_BLOCK_SIZE);
+#else
+	printf("off\n");
 #endif
 	printf("\tRESET_TO_BEST: Resetting to best: ");
 #ifdef RESET_TO_BEST
@@ -335,6 +458,45 @@ void check() {
 	printf("\tMAX_ITERATIONS: Run indefinitely long\n");
 #endif
 	OUTPUT_PARAMI(PRINT_PROB_INTERVAL);
+	printf("\tPHASE_TIMING: Timing of sampler phases: ");
+#ifdef PHASE_TIMING
+	printf("on, written to %s\n", TIMING_FILE);
+#else
+	printf("off\n");
+#endif
+	printf("\tTRACE: Timeline of the threads: ");
+#ifdef TRACE
+	printf("on, written to %s\n", TRACE_FILE);
+#else
+	printf("off\n");
+#endif
+	printf("\tMETRICS_PORT/METRICS_SOCKET: Prometheus metrics: ");
+#ifdef METRICS_SOCKET
+	printf("served on %s\n", METRICS_SOCKET);
+#elif defined(METRICS_PORT)
+	printf("served on 127.0.0.1:%d\n", METRICS_PORT);
+#else
+	printf("off\n");
+#endif
+	printf("\tCONTROL_FIFO: Commands while running: ");
+#ifdef CONTROL_FIFO
+	printf("read from %s, checkpoints written to %s\n", CONTROL_FIFO,
+			CHECKPOINT_FILE);
+#else
+	printf("off\n");
+#endif
+	printf("\tDUMP_PRINTF: Number output: ");
+#ifdef DUMP_PRINTF
+	printf("printf, %s\n", DUMP_FORMAT);
+#else
+	printf("short round-trip\n");
+#endif
+	printf("\tCALIBRATION_CACHE: Reusing calibrations: ");
+#ifdef CALIBRATION_CACHE
+	printf("on, in %s\n", CALIBRATION_CACHE_DIR);
+#else
+	printf("off\n");
+#endif
 
 	printf("\nDebugging Parameters:\n");
 	printf("\tDEBUG: Debug output: ");
@@ -1,13 +1,23 @@
 #include <gsl/gsl_sf.h>
 
 #include "mcmc.h"
+#include "mcmc_internal.h"
+#include "debug.h"
+#include "markov_chain.h"
 #include "parallel_tempering.h"
+#include "parallel_tempering_interaction.h"
+#include "define_defaults.h"
+#include "apemost.h"
 
 struct Problem {
 	double (*Prior)(mcmc * m, const gsl_vector * old_values);
 	double (*LogLike)(mcmc * m, const gsl_vector * old_values);
 } p;
 
+/**
+ * Sets the model for chains without a context. This is shared by the whole
+ * process; use the functions in apemost.h for independent problems.
+ */
 void set_function(
 	double (*LogLike)(mcmc * m, const gsl_vector * old_values),
 	double (*Prior)(mcmc * m, const gsl_vector * old_values)
@@ -16,9 +26,36 @@ void set_function(
 	p.Prior = Prior;
 }
 
+struct apemost_context {
+	/** holds parameters, limits, step widths and data for the chains */
+	mcmc * prototype;
+	apemost_function loglikelihood;
+	apemost_function prior;
+	void * model_data;
+	apemost_sink sink;
+	void * sink_data;
+	unsigned int n_beta;
+	double beta_0;
+	int n_swap;
+	unsigned long seed;
+	/** NULL until calibrated */
+	mcmc ** chains;
+	volatile int run;
+};
+
 void calc_model(mcmc * m, const gsl_vector * old_values) {
-	set_prior(m, p.Prior(m, old_values));
-	set_prob(m, get_beta(m) * (get_prior(m) + p.LogLike(m,old_values)));
+	const apemost * a = (const apemost *) get_context(m);
+	if (a == NULL) {
+		set_prior(m, p.Prior(m, old_values));
+		set_prob(m, get_beta(m) * (get_prior(m) + p.LogLike(m,old_values)));
+		return;
+	}
+	if (a->prior != NULL)
+		set_prior(m, a->prior(get_params(m), m->data, a->model_data));
+	else
+		set_prior(m, 0);
+	set_prob(m, get_beta(m) * (get_prior(m) + a->loglikelihood(get_params(m),
+			m->data, a->model_data)));
 }
 
 void calc_model_for(mcmc * m, const unsigned int i, const double old_value) {
@@ -28,3 +65,195 @@ void calc_model_for(mcmc * m, const unsigned int i, const double old_value) {
 	calc_model(m, NULL);
 }
 
+apemost * apemost_alloc(unsigned int n_par) {
+	apemost * a = (apemost *) mem_malloc(sizeof(apemost));
+	assert(a != NULL);
+	a->prototype = mcmc_init(n_par);
+	/* the shared generator of mcmc_init is not used */
+	set_random(a->prototype, NULL);
+	set_context(a->prototype, a);
+	a->loglikelihood = NULL;
+	a->prior = NULL;
+	a->model_data = NULL;
+	a->sink = NULL;
+	a->sink_data = NULL;
+	a->n_beta = N_BETA;
+	a->beta_0 = BETA_0;
+	a->n_swap = N_SWAP;
+	a->seed = gsl_rng_default_seed;
+	a->chains = NULL;
+	a->run = 0;
+	return a;
+}
+
+void apemost_set_param(apemost * a, unsigned int i, const char * name,
+		double start, double min, double max, double step) {
+	mcmc * m = a->prototype;
+	assert(i < get_n_par(m));
+	assert(min <= start && start <= max);
+	if (step < 0)
+		step = (max - min) * 0.1;
+	set_params_for(m, start, i);
+	gsl_vector_set(m->params_best, i, start);
+	set_minmax_for(m, min, max, i);
+	set_steps_for(m, step, i);
+	if (m->params_descr[i] != NULL)
+		mem_free(m->params_descr[i]);
+	m->params_descr[i] = my_strdup(name);
+}
+
+void apemost_set_data(apemost * a, const double * values, unsigned long rows,
+		unsigned int columns) {
+	gsl_matrix * data = gsl_matrix_alloc(rows, columns);
+	unsigned long i;
+	unsigned int j;
+	assert(data != NULL);
+	for (i = 0; i < rows; i++) {
+		for (j = 0; j < columns; j++) {
+			gsl_matrix_set(data, i, j, values[i * columns + j]);
+		}
+	}
+	if (a->prototype->data != NULL)
+		gsl_matrix_free((gsl_matrix *) a->prototype->data);
+	if (a->prototype->prepared != NULL)
+		gsl_matrix_free((gsl_matrix *) a->prototype->prepared);
+	if (a->prototype->data_float != NULL)
+		mem_free(a->prototype->data_float);
+	set_data(a->prototype, data);
+}
+
+void apemost_set_model(apemost * a, apemost_function loglikelihood,
+		apemost_function prior, void * user_data) {
+	a->loglikelihood = loglikelihood;
+	a->prior = prior;
+	a->model_data = user_data;
+}
+
+void apemost_set_sink(apemost * a, apemost_sink sink, void * user_data) {
+	a->sink = sink;
+	a->sink_data = user_data;
+}
+
+void apemost_set_chains(apemost * a, unsigned int n_beta, double beta_0,
+		int n_swap) {
+	assert(n_beta > 0);
+	assert(a->chains == NULL);
+	a->n_beta = n_beta;
+	a->beta_0 = beta_0;
+	a->n_swap = n_swap;
+}
+
+void apemost_set_seed(apemost * a, unsigned long seed) {
+	a->seed = seed;
+}
+
+static void free_chains(apemost * a) {
+	unsigned int i;
+	if (a->chains == NULL)
+		return;
+	for (i = 0; i < a->n_beta; i++) {
+		gsl_rng_free(get_random(a->chains[i]));
+		set_random(a->chains[i], NULL);
+		mem_free(a->chains[i]->additional_data);
+		/* owned by the prototype */
+		set_data(a->chains[i], NULL);
+		a->chains[i] = mcmc_free(a->chains[i]);
+	}
+	mem_free(a->chains);
+	a->chains = NULL;
+}
+
+static void setup_context_chains(apemost * a) {
+	unsigned int i;
+	gsl_rng * random;
+
+	free_chains(a);
+	assert(a->loglikelihood != NULL);
+	a->chains = (mcmc **) mem_calloc(a->n_beta, sizeof(mcmc *));
+	assert(a->chains != NULL);
+	for (i = 0; i < a->n_beta; i++) {
+		a->chains[i] = mcmc_clone(a->prototype);
+		random = gsl_rng_alloc(gsl_rng_default);
+		assert(random != NULL);
+		gsl_rng_set(random, a->seed + i);
+		set_random(a->chains[i], random);
+		a->chains[i]->additional_data = mem_malloc(
+				sizeof(parallel_tempering_mcmc));
+		set_beta(a->chains[i], 1);
+		mcmc_check(a->chains[i]);
+	}
+}
+
+void apemost_calibrate(apemost * a) {
+	unsigned int i;
+
+	setup_context_chains(a);
+	calc_model(a->chains[0], NULL);
+	markov_chain_calibrate(a->chains[0], BURN_IN_ITERATIONS,
+			TARGET_ACCEPTANCE_RATE, MAX_AR_DEVIATION, ITER_LIMIT, MUL,
+			DEFAULT_ADJUST_STEP);
+	calibrate_chains(a->chains, a->n_beta, a->beta_0);
+	for (i = 0; i < a->n_beta; i++) {
+		/* the first step must compare against the start values */
+		calc_model(a->chains[i], NULL);
+	}
+}
+
+unsigned long apemost_run(apemost * a, unsigned long max_iterations) {
+	unsigned long iter = 0;
+	unsigned int n_swap;
+	unsigned int subiter;
+	int i;
+	const int n_beta = a->n_beta;
+	mcmc ** chains = a->chains;
+
+	assert(chains != NULL);
+	if (a->n_swap < 0)
+		n_swap = 2000 / n_beta;
+	else
+		n_swap = a->n_swap;
+	a->run = 1;
+	while (a->run && (max_iterations == 0 || iter < max_iterations)) {
+#pragma omp parallel for private(subiter)
+		for (i = 0; i < n_beta; i++) {
+			for (subiter = 0; subiter < n_swap; subiter++) {
+#ifdef HMC
+				markov_chain_hmc_step(chains[i]);
+#elif defined(ENSEMBLE)
+				markov_chain_ensemble_step(chains[i]);
+#else
+				markov_chain_step(chains[i]);
+#endif
+				mcmc_check_best(chains[i]);
+				if (a->sink != NULL)
+					a->sink(i, get_params(chains[i]), get_prob(chains[i]),
+							get_prior(chains[i]), a->sink_data);
+			}
+		}
+		iter += n_swap;
+		tempering_interaction(chains, n_beta, iter);
+	}
+	return iter;
+}
+
+void apemost_stop(apemost * a) {
+	a->run = 0;
+}
+
+const gsl_vector * apemost_best(const apemost * a, double * prob) {
+	const mcmc * m = a->chains != NULL ? a->chains[0] : a->prototype;
+	const gsl_vector * best = get_params_best(m);
+	if (prob != NULL) {
+		/* prob_best may have been exchanged with a hotter chain */
+		*prob = a->loglikelihood(best, m->data, a->model_data);
+		if (a->prior != NULL)
+			*prob += a->prior(best, m->data, a->model_data);
+	}
+	return best;
+}
+
+void apemost_free(apemost * a) {
+	free_chains(a);
+	a->prototype = mcmc_free(a->prototype);
+	mem_free(a);
+}
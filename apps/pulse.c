@@ -22,6 +22,50 @@ static double calc_prior(const mcmc * m) {
 	return -prior / i;
 }
 
+/** profile at each data point, one buffer per thread */
+static float * profile = NULL;
+static unsigned int profile_size = 0;
+#pragma omp threadprivate(profile, profile_size)
+
+/**
+ * single precision version of the loop in calc_model (see
+ * SINGLE_PRECISION). The modes are added up for all data points at once,
+ * which the compiler can vectorize; the sum is done in double precision.
+ */
+static double calc_prob_float(const mcmc * m, const float scale) {
+	unsigned int i;
+	unsigned int j;
+	const unsigned int n = m->data->size1;
+	const float * freq = m->data_float;
+	const float * power = m->data_float + n;
+	float mode_height;
+	float mode_freq;
+	float distance;
+	double prob = 0;
+
+	if (profile_size != n) {
+		if (profile != NULL)
+			mem_free(profile);
+		profile = (float *) mem_malloc(n * sizeof(float));
+		assert(profile != NULL);
+		profile_size = n;
+	}
+	for (i = 0; i < n; i++)
+		profile[i] = 0;
+	for (j = 2; j < get_n_par(m); j += 2) {
+		mode_freq = (float) gsl_vector_get(m->params, j);
+		mode_height = (float) gsl_vector_get(m->params, j + 1);
+		for (i = 0; i < n; i++) {
+			distance = scale * (mode_freq - freq[i]);
+			profile[i] += mode_height / (1 + distance * distance);
+		}
+	}
+	for (i = 0; i < n; i++) {
+		prob += gsl_sf_log(profile[i]) + (double) power[i] / profile[i];
+	}
+	return prob;
+}
+
 void calc_model(mcmc * m, const gsl_vector * old_values) {
 	unsigned int i;
 	unsigned int j;
@@ -32,22 +76,27 @@ void calc_model(mcmc * m, const gsl_vector * old_values) {
 	double freq;
 	const gsl_vector * params = m->params;
 	double prob = gsl_vector_get(params, 1);
-	double lifetime = gsl_vector_get(params, 0);
+	/* converts frequency distances into the width of the Lorentz profile */
+	const double scale = 2 * M_PI * gsl_vector_get(params, 0);
 	set_prior(m, calc_prior(m));
 
 	(void) old_values;
 	assert((get_n_par(m) - 2) % 2 == 0);
-	for (i = 0; i < m->data->size1; i++) {
-		y = 0;
-		freq = gsl_matrix_get(m->data, i, 0);
-		for (j = 2; j < get_n_par(m); j += 2) {
-			mode_freq = gsl_vector_get(params, j);
-			mode_height = gsl_vector_get(params, j + 1);
-			distance = mode_freq - freq;
-			y += mode_height / (1 + pow(2 * M_PI * distance * lifetime, 2));
-		}
+	if (m->data_float != NULL) {
+		prob += calc_prob_float(m, (float) scale);
+	} else {
+		for (i = 0; i < m->data->size1; i++) {
+			y = 0;
+			freq = gsl_matrix_get(m->data, i, 0);
+			for (j = 2; j < get_n_par(m); j += 2) {
+				mode_freq = gsl_vector_get(params, j);
+				mode_height = gsl_vector_get(params, j + 1);
+				distance = scale * (mode_freq - freq);
+				y += mode_height / (1 + distance * distance);
+			}
 
-		prob += gsl_sf_log(y) + gsl_matrix_get(m->data, i, 1) / y;
+			prob += gsl_sf_log(y) + gsl_matrix_get(m->data, i, 1) / y;
+		}
 	}
 
 	set_prob(m, get_prior(m) + -get_beta(m) * prob);
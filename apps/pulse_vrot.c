@@ -32,7 +32,8 @@ void calc_model(mcmc * m, const gsl_vector * old_values) {
 	double freq;
 	const gsl_vector * params = m->params;
 	double prob = gsl_vector_get(params, 1);
-	double lifetime = gsl_vector_get(params, 0);
+	/* converts frequency distances into the width of the Lorentz profile */
+	const double scale = 2 * M_PI * gsl_vector_get(params, 0);
 	double vrot = gsl_vector_get(params, 2);
 	set_prior(m, calc_prior(m));
 
@@ -45,18 +46,18 @@ void calc_model(mcmc * m, const gsl_vector * old_values) {
 		j = 3;
 		mode_freq = gsl_vector_get(params, j);
 		mode_height = gsl_vector_get(params, j + 1);
-		distance = mode_freq - freq;
-		y += mode_height / (1 + pow(2 * M_PI * distance * lifetime, 2));
+		distance = scale * (mode_freq - freq);
+		y += mode_height / (1 + distance * distance);
 
 		j = 5;
 		mode_freq = gsl_vector_get(params, j);
 		mode_height = gsl_vector_get(params, j + 1);
-		distance = mode_freq - freq + -1 * vrot;
-		y += mode_height / (1 + pow(2 * M_PI * distance * lifetime, 2));
-		distance = mode_freq - freq;
-		y += mode_height / (1 + pow(2 * M_PI * distance * lifetime, 2));
-		distance = mode_freq - freq + 1 * vrot;
-		y += mode_height / (1 + pow(2 * M_PI * distance * lifetime, 2));
+		distance = scale * (mode_freq - freq + -1 * vrot);
+		y += mode_height / (1 + distance * distance);
+		distance = scale * (mode_freq - freq);
+		y += mode_height / (1 + distance * distance);
+		distance = scale * (mode_freq - freq + 1 * vrot);
+		y += mode_height / (1 + distance * distance);
 
 		prob += gsl_sf_log(y) + gsl_matrix_get(m->data, i, 1) / y;
 	}
@@ -1,3 +1,4 @@
+#include <assert.h>
 #include <signal.h>
 #include <gsl/gsl_sf.h>
 
@@ -9,31 +10,54 @@
 #define SIGMA 0.5
 #endif
 
+/**
+ * 2 pi x for each data point
+ */
+gsl_matrix * model_prepare(const gsl_matrix * data) {
+	unsigned int i;
+	gsl_matrix * prepared = gsl_matrix_alloc(data->size1, 1);
+	assert(prepared != NULL);
+	for (i = 0; i < data->size1; i++) {
+		gsl_matrix_set(prepared, i, 0, 2.0 * M_PI * gsl_matrix_get(data, i, 0));
+	}
+	return prepared;
+}
+
 double apply_formula(mcmc * m, unsigned int i, double amplitude, double frequency,
-		double phase, double offset) {
-	double x = gsl_matrix_get(m->data, i, 0);
-	double y = amplitude * gsl_sf_sin(2.0 * M_PI * (frequency * x + phase)) + offset;
+		double phase_angle, double offset) {
+	double omega_x = gsl_matrix_get(m->prepared, i, 0);
+	double y = amplitude * gsl_sf_sin(frequency * omega_x + phase_angle) + offset;
 	return y;
 }
 
-void calc_model(mcmc * m, const gsl_vector * old_values) {
+/**
+ * chi-square, stopped once it is too large to be accepted
+ */
+double calc_model_likelihood_bounded(mcmc * m, const double bound) {
 	unsigned int i;
 	double amplitude = gsl_vector_get(m->params, 0);
 	double frequency = gsl_vector_get(m->params, 1);
-	double phase     = gsl_vector_get(m->params, 2);
+	double phase_angle = 2.0 * M_PI * gsl_vector_get(m->params, 2);
 	double offset     = gsl_vector_get(m->params, 3);
+	const double factor = get_beta(m) / (-2 * SIGMA * SIGMA);
 	double y;
 	double deltay;
 	double square_sum = 0;
 
-	(void) old_values;
 	/*dump_v("recalculating model for parameter values", m->params);*/
 	for (i = 0; i < m->data->size1; i++) {
 		y = gsl_matrix_get(m->data, i, 1);
-		deltay = apply_formula(m, i, amplitude, frequency, phase, offset) - y;
+		deltay = apply_formula(m, i, amplitude, frequency, phase_angle, offset) - y;
 		square_sum += deltay * deltay;
+		if (factor * square_sum < bound)
+			break;
 	}
-	set_prob(m, get_beta(m) * square_sum / (-2 * SIGMA * SIGMA));
+	return get_beta(m) * square_sum / (-2 * SIGMA * SIGMA);
+}
+
+void calc_model(mcmc * m, const gsl_vector * old_values) {
+	(void) old_values;
+	set_prob(m, calc_model_likelihood_bounded(m, -HUGE_VAL));
 	/*debug("model done");*/
 }
 
@@ -1,3 +1,4 @@
+#include <assert.h>
 #include <signal.h>
 #include <gsl/gsl_sf.h>
 
@@ -9,9 +10,22 @@
 #define SIGMA 0.5
 #endif
 
+/**
+ * 2 pi x for each data point
+ */
+gsl_matrix * model_prepare(const gsl_matrix * data) {
+	unsigned int i;
+	gsl_matrix * prepared = gsl_matrix_alloc(data->size1, 1);
+	assert(prepared != NULL);
+	for (i = 0; i < data->size1; i++) {
+		gsl_matrix_set(prepared, i, 0, 2.0 * M_PI * gsl_matrix_get(data, i, 0));
+	}
+	return prepared;
+}
+
 double apply_formula(mcmc * m, unsigned int i, double param0, double param1) {
-	double x = gsl_matrix_get(m->data, i, 0);
-	double y = param0 * gsl_sf_sin(2.0 * M_PI * (param1 * x + 0.3312));
+	double omega_x = gsl_matrix_get(m->prepared, i, 0);
+	double y = param0 * gsl_sf_sin(param1 * omega_x + 2.0 * M_PI * 0.3312);
 	return y;
 }
 
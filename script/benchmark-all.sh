@@ -0,0 +1,71 @@
+#!/bin/bash
+
+# 
+# This script runs the benchmark suite for every bundled model on 
+# synthetic data and writes one JSON file per model into the output 
+# directory.
+# 
+# The benchmark programs have to be built first ("make benchmarks").
+# 
+# usage: 
+#   benchmark-all.sh <outputdir> [<rows>]
+#   benchmark-all.sh compare <olddir> <newdir> [<tolerance>]
+# 
+
+mcmcdir=$(cd $(dirname $0)/.. && pwd)
+models="simplesin pulse pulse_vrot bernoulli_example normal"
+
+if [ "$1" == "compare" ]; then
+	status=0
+	for model in $models; do
+		[ -f "$2/$model.json" ] && [ -f "$3/$model.json" ] || continue
+		echo "== $model"
+		$mcmcdir/benchmark_suite_$model.exe compare "$2/$model.json" "$3/$model.json" $4 || status=1
+	done
+	exit $status
+fi
+
+if [ "$1" == "" ]; then
+	echo "usage: $0 <outputdir> [<rows>]" >&2
+	echo "       $0 compare <olddir> <newdir> [<tolerance>]" >&2
+	exit 1
+fi
+mkdir -p "$1"
+outdir=$(cd "$1" && pwd)
+rows=${2:-1000}
+
+# params file and number of data columns for each model
+params_simplesin="1	0	2	amplitude	-1
+0.2	0	0.3	frequency	-1
+0	0	1	phase	-1
+0	-1	1	offset	-1"
+columns_simplesin=2
+params_pulse="0.5	0.01	10	lifetime	-1
+0	-10	10	noise	-1
+0.3	0	1	freq1	-1
+1	0	10	height1	-1
+0.6	0	1	freq2	-1
+1	0	10	height2	-1"
+columns_pulse=2
+params_pulse_vrot="0.5	0.01	10	lifetime	-1
+0	-10	10	noise	-1
+0.01	0	0.1	vrot	-1
+0.3	0	1	freq1	-1
+1	0	10	height1	-1
+0.6	0	1	freq2	-1
+1	0	10	height2	-1"
+columns_pulse_vrot=2
+params_bernoulli_example="0	-10	10	intercept	-1
+0	-10	10	slope	-1"
+columns_bernoulli_example=2
+params_normal="1	-10	30	x	-1"
+columns_normal=2
+
+for model in $models; do
+	echo "== $model"
+	dir=$(mktemp -d)
+	eval "echo \"\$params_$model\"" > $dir/params
+	eval "columns=\$columns_$model"
+	( cd $dir && $mcmcdir/benchmark_suite_$model.exe run $rows $columns $outdir/$model.json ) > $outdir/$model.log || echo "$model failed, see $outdir/$model.log"
+	rm -rf $dir
+done
@@ -52,7 +52,7 @@ void analyse_data_probability() {
 		dump_s("summing up probability file", buf);
 		printf("reading probabilities of chain %d\r", i);
 		fflush(stdout);
-		f = fopen(buf, "r");
+		f = job_fopen(buf, "r");
 		if (f == NULL) {
 			fprintf(stderr,
 					"calculating data probability failed: file %s not found\n",
@@ -92,6 +92,10 @@ void analyse_data_probability() {
 		previous_beta = get_beta(chains[j]);
 	}
 
+	print_data_probability(data_logprob);
+}
+
+void print_data_probability(const double data_logprob) {
 	printf("Model probability ln(p(D|M, I)): [about 10^%.0f] %.5f"
 		"\n"
 		"\nTable to compare support against other models (Jeffrey):\n"
@@ -225,7 +229,7 @@ void calc_marginal_distribution(mcmc ** chains, unsigned int n_beta,
 	gsl_histogram_scale(h, (gsl_vector_get(max, 0) - gsl_vector_get(min, 0))
 			/ nbins / iter);
 
-	outfile = fopen(outfilename, "w");
+	outfile = job_fopen(outfilename, "w");
 	debug("writing histogram... ");
 	assert(outfile != NULL);
 	gsl_histogram_fprintf(outfile, h, DUMP_FORMAT, DUMP_FORMAT);
@@ -267,7 +271,7 @@ void analyse_marginal_distributions() {
 		calc_marginal_distribution(chains, n_beta, i, find_minmax);
 	}
 
-	plotplate = fopen("marginal_distributions.gnuplot", "w");
+	plotplate = job_fopen("marginal_distributions.gnuplot", "w");
 	assert(plotplate != NULL);
 	fprintf(plotplate, "# set terminal png size %d,%d; set output "
 		"\"marginal_distributions.png\"\n", 600, 300 * get_n_par(chains[0]));
@@ -25,4 +25,6 @@ void analyse_marginal_distributions();
 
 void analyse_data_probability();
 
+void print_data_probability(const double data_logprob);
+
 #endif /* PARALLEL_TEMPERING_H_ */
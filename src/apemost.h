@@ -0,0 +1,150 @@
+/*
+    APEMoST - Automated Parameter Estimation and Model Selection Toolkit
+    Copyright (C) 2009  Johannes Buchner
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef APEMOST_H_
+#define APEMOST_H_
+
+#include <gsl/gsl_vector.h>
+#include <gsl/gsl_matrix.h>
+
+/**
+ * Library interface of libapemost.so for embedding the sampler.
+ *
+ * Everything belonging to one problem (parameters, data, model, chains,
+ * output) is kept in a context, so independent problems can be run
+ * concurrently in one process, each from its own thread.
+ *
+ * A typical use:
+ * <pre>
+ * apemost * a = apemost_alloc(2);
+ * apemost_set_param(a, 0, "amplitude", 1, 0, 2, -1);
+ * apemost_set_param(a, 1, "offset", 0, -1, 1, -1);
+ * apemost_set_data(a, values, rows, columns);
+ * apemost_set_model(a, loglikelihood, NULL, my_data);
+ * apemost_set_sink(a, write_sample, my_file);
+ * apemost_calibrate(a);
+ * apemost_run(a, 100000);
+ * apemost_free(a);
+ * </pre>
+ *
+ * The compile-time settings (e.g. #BURN_IN_ITERATIONS, #ITER_LIMIT,
+ * #TARGET_ACCEPTANCE_RATE) still apply to all contexts. #ADAPT and #RWM are
+ * not applied by apemost_run().
+ */
+typedef struct apemost_context apemost;
+
+/**
+ * logarithmic likelihood or prior of the parameter values.
+ *
+ * Called concurrently for different chains of the same context.
+ *
+ * @param data the data given with apemost_set_data()
+ * @param user_data as given to apemost_set_model()
+ */
+typedef double (*apemost_function)(const gsl_vector * params,
+		const gsl_matrix * data, void * user_data);
+
+/**
+ * receives each visited point of a chain.
+ *
+ * Called concurrently for different chains of the same context.
+ *
+ * @param chain index of the chain, 0 is the chain with beta = 1
+ * @param prob beta * (prior + loglikelihood) of the point
+ * @param prior prior of the point, not multiplied by beta
+ * @param user_data as given to apemost_set_sink()
+ */
+typedef void (*apemost_sink)(unsigned int chain, const gsl_vector * params,
+		double prob, double prior, void * user_data);
+
+/**
+ * creates a context for a problem with n_par parameters.
+ *
+ * #N_BETA chains are used, with #BETA_0 and #N_SWAP.
+ */
+apemost * apemost_alloc(unsigned int n_par);
+
+/**
+ * sets start value, limits and step width of parameter i.
+ * A negative step width uses 10% of the parameter space.
+ */
+void apemost_set_param(apemost * a, unsigned int i, const char * name,
+		double start, double min, double max, double step);
+
+/**
+ * copies the data (rows x columns, row by row).
+ */
+void apemost_set_data(apemost * a, const double * values, unsigned long rows,
+		unsigned int columns);
+
+/**
+ * @param prior may be NULL for a flat prior
+ */
+void apemost_set_model(apemost * a, apemost_function loglikelihood,
+		apemost_function prior, void * user_data);
+
+/**
+ * @param sink may be NULL to not receive the visited points
+ */
+void apemost_set_sink(apemost * a, apemost_sink sink, void * user_data);
+
+/**
+ * @param n_beta number of chains
+ * @param beta_0 beta of the hottest chain, negative for automatic
+ * @param n_swap iterations between swaps, negative for automatic
+ */
+void apemost_set_chains(apemost * a, unsigned int n_beta, double beta_0,
+		int n_swap);
+
+/**
+ * seed of the random number generators; chain i uses seed + i.
+ * The default is taken from GSL_RNG_SEED.
+ */
+void apemost_set_seed(apemost * a, unsigned long seed);
+
+/**
+ * calibrates the step widths and betas of all chains
+ * (calibrate_first and calibrate_rest).
+ */
+void apemost_calibrate(apemost * a);
+
+/**
+ * runs the calibrated sampler until the given number of iterations has
+ * been done (0 for no limit) or apemost_stop() is called.
+ * Can be called again to continue.
+ *
+ * @return number of iterations done in this call
+ */
+unsigned long apemost_run(apemost * a, unsigned long max_iterations);
+
+/**
+ * makes apemost_run() return after the current iteration.
+ * Can be called from another thread or a signal handler.
+ */
+void apemost_stop(apemost * a);
+
+/**
+ * @param prob if not NULL, receives the probability (likelihood and prior)
+ * of the best values
+ * @return best parameter values found by the chain with beta = 1
+ */
+const gsl_vector * apemost_best(const apemost * a, double * prob);
+
+void apemost_free(apemost * a);
+
+#endif /* APEMOST_H_ */
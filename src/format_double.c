@@ -0,0 +1,364 @@
+/*
+    APEMoST - Automated Parameter Estimation and Model Selection Toolkit
+    Copyright (C) 2009  Johannes Buchner
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+#include <limits.h>
+
+#include "mcmc.h"
+#include "format_double.h"
+
+/*
+ * Grisu2 by Florian Loitsch, "Printing Floating-Point Numbers Quickly and
+ * Accurately with Integers" (PLDI 2010). Needs 64 bit integers; otherwise
+ * printf with 17 digits is used.
+ */
+#if ULONG_MAX > 0xffffffffUL
+
+#define HIDDEN_BIT 0x0010000000000000UL
+#define SIGNIFICAND_MASK 0x000fffffffffffffUL
+#define SIGNIFICAND_SIZE 52
+#define EXPONENT_BIAS 1075
+
+/** significand and binary exponent: f * 2^e */
+typedef struct {
+	unsigned long f;
+	int e;
+} diy_fp;
+
+/**
+ * normalized 10^k for k = -348, -340, ..., 340, rounded to 64 bits.
+ * Generated with exact rational arithmetic.
+ */
+static const unsigned long cached_powers_f[] = {
+		0xfa8fd5a0081c0288UL, 0xbaaee17fa23ebf76UL, 0x8b16fb203055ac76UL,
+		0xcf42894a5dce35eaUL, 0x9a6bb0aa55653b2dUL, 0xe61acf033d1a45dfUL,
+		0xab70fe17c79ac6caUL, 0xff77b1fcbebcdc4fUL, 0xbe5691ef416bd60cUL,
+		0x8dd01fad907ffc3cUL, 0xd3515c2831559a83UL, 0x9d71ac8fada6c9b5UL,
+		0xea9c227723ee8bcbUL, 0xaecc49914078536dUL, 0x823c12795db6ce57UL,
+		0xc21094364dfb5637UL, 0x9096ea6f3848984fUL, 0xd77485cb25823ac7UL,
+		0xa086cfcd97bf97f4UL, 0xef340a98172aace5UL, 0xb23867fb2a35b28eUL,
+		0x84c8d4dfd2c63f3bUL, 0xc5dd44271ad3cdbaUL, 0x936b9fcebb25c996UL,
+		0xdbac6c247d62a584UL, 0xa3ab66580d5fdaf6UL, 0xf3e2f893dec3f126UL,
+		0xb5b5ada8aaff80b8UL, 0x87625f056c7c4a8bUL, 0xc9bcff6034c13053UL,
+		0x964e858c91ba2655UL, 0xdff9772470297ebdUL, 0xa6dfbd9fb8e5b88fUL,
+		0xf8a95fcf88747d94UL, 0xb94470938fa89bcfUL, 0x8a08f0f8bf0f156bUL,
+		0xcdb02555653131b6UL, 0x993fe2c6d07b7facUL, 0xe45c10c42a2b3b06UL,
+		0xaa242499697392d3UL, 0xfd87b5f28300ca0eUL, 0xbce5086492111aebUL,
+		0x8cbccc096f5088ccUL, 0xd1b71758e219652cUL, 0x9c40000000000000UL,
+		0xe8d4a51000000000UL, 0xad78ebc5ac620000UL, 0x813f3978f8940984UL,
+		0xc097ce7bc90715b3UL, 0x8f7e32ce7bea5c70UL, 0xd5d238a4abe98068UL,
+		0x9f4f2726179a2245UL, 0xed63a231d4c4fb27UL, 0xb0de65388cc8ada8UL,
+		0x83c7088e1aab65dbUL, 0xc45d1df942711d9aUL, 0x924d692ca61be758UL,
+		0xda01ee641a708deaUL, 0xa26da3999aef774aUL, 0xf209787bb47d6b85UL,
+		0xb454e4a179dd1877UL, 0x865b86925b9bc5c2UL, 0xc83553c5c8965d3dUL,
+		0x952ab45cfa97a0b3UL, 0xde469fbd99a05fe3UL, 0xa59bc234db398c25UL,
+		0xf6c69a72a3989f5cUL, 0xb7dcbf5354e9beceUL, 0x88fcf317f22241e2UL,
+		0xcc20ce9bd35c78a5UL, 0x98165af37b2153dfUL, 0xe2a0b5dc971f303aUL,
+		0xa8d9d1535ce3b396UL, 0xfb9b7cd9a4a7443cUL, 0xbb764c4ca7a44410UL,
+		0x8bab8eefb6409c1aUL, 0xd01fef10a657842cUL, 0x9b10a4e5e9913129UL,
+		0xe7109bfba19c0c9dUL, 0xac2820d9623bf429UL, 0x80444b5e7aa7cf85UL,
+		0xbf21e44003acdd2dUL, 0x8e679c2f5e44ff8fUL, 0xd433179d9c8cb841UL,
+		0x9e19db92b4e31ba9UL, 0xeb96bf6ebadf77d9UL, 0xaf87023b9bf0ee6bUL };
+static const int cached_powers_e[] = {
+		-1220, -1193, -1166, -1140, -1113, -1087, -1060, -1034, -1007, -980,
+		-954, -927, -901, -874, -847, -821, -794, -768, -741, -715,
+		-688, -661, -635, -608, -582, -555, -529, -502, -475, -449,
+		-422, -396, -369, -343, -316, -289, -263, -236, -210, -183,
+		-157, -130, -103, -77, -50, -24, 3, 30, 56, 83,
+		109, 136, 162, 189, 216, 242, 269, 295, 322, 348,
+		375, 402, 428, 455, 481, 508, 534, 561, 588, 614,
+		641, 667, 694, 720, 747, 774, 800, 827, 853, 880,
+		907, 933, 960, 986, 1013, 1039, 1066 };
+
+static const unsigned long powers_of_ten[] = { 1UL, 10UL, 100UL, 1000UL,
+		10000UL, 100000UL, 1000000UL, 10000000UL, 100000000UL, 1000000000UL,
+		10000000000UL, 100000000000UL, 1000000000000UL, 10000000000000UL,
+		100000000000000UL, 1000000000000000UL, 10000000000000000UL,
+		100000000000000000UL, 1000000000000000000UL, 10000000000000000000UL };
+
+static diy_fp make_fp(const unsigned long f, const int e) {
+	diy_fp r;
+	r.f = f;
+	r.e = e;
+	return r;
+}
+
+static diy_fp multiply(const diy_fp x, const diy_fp y) {
+	const unsigned long m32 = 0xffffffffUL;
+	const unsigned long a = x.f >> 32;
+	const unsigned long b = x.f & m32;
+	const unsigned long c = y.f >> 32;
+	const unsigned long d = y.f & m32;
+	const unsigned long ac = a * c;
+	const unsigned long bc = b * c;
+	const unsigned long ad = a * d;
+	const unsigned long bd = b * d;
+	unsigned long tmp = (bd >> 32) + (ad & m32) + (bc & m32);
+	/* round */
+	tmp += 1UL << 31;
+	return make_fp(ac + (ad >> 32) + (bc >> 32) + (tmp >> 32), x.e + y.e + 64);
+}
+
+static diy_fp normalize(diy_fp x) {
+	while (!(x.f & (1UL << 63))) {
+		x.f <<= 1;
+		x.e--;
+	}
+	return x;
+}
+
+/**
+ * the boundaries m- and m+ of the interval of values that round to v,
+ * with the same exponent
+ */
+static void normalized_boundaries(const diy_fp v, diy_fp * minus,
+		diy_fp * plus) {
+	diy_fp p = make_fp((v.f << 1) + 1, v.e - 1);
+	diy_fp m;
+	while (!(p.f & (HIDDEN_BIT << 1))) {
+		p.f <<= 1;
+		p.e--;
+	}
+	p.f <<= 64 - SIGNIFICAND_SIZE - 2;
+	p.e -= 64 - SIGNIFICAND_SIZE - 2;
+	if (v.f == HIDDEN_BIT)
+		m = make_fp((v.f << 2) - 1, v.e - 2);
+	else
+		m = make_fp((v.f << 1) - 1, v.e - 1);
+	m.f <<= m.e - p.e;
+	m.e = p.e;
+	*minus = m;
+	*plus = p;
+}
+
+/**
+ * a cached power c = 10^-K, so that the product with a number of binary
+ * exponent e has its exponent in [-60, -32]
+ */
+static diy_fp cached_power(const int e, int * K) {
+	const double dk = (-61 - e) * 0.30102999566398114 + 347;
+	int k = (int) dk;
+	unsigned int index;
+	if (dk - k > 0.0)
+		k++;
+	index = (unsigned int) ((k >> 3) + 1);
+	*K = -(-348 + (int) (index << 3));
+	return make_fp(cached_powers_f[index], cached_powers_e[index]);
+}
+
+static unsigned int count_digits(const unsigned int n) {
+	unsigned int i;
+	for (i = 1; i < 10; i++) {
+		if (n < powers_of_ten[i])
+			return i;
+	}
+	return 10;
+}
+
+/** moves the last digit towards w, as long as it stays in the interval */
+static void grisu_round(char * buffer, const int len, const unsigned long delta,
+		unsigned long rest, const unsigned long ten_kappa,
+		const unsigned long wp_w) {
+	while (rest < wp_w && delta - rest >= ten_kappa && (rest + ten_kappa
+			< wp_w || wp_w - rest > rest + ten_kappa - wp_w)) {
+		buffer[len - 1]--;
+		rest += ten_kappa;
+	}
+}
+
+static void digit_gen(const diy_fp w, const diy_fp mp, unsigned long delta,
+		char * buffer, int * len, int * K) {
+	const diy_fp one = make_fp(1UL << -mp.e, mp.e);
+	const unsigned long wp_w = mp.f - w.f;
+	unsigned int p1 = (unsigned int) (mp.f >> -one.e);
+	unsigned long p2 = mp.f & (one.f - 1);
+	int kappa = count_digits(p1);
+	unsigned int d;
+	unsigned long tmp;
+
+	*len = 0;
+	while (kappa > 0) {
+		d = p1 / (unsigned int) powers_of_ten[kappa - 1];
+		p1 %= (unsigned int) powers_of_ten[kappa - 1];
+		if (d || *len)
+			buffer[(*len)++] = (char) ('0' + d);
+		kappa--;
+		tmp = ((unsigned long) p1 << -one.e) + p2;
+		if (tmp <= delta) {
+			*K += kappa;
+			grisu_round(buffer, *len, delta, tmp,
+					powers_of_ten[kappa] << -one.e, wp_w);
+			return;
+		}
+	}
+	while (1) {
+		p2 *= 10;
+		delta *= 10;
+		d = (unsigned int) (p2 >> -one.e);
+		if (d || *len)
+			buffer[(*len)++] = (char) ('0' + d);
+		p2 &= one.f - 1;
+		kappa--;
+		if (p2 < delta) {
+			*K += kappa;
+			grisu_round(buffer, *len, delta, p2, one.f, -kappa < 20 ? wp_w
+					* powers_of_ten[-kappa] : 0);
+			return;
+		}
+	}
+}
+
+/**
+ * digits of a positive, finite v, and the decimal exponent K:
+ * v = digits * 10^K
+ */
+static void grisu2(const double value, char * buffer, int * length, int * K) {
+	unsigned long bits;
+	diy_fp v;
+	diy_fp w_m;
+	diy_fp w_p;
+	diy_fp c_mk;
+	diy_fp W;
+	diy_fp Wp;
+	diy_fp Wm;
+	int biased_e;
+
+	memcpy(&bits, &value, sizeof(double));
+	biased_e = (int) ((bits >> SIGNIFICAND_SIZE) & 0x7ff);
+	if (biased_e != 0)
+		v = make_fp((bits & SIGNIFICAND_MASK) + HIDDEN_BIT, biased_e
+				- EXPONENT_BIAS);
+	else
+		v = make_fp(bits & SIGNIFICAND_MASK, 1 - EXPONENT_BIAS);
+
+	normalized_boundaries(v, &w_m, &w_p);
+	c_mk = cached_power(w_p.e, K);
+	W = multiply(normalize(v), c_mk);
+	Wp = multiply(w_p, c_mk);
+	Wm = multiply(w_m, c_mk);
+	Wm.f++;
+	Wp.f--;
+	digit_gen(W, Wp, Wp.f - Wm.f, buffer, length, K);
+}
+
+static int write_exponent(char * buf, int k) {
+	int len = 0;
+	*buf++ = 'e';
+	if (k < 0) {
+		*buf++ = '-';
+		k = -k;
+		len++;
+	}
+	if (k >= 100) {
+		*buf++ = (char) ('0' + k / 100);
+		k %= 100;
+		*buf++ = (char) ('0' + k / 10);
+		len += 2;
+	} else if (k >= 10) {
+		*buf++ = (char) ('0' + k / 10);
+		len++;
+	}
+	*buf++ = (char) ('0' + k % 10);
+	*buf = 0;
+	return len + 2;
+}
+
+/**
+ * decimal point or exponent for the digits (digits * 10^k)
+ */
+static int prettify(char * buf, const int length, const int k) {
+	/* 10^(kk-1) <= v < 10^kk */
+	const int kk = length + k;
+	int i;
+
+	if (0 <= k && kk <= 15) {
+		/* 1234e3 -> 1234000 */
+		for (i = length; i < kk; i++)
+			buf[i] = '0';
+		buf[kk] = 0;
+		return kk;
+	} else if (0 < kk && kk <= 15) {
+		/* 1234e-2 -> 12.34 */
+		memmove(&buf[kk + 1], &buf[kk], length - kk);
+		buf[kk] = '.';
+		buf[length + 1] = 0;
+		return length + 1;
+	} else if (-5 < kk && kk <= 0) {
+		/* 1234e-6 -> 0.001234 */
+		memmove(&buf[2 - kk], &buf[0], length);
+		buf[0] = '0';
+		buf[1] = '.';
+		for (i = 2; i < 2 - kk; i++)
+			buf[i] = '0';
+		buf[length + 2 - kk] = 0;
+		return length + 2 - kk;
+	} else if (length == 1) {
+		/* 1e30 */
+		return 1 + write_exponent(&buf[1], kk - 1);
+	} else {
+		/* 1234e30 -> 1.234e33 */
+		memmove(&buf[2], &buf[1], length - 1);
+		buf[1] = '.';
+		return length + 1 + write_exponent(&buf[length + 1], kk - 1);
+	}
+}
+
+int format_double(char * buf, const double v) {
+	int length;
+	int K;
+
+	if (v != v) {
+		strcpy(buf, "nan");
+		return 3;
+	}
+	if (v == 0) {
+		unsigned long bits;
+		memcpy(&bits, &v, sizeof(double));
+		if (bits >> 63) {
+			strcpy(buf, "-0");
+			return 2;
+		}
+		strcpy(buf, "0");
+		return 1;
+	}
+	if (v < 0)
+		return 1 + format_double((*buf = '-', buf + 1), -v);
+	if (v > 1.7976931348623157e308) {
+		strcpy(buf, "inf");
+		return 3;
+	}
+	grisu2(v, buf, &length, &K);
+	return prettify(buf, length, K);
+}
+
+#else
+
+int format_double(char * buf, const double v) {
+	return sprintf(buf, "%.17g", v);
+}
+
+#endif
+
+void fprint_double(FILE * f, const double v) {
+#ifdef DUMP_PRINTF
+	fprintf(f, DUMP_FORMAT, v);
+#else
+	char buf[FORMAT_DOUBLE_SIZE];
+	fwrite(buf, 1, format_double(buf, v), f);
+#endif
+}
@@ -0,0 +1,58 @@
+/*
+    APEMoST - Automated Parameter Estimation and Model Selection Toolkit
+    Copyright (C) 2009  Johannes Buchner
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef FORMAT_DOUBLE_H_
+#define FORMAT_DOUBLE_H_
+
+#include <stdio.h>
+
+#ifdef __NEVER_SET_FOR_DOCUMENTATION_ONLY
+/**
+ * Write numbers with fprintf and #DUMP_FORMAT instead of the built-in
+ * formatter.
+ *
+ * The built-in formatter writes a short text that reads back as exactly
+ * the same double (Grisu2), which is several times faster than printf.
+ * For a small fraction of numbers (below 0.1%), the text is one digit
+ * longer than needed.
+ */
+#define DUMP_PRINTF
+#endif
+
+/**
+ * size of the buffer format_double() needs
+ */
+#define FORMAT_DOUBLE_SIZE 32
+
+/**
+ * writes a short text that is read back (strtod, scanf) as exactly the
+ * same double, e.g. 0.1, 1234.5 or 1.5e-7. Rarely, one more digit than
+ * necessary is written (Grisu2 is not always shortest).
+ *
+ * @param buf at least #FORMAT_DOUBLE_SIZE chars, gets 0-terminated
+ * @return length of the text
+ */
+int format_double(char * buf, const double v);
+
+/**
+ * writes the number to the file (see format_double()), or with
+ * #DUMP_FORMAT if #DUMP_PRINTF is set.
+ */
+void fprint_double(FILE * f, const double v);
+
+#endif /* FORMAT_DOUBLE_H_ */
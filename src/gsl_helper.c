@@ -31,10 +31,9 @@ double calc_vector_sum(const gsl_vector * v) {
 }
 
 double calc_vector_squaresum(const gsl_vector * v) {
-	static double sum = 0;
-	static double x;
-	static unsigned int i;
-	sum = 0;
+	double sum = 0;
+	double x;
+	unsigned int i;
 	for (i = 0; i < v->size; i++) {
 		x = gsl_vector_get(v, i);
 		sum += x * x;
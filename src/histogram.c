@@ -30,6 +30,7 @@
 #include "utils.h"
 #include "debug.h"
 #include "histogram.h"
+#include "input.h"
 
 gsl_histogram * create_hist(int nbins, double min, double max) {
 	gsl_histogram * h;
@@ -77,72 +78,140 @@ gsl_histogram * calc_hist(const gsl_vector * v, int nbins) {
 	return h;
 }
 
+typedef struct {
+	/** input_max_threads() sets of n histograms; the first are the results */
+	gsl_histogram ** hists;
+	unsigned int n;
+} hists_state;
+
+static void append_block(const double * values, unsigned long nrows,
+		unsigned int ncolumns, int thread, void * state) {
+	hists_state * s = (hists_state*) state;
+	gsl_histogram ** hists = &s->hists[thread * s->n];
+	unsigned long j;
+	unsigned int i;
+
+	for (j = 0; j < nrows; j++) {
+		for (i = 0; i < ncolumns; i++) {
+			gsl_histogram_increment(hists[i], values[j * ncolumns + i]);
+		}
+	}
+}
+
 void append_to_hists(gsl_histogram ** hists, unsigned int n,
 		const char * filename) {
-	FILE * input;
+	input_file * input;
+	hists_state s;
+	unsigned long lines;
+	unsigned int i;
+	int t;
+	const int n_threads = input_max_threads();
+
+	input = input_open(filename);
+	if (input_columns(input) != n) {
+		fprintf(stderr, "expected %d columns, got %d in %s\n", n,
+				input_columns(input), filename);
+		exit(1);
+	}
+	s.n = n;
+	s.hists = (gsl_histogram **) calloc(n_threads * n,
+			sizeof(gsl_histogram *));
+	assert(s.hists != NULL);
+	for (i = 0; i < n; i++) {
+		s.hists[i] = hists[i];
+		for (t = 1; t < n_threads; t++) {
+			s.hists[t * n + i] = gsl_histogram_clone(hists[i]);
+			gsl_histogram_reset(s.hists[t * n + i]);
+		}
+	}
+
+	lines = input_process(input, append_block, &s, 0);
+	dump_ul("read lines", lines);
+	input_close(input);
+
+	for (i = 0; i < n; i++) {
+		for (t = 1; t < n_threads; t++) {
+			gsl_histogram_add(hists[i], s.hists[t * n + i]);
+			gsl_histogram_free(s.hists[t * n + i]);
+		}
+	}
+	free(s.hists);
+}
+
+typedef struct {
+	/** minima and maxima found by each thread */
+	double * min;
+	double * max;
+	/** distance between the values of two threads, avoids false sharing */
+	unsigned int stride;
+} min_max_state;
+
+static void min_max_block(const double * values, unsigned long nrows,
+		unsigned int ncolumns, int thread, void * state) {
+	min_max_state * s = (min_max_state*) state;
+	double * min = &s->min[thread * s->stride];
+	double * max = &s->max[thread * s->stride];
+	unsigned long j;
 	unsigned int i;
-	int col;
 	double v;
-	int line = 0;
-
-	input = openfile(filename);
-
-	while (!feof(input)) {
-		for (i = 0; i < n; i++) {
-			col = fscanf(input, "%lf", &v);
-			if (col != 1) {
-				if (feof(input))
-					break;
-				fprintf(stderr, "field could not be read: %d, line %d in %s\n",
-						i + 1, line + 1, filename);
-				exit(1);
-			}
-			gsl_histogram_increment(hists[i], v);
+
+	for (j = 0; j < nrows; j++) {
+		for (i = 0; i < ncolumns; i++) {
+			v = values[j * ncolumns + i];
+			if (min[i] > v)
+				min[i] = v;
+			if (max[i] < v)
+				max[i] = v;
 		}
-		line++;
 	}
-	dump_i("read lines", line);
-	fclose(input);
 }
 
 void find_min_max(char * filename, gsl_vector * min, gsl_vector * max) {
-	int col;
-	int i;
-	int n = min->size;
-	int line = 0;
-	double v;
-	FILE * input;
+	unsigned int i;
+	int t;
+	unsigned int n = min->size;
+	unsigned long lines;
+	input_file * input;
+	min_max_state s;
+	const int n_threads = input_max_threads();
+
 	assert(min->size == max->size);
-	input = openfile(filename);
-	for (i = 0; i < n; i++) {
-		col = fscanf(input, "%lf", &v);
-		if (col != 1) {
-			fprintf(stderr, "field could not be read: %d, line %d in %s\n", i
-					+ 1, line + 1, filename);
-			exit(1);
-		}
-		gsl_vector_set(min, i, v);
-		gsl_vector_set(max, i, v);
+	input = input_open(filename);
+	if (input_columns(input) != n) {
+		fprintf(stderr, "expected %d columns, got %d in %s\n", n,
+				input_columns(input), filename);
+		exit(1);
 	}
-	while (!feof(input)) {
-		for (i = 0; i < n; i++) {
-			col = fscanf(input, "%lf", &v);
-			if (col != 1) {
-				if (feof(input))
-					break;
-				fprintf(stderr, "field could not be read: %d, line %d in %s\n",
-						i + 1, line + 1, filename);
-				exit(1);
-			}
-			if (gsl_vector_get(min, i) > v)
-				gsl_vector_set(min, i, v);
-			if (gsl_vector_get(max, i) < v)
-				gsl_vector_set(max, i, v);
+	s.stride = n + 8;
+	s.min = (double*) calloc(n_threads * s.stride, sizeof(double));
+	s.max = (double*) calloc(n_threads * s.stride, sizeof(double));
+	assert(s.min != NULL && s.max != NULL);
+	for (i = 0; i < n_threads * s.stride; i++) {
+		s.min[i] = GSL_POSINF;
+		s.max[i] = GSL_NEGINF;
+	}
+
+	lines = input_process(input, min_max_block, &s, 0);
+	dump_ul("read lines", lines);
+	input_close(input);
+	if (lines == 0) {
+		fprintf(stderr, "field could not be read: %d, line %d in %s\n", 1, 1,
+				filename);
+		exit(1);
+	}
+
+	for (i = 0; i < n; i++) {
+		gsl_vector_set(min, i, s.min[i]);
+		gsl_vector_set(max, i, s.max[i]);
+		for (t = 1; t < n_threads; t++) {
+			if (gsl_vector_get(min, i) > s.min[t * s.stride + i])
+				gsl_vector_set(min, i, s.min[t * s.stride + i]);
+			if (gsl_vector_get(max, i) < s.max[t * s.stride + i])
+				gsl_vector_set(max, i, s.max[t * s.stride + i]);
 		}
-		line++;
 	}
-	dump_i("read lines", line);
-	fclose(input);
+	free(s.min);
+	free(s.max);
 }
 
 void update_min_max(char * filename, gsl_vector * min, gsl_vector * max) {
@@ -0,0 +1,487 @@
+/*
+    APEMoST - Automated Parameter Estimation and Model Selection Toolkit
+    Copyright (C) 2009  Johannes Buchner
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _POSIX_C_SOURCE 200112L
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <omp.h>
+
+#include "input.h"
+#include "utils.h"
+
+/** all powers of ten that are exactly representable as double */
+static const double powers_of_ten[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6,
+		1e7, 1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18,
+		1e19, 1e20, 1e21, 1e22 };
+
+static int is_separator(const char c) {
+	return c == ' ' || c == '\t' || c == ',' || c == '\r' || c == '\v' || c
+			== '\f';
+}
+
+static int is_digit(const char c) {
+	return c >= '0' && c <= '9';
+}
+
+static void input_error(const input_file * f, const char * problem,
+		const unsigned long position) {
+	fprintf(stderr, "%s near byte %lu in %s\n", problem, position,
+			f->filename);
+	exit(1);
+}
+
+static double parse_double_slow(const char * start, const char * end,
+		const char ** stop) {
+	char buf[64];
+	char * buf_stop;
+	unsigned long len = 0;
+	double v;
+
+	while (start + len < end && len < sizeof(buf) - 1 && !is_separator(
+			start[len]) && start[len] != '\n')
+		len++;
+	memcpy(buf, start, len);
+	buf[len] = 0;
+	v = strtod(buf, &buf_stop);
+	*stop = start + (buf_stop - buf);
+	return v;
+}
+
+/*
+ * Up to 15 significant digits, the digits are exact as double. So are the
+ * powers of ten up to 10^22, and one multiplication or division of exact
+ * values is correctly rounded (Clinger's fast path). Everything else
+ * (long mantissas, large exponents, nan, inf, hex) goes to strtod.
+ */
+double input_parse_double(const char * start, const char * end,
+		const char ** stop) {
+	const char * p = start;
+	int negative = 0;
+	double mantissa = 0;
+	double v;
+	int digits = 0;
+	int any_digits = 0;
+	int exponent = 0;
+	int e = 0;
+	int e_negative = 0;
+	int e_digits = 0;
+
+	if (p < end && (*p == '-' || *p == '+')) {
+		negative = (*p == '-');
+		p++;
+	}
+	for (; p < end && is_digit(*p); p++) {
+		any_digits = 1;
+		if (mantissa != 0 || *p != '0') {
+			if (digits == 15)
+				return parse_double_slow(start, end, stop);
+			mantissa = mantissa * 10 + (*p - '0');
+			digits++;
+		}
+	}
+	if (p < end && *p == '.') {
+		for (p++; p < end && is_digit(*p); p++) {
+			any_digits = 1;
+			if (mantissa != 0 || *p != '0') {
+				if (digits == 15)
+					return parse_double_slow(start, end, stop);
+				mantissa = mantissa * 10 + (*p - '0');
+				digits++;
+			}
+			exponent--;
+		}
+	}
+	if (!any_digits)
+		return parse_double_slow(start, end, stop);
+	if (p < end && (*p == 'e' || *p == 'E')) {
+		p++;
+		if (p < end && (*p == '-' || *p == '+')) {
+			e_negative = (*p == '-');
+			p++;
+		}
+		for (; p < end && is_digit(*p); p++) {
+			if (e_digits == 4)
+				return parse_double_slow(start, end, stop);
+			e = e * 10 + (*p - '0');
+			e_digits++;
+		}
+		if (e_digits == 0)
+			return parse_double_slow(start, end, stop);
+		exponent += e_negative ? -e : e;
+	}
+	if (p < end && !is_separator(*p) && *p != '\n')
+		return parse_double_slow(start, end, stop);
+
+	if (mantissa == 0) {
+		v = 0;
+	} else if (exponent < -22 || exponent > 22) {
+		return parse_double_slow(start, end, stop);
+	} else if (exponent < 0) {
+		v = mantissa / powers_of_ten[-exponent];
+	} else {
+		v = mantissa * powers_of_ten[exponent];
+	}
+	*stop = p;
+	return negative ? -v : v;
+}
+
+/**
+ * number of fields in the first line that is neither empty nor a comment
+ */
+static unsigned int count_columns(const char * p, const char * end) {
+	unsigned int count = 0;
+	int at_separator;
+
+	while (p < end && count == 0) {
+		at_separator = 1;
+		for (; p < end && *p != '\n' && *p != '#'; p++) {
+			if (is_separator(*p)) {
+				at_separator = 1;
+			} else {
+				if (at_separator)
+					count++;
+				at_separator = 0;
+			}
+		}
+		for (; p < end && *p != '\n'; p++)
+			;
+		p++;
+	}
+	return count;
+}
+
+static int is_binary(const char * data, const unsigned long size) {
+	return size >= INPUT_BINARY_HEADER_SIZE && memcmp(data,
+			INPUT_BINARY_MAGIC, strlen(INPUT_BINARY_MAGIC)) == 0;
+}
+
+static unsigned int binary_columns(const char * data) {
+	unsigned int ncolumns;
+	memcpy(&ncolumns, data + strlen(INPUT_BINARY_MAGIC), sizeof(unsigned int));
+	return ncolumns;
+}
+
+static void read_window(input_file * f) {
+	f->window_fill += fread(f->window + f->window_fill, 1, f->window_size
+			- f->window_fill, f->stream);
+	if (ferror(f->stream)) {
+		fprintf(stderr, "error reading %s\n", f->filename);
+		perror("read failed");
+		exit(1);
+	}
+}
+
+static int open_mapped(input_file * f) {
+	struct stat st;
+	void * map;
+	int fd = open(f->filename, O_RDONLY);
+
+	if (fd == -1)
+		return 0;
+	if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size == 0) {
+		close(fd);
+		return 0;
+	}
+	map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED)
+		return 0;
+	posix_madvise(map, st.st_size, POSIX_MADV_SEQUENTIAL);
+	f->map = (char*) map;
+	f->map_size = st.st_size;
+	return 1;
+}
+
+input_file * input_open(const char * filename) {
+	input_file * f = (input_file*) calloc(1, sizeof(input_file));
+	const char * data;
+	unsigned long size;
+
+	if (f == NULL) {
+		perror("could not allocate input");
+		exit(1);
+	}
+	if (filename == NULL || strcmp(filename, "-") == 0) {
+		f->filename = "stdin";
+		f->stream = stdin;
+	} else {
+		f->filename = job_path(f->path, filename);
+		if (!open_mapped(f)) {
+			f->stream = fopen(f->filename, "rb");
+			if (f->stream == NULL) {
+				fprintf(stderr, "error opening file %s\n", f->filename);
+				perror("file could not be opened");
+				exit(1);
+			}
+		}
+	}
+	if (f->stream != NULL) {
+		f->window_size = 2 * INPUT_CHUNK_SIZE * input_max_threads();
+		f->window = (char*) malloc(f->window_size);
+		if (f->window == NULL) {
+			perror("could not allocate input buffer");
+			exit(1);
+		}
+		read_window(f);
+		data = f->window;
+		size = f->window_fill;
+	} else {
+		data = f->map;
+		size = f->map_size;
+	}
+	if (is_binary(data, size)) {
+		f->binary = 1;
+		f->ncolumns = binary_columns(data);
+		if (f->stream != NULL) {
+			f->window_fill -= INPUT_BINARY_HEADER_SIZE;
+			memmove(f->window, f->window + INPUT_BINARY_HEADER_SIZE,
+					f->window_fill);
+		}
+	} else {
+		f->ncolumns = count_columns(data, data + size);
+	}
+	if (f->ncolumns == 0) {
+		fprintf(stderr, "error: file %s is empty!\n", f->filename);
+		exit(1);
+	}
+	return f;
+}
+
+void input_close(input_file * f) {
+	if (f->map != NULL)
+		munmap(f->map, f->map_size);
+	if (f->stream != NULL && f->stream != stdin)
+		fclose(f->stream);
+	free(f->window);
+	free(f);
+}
+
+unsigned int input_columns(const input_file * f) {
+	return f->ncolumns;
+}
+
+unsigned int input_column_count(const char * filename) {
+	input_file * f = input_open(filename);
+	unsigned int ncolumns = input_columns(f);
+	input_close(f);
+	return ncolumns;
+}
+
+int input_max_threads() {
+	return omp_get_max_threads();
+}
+
+/**
+ * @return number of rows parsed into values
+ */
+static unsigned long parse_chunk(const input_file * f, const char * start,
+		const char * end, const unsigned long offset, double * values) {
+	const char * p = start;
+	const char * line_end;
+	const char * q;
+	const char * stop;
+	unsigned int col;
+	unsigned long nrows = 0;
+	double * row = values;
+
+	while (p < end) {
+		line_end = (const char *) memchr(p, '\n', end - p);
+		if (line_end == NULL)
+			line_end = end;
+		col = 0;
+		q = p;
+		while (1) {
+			while (q < line_end && is_separator(*q))
+				q++;
+			if (q >= line_end || *q == '#')
+				break;
+			if (col == f->ncolumns)
+				input_error(f, "too many fields", offset + (q - start));
+			row[col] = input_parse_double(q, line_end, &stop);
+			if (stop == q)
+				input_error(f, "field could not be read", offset
+						+ (q - start));
+			col++;
+			q = stop;
+		}
+		if (col != 0) {
+			if (col != f->ncolumns)
+				input_error(f, "too few fields", offset + (q - start));
+			nrows++;
+			row += f->ncolumns;
+		}
+		p = line_end + 1;
+	}
+	return nrows;
+}
+
+static void handle(const double * values, const unsigned long nrows,
+		const unsigned int ncolumns, input_handler handler, void * state,
+		const int ordered) {
+	if (ordered) {
+#pragma omp ordered
+		{
+			if (nrows > 0)
+				handler(values, nrows, ncolumns, omp_get_thread_num(), state);
+		}
+	} else if (nrows > 0) {
+		handler(values, nrows, ncolumns, omp_get_thread_num(), state);
+	}
+}
+
+static unsigned long process_text(const input_file * f, const char * data,
+		const unsigned long size, const unsigned long offset,
+		input_handler handler, void * state, const int ordered) {
+	const int n_chunks = size / INPUT_CHUNK_SIZE + 1;
+	unsigned long * bounds = (unsigned long*) malloc((n_chunks + 1)
+			* sizeof(unsigned long));
+	unsigned long nrows = 0;
+	unsigned long p;
+	const char * newline;
+	int i;
+
+	if (bounds == NULL) {
+		perror("could not allocate chunks");
+		exit(1);
+	}
+	/* cut at line boundaries */
+	bounds[0] = 0;
+	for (i = 1; i < n_chunks; i++) {
+		p = (unsigned long) i * INPUT_CHUNK_SIZE;
+		if (p < bounds[i - 1])
+			p = bounds[i - 1];
+		newline = (const char *) memchr(data + p, '\n', size - p);
+		bounds[i] = newline == NULL ? size : (unsigned long) (newline - data)
+				+ 1;
+	}
+	bounds[n_chunks] = size;
+
+#pragma omp parallel for schedule(dynamic, 1) ordered reduction(+:nrows)
+	for (i = 0; i < n_chunks; i++) {
+		unsigned long length = bounds[i + 1] - bounds[i];
+		unsigned long n;
+		double * values = (double*) malloc((length / 2 + 1 + f->ncolumns)
+				* sizeof(double));
+		if (values == NULL) {
+			perror("could not allocate values");
+			exit(1);
+		}
+		n = parse_chunk(f, data + bounds[i], data + bounds[i + 1], offset
+				+ bounds[i], values);
+		handle(values, n, f->ncolumns, handler, state, ordered);
+		nrows += n;
+		free(values);
+	}
+	free(bounds);
+	return nrows;
+}
+
+static unsigned long process_binary(const input_file * f,
+		const double * values, const unsigned long nrows,
+		input_handler handler, void * state, const int ordered) {
+	const unsigned long rows_per_chunk = INPUT_CHUNK_SIZE / (sizeof(double)
+			* f->ncolumns) + 1;
+	const int n_chunks = nrows / rows_per_chunk + 1;
+	int i;
+
+#pragma omp parallel for schedule(dynamic, 1) ordered
+	for (i = 0; i < n_chunks; i++) {
+		unsigned long first = i * rows_per_chunk;
+		unsigned long n = 0;
+		if (first < nrows)
+			n = nrows - first < rows_per_chunk ? nrows - first
+					: rows_per_chunk;
+		handle(values + first * f->ncolumns, n, f->ncolumns, handler, state,
+				ordered);
+	}
+	return nrows;
+}
+
+static unsigned long process_stream(input_file * f, input_handler handler,
+		void * state, const int ordered) {
+	const unsigned long row_size = sizeof(double) * f->ncolumns;
+	unsigned long nrows = 0;
+	unsigned long offset = f->binary ? INPUT_BINARY_HEADER_SIZE : 0;
+	unsigned long usable;
+	int at_end;
+
+	while (f->window_fill > 0 || !feof(f->stream)) {
+		read_window(f);
+		at_end = feof(f->stream);
+		if (f->binary) {
+			usable = f->window_fill - f->window_fill % row_size;
+			if (at_end && usable != f->window_fill)
+				input_error(f, "incomplete row", offset + usable);
+			nrows += process_binary(f, (const double *) f->window, usable
+					/ row_size, handler, state, ordered);
+		} else {
+			usable = f->window_fill;
+			if (!at_end) {
+				while (usable > 0 && f->window[usable - 1] != '\n')
+					usable--;
+				if (usable == 0) {
+					/* a line longer than the buffer */
+					f->window_size *= 2;
+					f->window = (char*) realloc(f->window, f->window_size);
+					if (f->window == NULL) {
+						perror("could not allocate input buffer");
+						exit(1);
+					}
+					continue;
+				}
+			}
+			nrows += process_text(f, f->window, usable, offset, handler,
+					state, ordered);
+		}
+		f->window_fill -= usable;
+		memmove(f->window, f->window + usable, f->window_fill);
+		offset += usable;
+		if (at_end)
+			break;
+	}
+	return nrows;
+}
+
+unsigned long input_process(input_file * f, input_handler handler,
+		void * state, const int ordered) {
+	const unsigned long row_size = sizeof(double) * f->ncolumns;
+	unsigned long size;
+
+	if (f->stream != NULL)
+		return process_stream(f, handler, state, ordered);
+	if (!f->binary)
+		return process_text(f, f->map, f->map_size, 0, handler, state,
+				ordered);
+	size = f->map_size - INPUT_BINARY_HEADER_SIZE;
+	if (size % row_size != 0)
+		input_error(f, "incomplete row", f->map_size - size % row_size);
+	return process_binary(f, (const double *) (f->map
+			+ INPUT_BINARY_HEADER_SIZE), size / row_size, handler, state,
+			ordered);
+}
+
+void input_write_binary_header(FILE * f, const unsigned int ncolumns) {
+	const unsigned int padding = 0;
+	fwrite(INPUT_BINARY_MAGIC, 1, strlen(INPUT_BINARY_MAGIC), f);
+	fwrite(&ncolumns, sizeof(unsigned int), 1, f);
+	fwrite(&padding, sizeof(unsigned int), 1, f);
+}
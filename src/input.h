@@ -0,0 +1,125 @@
+/*
+    APEMoST - Automated Parameter Estimation and Model Selection Toolkit
+    Copyright (C) 2009  Johannes Buchner
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef INPUT_H_
+#define INPUT_H_
+
+#include <stdio.h>
+
+/**
+ * Fast reading of tables of double values, used by the tools.
+ *
+ * Files are mapped into memory if possible, otherwise (e.g. stdin) read
+ * in large blocks. The text is cut into chunks at line boundaries, and the
+ * chunks are parsed in parallel. Every parsed block of rows is handed to a
+ * callback, which gets the number of the thread so that it can keep
+ * partial results (sums, histograms) per thread to be merged at the end.
+ *
+ * Besides text (columns separated by whitespace or commas, lines starting
+ * with # are skipped), a binary format is understood: the 8 bytes
+ * #INPUT_BINARY_MAGIC, the number of columns as unsigned int, 4 bytes
+ * padding, and then the rows as native doubles.
+ */
+
+#ifndef INPUT_CHUNK_SIZE
+/**
+ * Size of the pieces (in bytes) the input is cut into for parsing.
+ */
+#define INPUT_CHUNK_SIZE (4 * 1024 * 1024)
+#endif
+
+#define INPUT_BINARY_MAGIC "APEMOSTB"
+#define INPUT_BINARY_HEADER_SIZE 16
+
+typedef struct {
+	const char * filename;
+	/** filename in the job directory */
+	char path[FILENAME_MAX];
+	/** NULL if the file is mapped */
+	FILE * stream;
+	/** the whole file, if it is mapped */
+	char * map;
+	unsigned long map_size;
+	unsigned int ncolumns;
+	int binary;
+	/** data read from the stream, but not yet processed */
+	char * window;
+	unsigned long window_fill;
+	unsigned long window_size;
+} input_file;
+
+/**
+ * called for each block of parsed rows.
+ *
+ * @param values nrows * ncolumns values, row by row
+ * @param thread number of the calling thread, smaller than
+ *        input_max_threads()
+ * @param state the pointer given to input_process()
+ */
+typedef void (*input_handler)(const double * values, unsigned long nrows,
+		unsigned int ncolumns, int thread, void * state);
+
+/**
+ * opens the file or dies. Use NULL or "-" for stdin.
+ * The number of columns is taken from the first line.
+ */
+input_file * input_open(const char * filename);
+
+void input_close(input_file * f);
+
+unsigned int input_columns(const input_file * f);
+
+/**
+ * opens the file just to find out the number of columns.
+ */
+unsigned int input_column_count(const char * filename);
+
+/**
+ * upper limit for the thread numbers handed to the handler.
+ */
+int input_max_threads();
+
+/**
+ * reads all rows of the file and hands them to the handler, dies on
+ * malformed input.
+ *
+ * @param ordered if not 0, the handler is called for one block at a time,
+ *        in the order of the file. Otherwise calls happen concurrently and
+ *        in any order.
+ * @return number of rows read
+ */
+unsigned long input_process(input_file * f, input_handler handler,
+		void * state, const int ordered);
+
+/**
+ * parses a number from text that is not necessarily terminated.
+ * Gives the same results as strtod.
+ *
+ * @param stop is set to the first character after the number, or to
+ *        start, if no number could be read.
+ */
+double input_parse_double(const char * start, const char * end,
+		const char ** stop);
+
+/**
+ * writes the header of the binary format. The rows have to follow as
+ * native doubles (fwrite).
+ */
+void input_write_binary_header(FILE * f, const unsigned int ncolumns);
+
+#endif /* INPUT_H_ */
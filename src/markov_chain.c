@@ -19,11 +19,14 @@
 #include <string.h>
 #include <stdio.h>
 #include <libgen.h>
+#include <omp.h>
 
 #include "mcmc.h"
 #include "mcmc_internal.h"
 #include "debug.h"
 #include "gsl_helper.h"
+#include "timing.h"
+#include "trace.h"
 #include <gsl/gsl_sf.h>
 
 void restart_from_best(mcmc * m) {
@@ -31,12 +34,56 @@ void restart_from_best(mcmc * m) {
 	set_prob(m, get_prob_best(m));
 }
 
+/** copy of the chain for evaluations off the chain, one per thread */
+static mcmc * scratch = NULL;
+#pragma omp threadprivate(scratch)
+
+mcmc * markov_chain_scratch(const mcmc * m) {
+	if (scratch != NULL && get_n_par(scratch) != get_n_par(m)) {
+		set_data(scratch, NULL);
+		set_random(scratch, NULL);
+		scratch = mcmc_free(scratch);
+	}
+	if (scratch == NULL) {
+		scratch = mcmc_clone(m);
+	}
+	scratch->data = m->data;
+	scratch->prepared = m->prepared;
+	scratch->data_float = m->data_float;
+	scratch->additional_data = m->additional_data;
+	scratch->context = m->context;
+	gsl_vector_memcpy(scratch->params, m->params);
+	return scratch;
+}
+
+#ifdef __NEVER_SET_FOR_DOCUMENTATION_ONLY
+/**
+ * Keep a single precision copy of the data (mcmc::data_float), so that
+ * models can evaluate their terms in float: half the memory traffic and
+ * twice the values per vector instruction. Models should still sum up in
+ * double precision.
+ *
+ * Every #SINGLE_PRECISION_CHECK_INTERVAL iterations the model is evaluated
+ * in double precision for comparison. Models that do not use data_float
+ * are not affected.
+ */
+#define SINGLE_PRECISION
+#endif
+
+double markov_chain_check_precision(const mcmc * m) {
+	mcmc * s = markov_chain_scratch(m);
+
+	s->data_float = NULL;
+	calc_model(s, NULL);
+	return get_prob(m) - get_prob(s);
+}
+
 void burn_in(mcmc * m, const unsigned int burn_in_iterations) {
 	unsigned long iter;
 	unsigned long subiter;
 
-	gsl_vector * original_steps = get_steps(m);
-	m->params_step = dup_vector(m->params_max);
+	gsl_vector * original_steps = dup_vector(get_steps(m));
+	gsl_vector_memcpy(m->params_step, m->params_max);
 	gsl_vector_sub(m->params_step, m->params_min);
 	gsl_vector_scale(m->params_step, 0.1);
 
@@ -127,6 +174,7 @@ unsigned int assess_acceptance_rate(mcmc * m, unsigned int param,
 	double accept_rate;
 	double required_accuracy = min_accuracy;
 	char * acceptslog = NULL;
+	TRACE_DECLARE(t)
 	/*
 	 gsl_vector * start_params = dup_vector(get_params(m));
 	 double start_prob = get_prob(m);
@@ -134,6 +182,7 @@ unsigned int assess_acceptance_rate(mcmc * m, unsigned int param,
 	reset_accept_rejects(m);
 
 	while (1) {
+		TRACE_START(t);
 		IFVERBOSE
 			printf("calculating %d steps.\n", n);
 		acceptslog = (char*) realloc(acceptslog, n * sizeof(char));
@@ -207,6 +256,7 @@ unsigned int assess_acceptance_rate(mcmc * m, unsigned int param,
 		 */
 		*acceptance_rate = accept_rate;
 		*accuracy = maxdev / 1. / n;
+		TRACE_EVENT(t, "assess acceptance rate", -1, "steps", n);
 		IFVERBOSE
 			printf("accuracy wanted: %f, got: %f\n", required_accuracy,
 					*accuracy);
@@ -223,80 +273,117 @@ unsigned int assess_acceptance_rate(mcmc * m, unsigned int param,
 	return n;
 }
 
-void do_step_for(mcmc * m, const unsigned int i) {
-	const double step = gsl_vector_get(m->params_step, i);
-	const double old_value = gsl_vector_get(m->params, i);
+/**
+ * how close (relative to the range) a #BOUNDARY_LOGIT parameter may come
+ * to its limits
+ */
+#define LOGIT_EPSILON 1e-12
+
+/**
+ * random walk on y = logit(u), u = (x - min) / (max - min).
+ * The step width is converted at the center of the range.
+ *
+ * @param correction the log Jacobian ratio is added here
+ */
+static double logit_step(const mcmc * m, const double old_value,
+		const double min, const double max, const double step,
+		double * correction) {
+	const double width = max - min;
+	double u = (old_value - min) / width;
+	double u_new;
+	double y;
+
+	if (u < LOGIT_EPSILON)
+		u = LOGIT_EPSILON;
+	if (u > 1 - LOGIT_EPSILON)
+		u = 1 - LOGIT_EPSILON;
+	y = log(u / (1 - u)) + get_next_random_jump(m, 4 * step / width);
+	u_new = 1 / (1 + exp(-y));
+	*correction += log(u_new * (1 - u_new)) - log(u * (1 - u));
+	return min + width * u_new;
+}
+
+/**
+ * @return log of the factor the acceptance probability has to be
+ * multiplied with (0 for symmetric proposals)
+ */
+double do_step_for(mcmc * m, const unsigned int i) {
+	const double step = get_steps_for(m, i);
+	const double old_value = get_params_for(m, i);
 	double new_value;
-	const double max = gsl_vector_get(m->params_max, i);
-	const double min = gsl_vector_get(m->params_min, i);
+	const double max = get_params_max_for(m, i);
+	const double min = get_params_min_for(m, i);
+	const double width = max - min;
+	double correction = 0;
+	double d;
 	/* dump_d("Jumping from", old_value); */
 
-#if CIRCULAR_PARAMS == 0
-	do {
+	if (width <= 0) {
+		new_value = min;
+	} else if (m->params_boundary[i] == BOUNDARY_LOGIT) {
+		new_value = logit_step(m, old_value, min, max, step, &correction);
+	} else {
 		new_value = old_value + get_next_random_jump(m, step);
-		IFVERBOSE
-			printf("Value borders reached; looking for new starting point"
-				" for %d \n", i);
-	} while (new_value > max || new_value < min);
-#else
-	unsigned int j = 0;
-	/** circular parameters **/
-	unsigned int parameters[] = {CIRCULAR_PARAMS, 0};
-	
-	new_value = old_value + get_next_random_jump(m, step);
-	
-	if (new_value > max || new_value < min) {
-		while (1) {
-			if (parameters[j] == 0) {
-				/* non-circular parameter */
-				do {
-					new_value = old_value + get_next_random_jump(m, step);
-				}while (new_value > max || new_value < min);
+		if (new_value > max || new_value < min) {
+			switch (m->params_boundary[i]) {
+			case BOUNDARY_REFLECT:
+				d = mod_double(new_value - min, 2 * width);
+				new_value = min + (d > width ? 2 * width - d : d);
 				break;
-			}
-			if (parameters[j] == i + 1) {
-				/* circular parameter */
-				new_value = min + mod_double(new_value - min, max - min);
+			case BOUNDARY_CIRCULAR:
+				new_value = min + mod_double(new_value - min, width);
 				break;
+			default:
+				do {
+					new_value = old_value + get_next_random_jump(m, step);
+					IFVERBOSE
+						printf("Value borders reached; looking for new "
+							"starting point for %d \n", i);
+				} while (new_value > max || new_value < min);
 			}
-			j++;
 		}
 	}
-#endif
-	assert(new_value <= max);
-	assert(new_value >= min);
+	if (new_value > max)
+		new_value = max;
+	if (new_value < min)
+		new_value = min;
 	/* dump_d("To", new_value); */
 	set_params_for(m, new_value, i);
+	return correction;
 }
 
-static void do_step(mcmc * m) {
+static double do_step(mcmc * m) {
 	unsigned int i;
+	double correction = 0;
 	for (i = 0; i < get_n_par(m); i++) {
-		do_step_for(m, i);
+		correction += do_step_for(m, i);
 	}
+	return correction;
 }
 
 /**
+ * @param correction log of the proposal ratio, see do_step_for()
  * @returns 1 if accept, 0 if rejecting
  */
-static int check_accept(mcmc * m, const double prob_old) {
+static int check_accept(mcmc * m, const double prob_old,
+		const double correction) {
 	double prob_new = get_prob(m);
 	double prob_still_accept;
 
 	/* shortcut */
-	if (prob_new == prob_old) {
+	if (prob_new == prob_old && correction >= 0) {
 		return 1;
 	}
 	IFVERBOSE
 		dump_v("suggesting parameter", get_params(m));
 
-	if (prob_new > prob_old) {
+	if (prob_new - prob_old + correction > 0) {
 		IFVERBOSE
 			dump_d("accepting improvement of", prob_new - prob_old);
 		return 1;
 	} else {
 		prob_still_accept = get_next_alog_urandom(m);
-		if (prob_still_accept < (prob_new - prob_old)) {
+		if (prob_still_accept < (prob_new - prob_old + correction)) {
 			IFVERBOSE {
 				dump_d("accepting probability", prob_still_accept);
 				dump_d("accepting worsening of", prob_new - prob_old);
@@ -314,22 +401,98 @@ static void revert(mcmc * m, const double prob_old) {
 	set_prob(m, prob_old);
 }
 
+#ifdef __NEVER_SET_FOR_DOCUMENTATION_ONLY
+/**
+ * Upper bound of what calc_model_likelihood() (or
+ * calc_model_likelihood_bounded()) can return, e.g. 0 if the
+ * log-likelihood is a sum of non-positive terms (chi-square, Bernoulli).
+ *
+ * Proposals whose prior plus this bound cannot reach the acceptance
+ * threshold are rejected without evaluating the likelihood. Since beta is
+ * at most 1, a non-negative bound of the untempered likelihood also
+ * holds for every chain. Without it, only proposals with a prior of
+ * -inf are rejected early.
+ */
+#define LIKELIHOOD_MAX 0
+#endif
+
+/**
+ * does the application provide the prior and likelihood separately?
+ */
+static int staged() {
+	return calc_model_likelihood != NULL || calc_model_likelihood_bounded
+			!= NULL;
+}
+
+/**
+ * evaluates the prior of the proposal first and the likelihood only if the
+ * proposal can still be accepted (see staged()). The likelihood is told
+ * the lowest value that could still be accepted.
+ *
+ * The acceptance threshold is drawn before the evaluation, so this also
+ * draws a random number for improvements.
+ *
+ * @param correction log of the proposal ratio, see do_step_for()
+ * @returns 1 if accept, 0 if rejecting
+ */
+static int staged_accept(mcmc * m, const double prob_old,
+		const double correction) {
+	/* the proposal is accepted if its probability exceeds this */
+	const double threshold = prob_old - correction + get_next_alog_urandom(m);
+	const double prior = calc_model_prior != NULL ? calc_model_prior(m) : 0;
+
+	set_prior(m, prior);
+	/* also catches NaN */
+	if (!(prior > -HUGE_VAL)) {
+		IFVERBOSE
+			debug("rejecting proposal outside of the prior");
+		return 0;
+	}
+#ifdef LIKELIHOOD_MAX
+	if (!(prior + LIKELIHOOD_MAX > threshold)) {
+		IFVERBOSE
+			dump_d("rejecting by the prior alone", prior);
+		return 0;
+	}
+#endif
+	if (calc_model_likelihood_bounded != NULL)
+		set_prob(m, prior + calc_model_likelihood_bounded(m, threshold - prior));
+	else
+		set_prob(m, prior + calc_model_likelihood(m));
+	return get_prob(m) > threshold;
+}
+
 void markov_chain_step_for(mcmc * m, const unsigned int index) {
 	double prob_old = get_prob(m);
+	double prior_old = get_prior(m);
 	double old_value = gsl_vector_get(m->params, index);
+	double correction;
+	int accepted;
+	TIMING_DECLARE(t)
 
 	mcmc_check(m);
-	do_step_for(m, index);
+	TIMING_START(t);
+	correction = do_step_for(m, index);
+	TIMING_LAP(t, TIMING_PROPOSAL);
 
-	calc_model_for(m, index, old_value);
+	if (staged()) {
+		accepted = staged_accept(m, prob_old, correction);
+		TIMING_LAP(t, TIMING_MODEL);
+	} else {
+		calc_model_for(m, index, old_value);
+		TIMING_LAP(t, TIMING_MODEL);
+		accepted = check_accept(m, prob_old, correction);
+	}
 
-	if (check_accept(m, prob_old) == 1) {
+	if (accepted == 1) {
 		inc_params_accepts_for(m, index);
 	} else {
 		revert(m, prob_old);
+		set_prior(m, prior_old);
 		set_params_for(m, old_value, index);
 		inc_params_rejects_for(m, index);
 	}
+	TIMING_LAP(t, TIMING_ACCEPT);
 }
 
 #ifndef MINIMAL_STEPWIDTH
@@ -368,19 +531,35 @@ void rmw_adapt_stepwidth(mcmc * m, const double prob_old) {
 
 void markov_chain_step(mcmc * m) {
 	double prob_old = get_prob(m);
-	gsl_vector * old_values = dup_vector(m->params);
-
+	double prior_old = get_prior(m);
+	gsl_vector * old_values;
+	double correction;
+	int accepted;
+	TIMING_DECLARE(t)
+
+	TIMING_START(t);
+	old_values = dup_vector(m->params);
 	mcmc_check(m);
-	do_step(m);
+	correction = do_step(m);
+	TIMING_LAP(t, TIMING_PROPOSAL);
 
-	calc_model(m, old_values);
+	if (staged()) {
+		accepted = staged_accept(m, prob_old, correction);
+		TIMING_LAP(t, TIMING_MODEL);
+	} else {
+		calc_model(m, old_values);
+		TIMING_LAP(t, TIMING_MODEL);
+		accepted = check_accept(m, prob_old, correction);
+	}
 
-	if (check_accept(m, prob_old) == 1) {
+	if (accepted == 1) {
 		inc_params_accepts(m);
 		gsl_vector_free(old_values);
 	} else {
 		revert(m, prob_old);
+		set_prior(m, prior_old);
 		set_params(m, old_values);
 		inc_params_rejects(m);
 	}
+	TIMING_LAP(t, TIMING_ACCEPT);
 }
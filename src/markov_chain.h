@@ -45,6 +45,92 @@
 #define CIRCULAR_PARAMS 0
 #endif
 
+/*
+ * How a parameter is kept within its limits. Set per parameter in the
+ * sixth column of the params file (redraw, reflect, circular or logit).
+ */
+/**
+ * the proposal is drawn again until it lies within the limits (default).
+ * This is not symmetric near the limits.
+ */
+#define BOUNDARY_REDRAW 0
+/**
+ * the proposal is reflected at the limits
+ */
+#define BOUNDARY_REFLECT 1
+/**
+ * the parameter wraps around at the limits (e.g. an angle).
+ * Also set by #CIRCULAR_PARAMS.
+ */
+#define BOUNDARY_CIRCULAR 2
+/**
+ * the random walk runs on logit((x - min) / (max - min)), so the limits
+ * are never reached. Good for posteriors piling up at a limit.
+ */
+#define BOUNDARY_LOGIT 3
+
+#ifndef HMC_LEAPFROG_STEPS
+/**
+ * Number of leapfrog steps in one HMC step.
+ */
+#define HMC_LEAPFROG_STEPS 10
+#endif
+
+#ifndef HMC_STEPSIZE
+/**
+ * Length of a leapfrog step in units of the calibrated step width.
+ * It is jittered by +-20% for every HMC step.
+ */
+#define HMC_STEPSIZE 0.3
+#endif
+
+#ifndef HMC_GRADIENT_EPSILON
+/**
+ * Distance used for the finite differences, in units of the calibrated
+ * step width.
+ */
+#define HMC_GRADIENT_EPSILON 0.001
+#endif
+
+#ifndef ENSEMBLE_WALKERS
+/**
+ * Number of walkers of the ensemble sampler (see #ENSEMBLE), rounded up to
+ * an even number. 0 means 2 * (number of parameters + 1).
+ */
+#define ENSEMBLE_WALKERS 0
+#endif
+
+#ifndef ENSEMBLE_STRETCH
+/**
+ * Scale a of the stretch move. The stretch factor is drawn from [1/a, a].
+ */
+#define ENSEMBLE_STRETCH 2.0
+#endif
+
+#ifndef ENSEMBLE_WALK_SIZE
+/**
+ * Use the walk move with this many walkers of the other half instead of
+ * the stretch move. 0 selects the stretch move.
+ */
+#define ENSEMBLE_WALK_SIZE 0
+#endif
+
+#ifndef SINGLE_PRECISION_CHECK_INTERVAL
+/**
+ * With #SINGLE_PRECISION, every this many iterations the probability of
+ * each chain is recalculated in double precision. 0 disables the check.
+ */
+#define SINGLE_PRECISION_CHECK_INTERVAL 10000
+#endif
+
+#ifndef SINGLE_PRECISION_TOLERANCE
+/**
+ * Differences to double precision in the logarithmic probability above
+ * this are reported (see #SINGLE_PRECISION_CHECK_INTERVAL).
+ */
+#define SINGLE_PRECISION_TOLERANCE 0.01
+#endif
+
 /**
  * create/calibrate the markov-chain
  *
@@ -71,6 +157,54 @@ void markov_chain_step(mcmc * m);
  */
 void markov_chain_step_for(mcmc * m, const unsigned int index);
 
+/**
+ * take a Hamiltonian Monte Carlo step (see #HMC)
+ * @param m
+ */
+void markov_chain_hmc_step(mcmc * m);
+
+/**
+ * move all walkers of the ensemble once (see #ENSEMBLE).
+ * Afterwards, the chain holds the next walker in turn.
+ * @param m
+ */
+void markov_chain_ensemble_step(mcmc * m);
+
+/**
+ * run the ensemble for about burn_in_iterations evaluations. The step
+ * widths are set to the spread of the walkers, and the chain is restarted
+ * from the best walker.
+ */
+void markov_chain_ensemble_burn_in(mcmc * m,
+		const unsigned int burn_in_iterations);
+
+/**
+ * swap walker w of chain a with walker w of chain b, for every w that
+ * passes its own parallel tempering test. The probabilities are tempered
+ * with the beta of the new chain.
+ *
+ * @param beta_a inverse temperature of a
+ * @param beta_b inverse temperature of b
+ * @return the number of walkers swapped
+ */
+unsigned int markov_chain_ensemble_swap(mcmc * a, mcmc * b,
+		const double beta_a, const double beta_b);
+
+/**
+ * recalculate the probability of the current parameter values in double
+ * precision (see #SINGLE_PRECISION).
+ *
+ * @param m
+ * @return difference of the probability of the chain to double precision
+ */
+double markov_chain_check_precision(const mcmc * m);
+
+/**
+ * a copy of the chain for evaluating parameter values off the chain.
+ * There is one per thread; its parameters are those of m.
+ */
+mcmc * markov_chain_scratch(const mcmc * m);
+
 /**
  * adapts the step width
  */
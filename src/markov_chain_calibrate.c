@@ -20,16 +20,35 @@
 #include <stdio.h>
 #include <math.h>
 #include <gsl/gsl_linalg.h>
+#include <omp.h>
 
 #include "mcmc.h"
 #include "mcmc_internal.h"
 #include "debug.h"
+#include "utils.h"
 #include "gsl_helper.h"
 
 #define BETWEEN(x, min, max) ( (x) >= (min) && (x) <= (max) )
 #define MAX(a, b) ((a) > (b) ? a : b)
 #define MIN(a, b) ((a) < (b) ? a : b)
 
+/**
+ * the file the progress of the calibration is written to, or NULL.
+ * Chains of a context (see mcmc_gettersetter.h) and chains calibrated in
+ * parallel in the same directory do not write it, as they would
+ * overwrite each other's.
+ */
+static FILE * open_progress_file(const mcmc * m) {
+	FILE * f;
+
+	if (get_context(m) != NULL || (omp_get_num_threads() > 1
+			&& get_job_directory() == NULL))
+		return NULL;
+	f = job_fopen("calibration_progress.data", "w");
+	assert(f != NULL);
+	return f;
+}
+
 void markov_chain_calibrate_multilinear_regression(mcmc * m,
 		double desired_acceptance_rate, const double max_ar_deviation,
 		const unsigned int iter_limit, double mul, const double adjust_step) {
@@ -262,10 +281,9 @@ void markov_chain_calibrate_linear_regression(mcmc * m,
 	double max_stepwidth;
 	double weight;
 	gsl_vector_int * enough_points_discovered = gsl_vector_int_alloc(n_par);
-	FILE * progress_plot_file = fopen("calibration_progress.data", "w");
+	FILE * progress_plot_file = open_progress_file(m);
 	gsl_vector_int_set_all(enough_points_discovered, 0);
 
-	assert(progress_plot_file != NULL);
 	for (j = 0; j < all_stepwidths->size2 && iter < iter_limit; j++) {
 		for (i = 0; i < n_par; i++) {
 			/*if (gsl_matrix_get(all_acceptance_rates, i, j) == 0)
@@ -273,10 +291,11 @@ void markov_chain_calibrate_linear_regression(mcmc * m,
 			if (gsl_matrix_get(all_acceptance_rates, i, j) < 0)
 				continue;
 
-			fprintf(progress_plot_file, "%d\t%d\t%f\t%f\t%f\n", i + 1, iter,
-					gsl_matrix_get(all_stepwidths, i, j), gsl_matrix_get(
-							all_acceptance_rates, i, j), gsl_matrix_get(
-							all_accuracies, i, j));
+			if (progress_plot_file != NULL)
+				fprintf(progress_plot_file, "%d\t%d\t%f\t%f\t%f\n", i + 1, iter,
+						gsl_matrix_get(all_stepwidths, i, j), gsl_matrix_get(
+								all_acceptance_rates, i, j), gsl_matrix_get(
+								all_accuracies, i, j));
 		}
 	}
 	debug("calibrating using linear regression");
@@ -438,15 +457,18 @@ void markov_chain_calibrate_linear_regression(mcmc * m,
 					printf("%d: a/r: %f (+-%f)\n", i, current_acceptance_rate,
 							accuracy);
 
-				fprintf(progress_plot_file, "%d\t%d\t%f\t%f\t%f\t%f\n", i + 1,
-						iter, gsl_matrix_get(all_stepwidths, i, n),
-						gsl_matrix_get(all_acceptance_rates, i, n),
-						gsl_matrix_get(all_accuracies, i, n), k);
-				fflush(progress_plot_file);
+				if (progress_plot_file != NULL) {
+					fprintf(progress_plot_file, "%d\t%d\t%f\t%f\t%f\t%f\n", i + 1,
+							iter, gsl_matrix_get(all_stepwidths, i, n),
+							gsl_matrix_get(all_acceptance_rates, i, n),
+							gsl_matrix_get(all_accuracies, i, n), k);
+					fflush(progress_plot_file);
+				}
 			}
 		}
 	}
-	fclose(progress_plot_file);
+	if (progress_plot_file != NULL)
+		fclose(progress_plot_file);
 }
 
 void markov_chain_calibrate_quadratic(mcmc * m, double desired_acceptance_rate,
@@ -941,7 +963,7 @@ void markov_chain_calibrate_alt(mcmc * m, double desired_acceptance_rate,
 	double worst_accuracy_previous = 0;
 	double best_worst_accuracy = 1;
 	unsigned int iter = 0;
-	FILE * progress_plot_file = fopen("calibration_progress.data", "w");
+	FILE * progress_plot_file = open_progress_file(m);
 	gsl_vector * accuracies = gsl_vector_alloc(n_par);
 	gsl_vector_set_all(accuracies, 0);
 
@@ -983,9 +1005,10 @@ void markov_chain_calibrate_alt(mcmc * m, double desired_acceptance_rate,
 						current_acceptance_rate, accuracy,
 						desired_acceptance_rate, get_steps_for_normalized(m, i));
 
-				fprintf(progress_plot_file, "%d\t%d\t%f\t%f\t%f\n", i + 1,
-						iter, get_steps_for_normalized(m, i),
-						current_acceptance_rate, accuracy);
+				if (progress_plot_file != NULL)
+					fprintf(progress_plot_file, "%d\t%d\t%f\t%f\t%f\n", i + 1,
+							iter, get_steps_for_normalized(m, i),
+							current_acceptance_rate, accuracy);
 
 				/* keep track of worst performer */
 				/*if (worst_accuracy < accuracy) {*/
@@ -1032,7 +1055,8 @@ void markov_chain_calibrate_alt(mcmc * m, double desired_acceptance_rate,
 			break;
 		}
 	}
-	fclose(progress_plot_file);
+	if (progress_plot_file != NULL)
+		fclose(progress_plot_file);
 
 }
 
@@ -1050,9 +1074,8 @@ void markov_chain_calibrate_orig(mcmc * m, double rat_limit,
 	unsigned long subiter;
 	int nchecks_without_rescaling = 0;
 	int rescaled;
-	FILE * progress_plot_file = fopen("calibration_progress.data", "w");
+	FILE * progress_plot_file = open_progress_file(m);
 
-	assert(progress_plot_file != NULL);
 	/* we want a acceptance rate for each parameter */
 	rat_limit = pow(rat_limit, 1.0 / get_n_par(m));
 
@@ -1140,10 +1163,12 @@ void markov_chain_calibrate_orig(mcmc * m, double rat_limit,
 			accept_rate = get_accept_rate(m);
 			dump_v("New overall accept rate after reset", accept_rate);
 			for (i = 0; i < get_n_par(m); i++) {
-				fprintf(progress_plot_file, "%d\t%lu\t%f\t%f\t%f\n", i, iter,
-						get_steps_for_normalized(m, i), gsl_vector_get(
-								accept_rate, i), -1.);
-				fflush(progress_plot_file);
+				if (progress_plot_file != NULL) {
+					fprintf(progress_plot_file, "%d\t%lu\t%f\t%f\t%f\n", i, iter,
+							get_steps_for_normalized(m, i), gsl_vector_get(
+									accept_rate, i), -1.);
+					fflush(progress_plot_file);
+				}
 			}
 			gsl_vector_free(accept_rate);
 			delta_reject_accept_t = get_accept_rate_global(m)
@@ -1175,7 +1200,8 @@ void markov_chain_calibrate_orig(mcmc * m, double rat_limit,
 		}
 	}
 	reset_accept_rejects(m);
-	fclose(progress_plot_file);
+	if (progress_plot_file != NULL)
+		fclose(progress_plot_file);
 	debug("calibration of markov-chain done.");
 }
 
@@ -1183,6 +1209,15 @@ void markov_chain_calibrate(mcmc * m, const unsigned int burn_in_iterations,
 		double desired_acceptance_rate, const double max_ar_deviation,
 		const unsigned int iter_limit, double mul, const double adjust_step) {
 
+#ifdef ENSEMBLE
+	/* the ensemble adapts to the distribution by itself */
+	markov_chain_ensemble_burn_in(m, burn_in_iterations);
+	(void) desired_acceptance_rate;
+	(void) max_ar_deviation;
+	(void) iter_limit;
+	(void) mul;
+	(void) adjust_step;
+#else
 	burn_in(m, burn_in_iterations);
 
 	dump_d("desired acceptance rate", desired_acceptance_rate);
@@ -1201,4 +1236,5 @@ void markov_chain_calibrate(mcmc * m, const unsigned int burn_in_iterations,
 #endif
 #endif
 	(m, desired_acceptance_rate, max_ar_deviation, iter_limit, mul, adjust_step);
+#endif
 }
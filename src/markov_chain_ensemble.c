@@ -0,0 +1,353 @@
+/*
+    APEMoST - Automated Parameter Estimation and Model Selection Toolkit
+    Copyright (C) 2009  Johannes Buchner
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <omp.h>
+
+#include "mcmc.h"
+#include "mcmc_internal.h"
+#include "debug.h"
+#include "gsl_helper.h"
+#include "timing.h"
+
+#ifdef __NEVER_SET_FOR_DOCUMENTATION_ONLY
+/**
+ * Use the affine-invariant ensemble sampler of Goodman & Weare (2010)
+ * instead of the random walk when running the sampler.
+ *
+ * Every chain (i.e. every temperature) moves #ENSEMBLE_WALKERS walkers.
+ * A walker proposes a point along the line to a walker of the other half
+ * of the ensemble (stretch move), or around a few of them (walk move, see
+ * #ENSEMBLE_WALK_SIZE). The proposals follow the scale and correlations of
+ * the distribution, so the step width calibration is replaced by a burn-in
+ * of the ensemble. The step widths only scatter the walkers initially.
+ *
+ * The walkers of one half are evaluated in parallel when the chain is
+ * stepped outside of a parallel region (the calibration of the first
+ * chain). In the sampler, the chains run in parallel instead. The chain
+ * reports one walker after the other, so the output looks like that of a
+ * single chain. Proposals outside the parameter limits are rejected.
+ *
+ * Between neighbouring temperatures, walker w of one chain is swapped
+ * with walker w of the other, each pair with its own Metropolis test
+ * (Vousden, Farr & Mandel 2016).
+ */
+#define ENSEMBLE
+#endif
+
+static unsigned int get_n_walkers(const mcmc * m) {
+	unsigned int n = ENSEMBLE_WALKERS;
+	(void) m;
+	if (n == 0)
+		n = 2 * (get_n_par(m) + 1);
+	if (n < 4)
+		n = 4;
+	return n + n % 2;
+}
+
+/**
+ * the first walker starts at the current parameter values, the others are
+ * scattered around them by the step widths.
+ */
+static void ensemble_init(mcmc * m) {
+	unsigned int k;
+	unsigned int i;
+	double min;
+	double max;
+	double value;
+
+	m->ensemble = gsl_matrix_alloc(get_n_walkers(m), get_n_par(m));
+	gsl_matrix_set_row(m->ensemble, 0, get_params(m));
+	for (k = 1; k < m->ensemble->size1; k++) {
+		for (i = 0; i < get_n_par(m); i++) {
+			min = get_params_min_for(m, i);
+			max = get_params_max_for(m, i);
+			if (max <= min) {
+				value = min;
+			} else {
+				do {
+					value = get_params_for(m, i) + get_next_random_jump(m,
+							get_steps_for(m, i));
+				} while (value > max || value < min);
+			}
+			gsl_matrix_set(m->ensemble, k, i, value);
+		}
+	}
+}
+
+/**
+ * calculates the probabilities of the rows of positions, in parallel if
+ * not called from a parallel region. Rows outside the limits get -inf.
+ */
+static void evaluate(const mcmc * m, const gsl_matrix * positions,
+		gsl_vector * prob, gsl_vector * prior) {
+	int k;
+	const int n = positions->size1;
+
+#pragma omp parallel for
+	for (k = 0; k < n; k++) {
+		gsl_vector_const_view row = gsl_matrix_const_row(positions, k);
+		mcmc * s;
+
+		if (!mcmc_within_limits(m, &row.vector)) {
+			gsl_vector_set(prob, k, GSL_NEGINF);
+			gsl_vector_set(prior, k, 0);
+		} else {
+			s = markov_chain_scratch(m);
+			gsl_vector_memcpy(s->params, &row.vector);
+			calc_model(s, NULL);
+			gsl_vector_set(prob, k, get_prob(s));
+			gsl_vector_set(prior, k, get_prior(s));
+		}
+	}
+}
+
+/**
+ * the chain holds the walker whose turn it is
+ */
+static void show_walker(mcmc * m) {
+	const unsigned int w = m->ensemble_walker;
+
+	gsl_matrix_get_row(m->params, m->ensemble, w);
+	set_prob(m, gsl_vector_get(m->ensemble_prob, w));
+	set_prior(m, gsl_vector_get(m->ensemble_prior, w));
+}
+
+static unsigned int random_walker(mcmc * m, const unsigned int first,
+		const unsigned int n) {
+	unsigned int j = (unsigned int) (get_next_uniform_random(m) * n);
+	if (j >= n)
+		j = n - 1;
+	return first + j;
+}
+
+/**
+ * y = x_j + z (x_k - x_j), with the stretch factor z drawn from
+ * g(z) ~ 1/sqrt(z) on [1/a, a].
+ *
+ * @return log of the proposal ratio, (n_par - 1) log z
+ */
+static double stretch_move(mcmc * m, const unsigned int k,
+		const unsigned int first, const unsigned int n, gsl_vector * y) {
+	const double a = ENSEMBLE_STRETCH;
+	const double u = (a - 1) * get_next_uniform_random(m) + 1;
+	const double z = u * u / a;
+	gsl_vector_const_view x_k = gsl_matrix_const_row(m->ensemble, k);
+	gsl_vector_const_view x_j = gsl_matrix_const_row(m->ensemble,
+			random_walker(m, first, n));
+
+	gsl_vector_memcpy(y, &x_k.vector);
+	require(gsl_vector_sub(y, &x_j.vector));
+	gsl_vector_scale(y, z);
+	require(gsl_vector_add(y, &x_j.vector));
+	return (get_n_par(m) - 1) * log(z);
+}
+
+/**
+ * y = x_k + sum_j r_j (x_j - mean), over #ENSEMBLE_WALK_SIZE walkers x_j
+ * of the other half and standard normal r_j. This is symmetric.
+ *
+ * @return 0
+ */
+static double walk_move(mcmc * m, const unsigned int k,
+		const unsigned int first, const unsigned int n, gsl_vector * y) {
+	unsigned int size = ENSEMBLE_WALK_SIZE;
+	unsigned int chosen = 0;
+	unsigned int j;
+	unsigned int i;
+	unsigned int * partners;
+	double r;
+	gsl_vector * mean = gsl_vector_calloc(get_n_par(m));
+	gsl_vector_const_view x_k = gsl_matrix_const_row(m->ensemble, k);
+
+	if (size > n)
+		size = n;
+	partners = (unsigned int*) mem_calloc(size, sizeof(unsigned int));
+	/* selection sampling: every subset of the given size is equally likely */
+	for (j = 0; j < n && chosen < size; j++) {
+		if (get_next_uniform_random(m) * (n - j) < size - chosen) {
+			partners[chosen] = first + j;
+			chosen++;
+		}
+	}
+	for (j = 0; j < size; j++) {
+		gsl_vector_const_view x_j = gsl_matrix_const_row(m->ensemble,
+				partners[j]);
+		require(gsl_vector_add(mean, &x_j.vector));
+	}
+	gsl_vector_scale(mean, 1.0 / size);
+
+	gsl_vector_memcpy(y, &x_k.vector);
+	for (j = 0; j < size; j++) {
+		r = get_next_random_jump(m, 1.0);
+		for (i = 0; i < get_n_par(m); i++)
+			gsl_vector_set(y, i, gsl_vector_get(y, i) + r * (gsl_matrix_get(
+					m->ensemble, partners[j], i) - gsl_vector_get(mean, i)));
+	}
+	gsl_vector_free(mean);
+	mem_free(partners);
+	return 0;
+}
+
+void markov_chain_ensemble_step(mcmc * m) {
+	unsigned int h;
+	unsigned int k;
+	unsigned int w;
+	unsigned int n_half;
+	gsl_matrix * proposals;
+	gsl_vector * prob;
+	gsl_vector * prior;
+	gsl_vector * threshold;
+	TIMING_DECLARE(t)
+
+	TIMING_START(t);
+	mcmc_check(m);
+	if (m->ensemble == NULL)
+		ensemble_init(m);
+	n_half = m->ensemble->size1 / 2;
+	proposals = gsl_matrix_alloc(n_half, get_n_par(m));
+	prob = gsl_vector_alloc(n_half);
+	prior = gsl_vector_alloc(n_half);
+	threshold = gsl_vector_alloc(n_half);
+	if (m->ensemble_prob == NULL) {
+		m->ensemble_prob = gsl_vector_alloc(m->ensemble->size1);
+		m->ensemble_prior = gsl_vector_alloc(m->ensemble->size1);
+		TIMING_LAP(t, TIMING_PROPOSAL);
+		evaluate(m, m->ensemble, m->ensemble_prob, m->ensemble_prior);
+		TIMING_LAP(t, TIMING_MODEL);
+	}
+
+	for (h = 0; h < 2; h++) {
+		/* the random numbers are drawn here, the threads only evaluate */
+		for (k = 0; k < n_half; k++) {
+			gsl_vector_view y = gsl_matrix_row(proposals, k);
+			double correction;
+
+			if (ENSEMBLE_WALK_SIZE > 0)
+				correction = walk_move(m, h * n_half + k, (1 - h) * n_half,
+						n_half, &y.vector);
+			else
+				correction = stretch_move(m, h * n_half + k, (1 - h)
+						* n_half, n_half, &y.vector);
+			gsl_vector_set(threshold, k, get_next_alog_urandom(m)
+					- correction);
+		}
+		TIMING_LAP(t, TIMING_PROPOSAL);
+		evaluate(m, proposals, prob, prior);
+		TIMING_LAP(t, TIMING_MODEL);
+
+		for (k = 0; k < n_half; k++) {
+			w = h * n_half + k;
+			if (gsl_vector_get(prob, k) - gsl_vector_get(m->ensemble_prob, w)
+					> gsl_vector_get(threshold, k)) {
+				gsl_vector_view y = gsl_matrix_row(proposals, k);
+				gsl_matrix_set_row(m->ensemble, w, &y.vector);
+				gsl_vector_set(m->ensemble_prob, w, gsl_vector_get(prob, k));
+				gsl_vector_set(m->ensemble_prior, w, gsl_vector_get(prior, k));
+				inc_params_accepts(m);
+			} else {
+				inc_params_rejects(m);
+			}
+		}
+		TIMING_LAP(t, TIMING_ACCEPT);
+	}
+
+	for (w = 0; w < m->ensemble->size1; w++) {
+		if (gsl_vector_get(m->ensemble_prob, w) > get_prob_best(m)) {
+			gsl_vector_view x = gsl_matrix_row(m->ensemble, w);
+			set_prob_best(m, gsl_vector_get(m->ensemble_prob, w));
+			set_params_best(m, &x.vector);
+		}
+	}
+	m->ensemble_walker = (m->ensemble_walker + 1) % m->ensemble->size1;
+	show_walker(m);
+
+	gsl_matrix_free(proposals);
+	gsl_vector_free(prob);
+	gsl_vector_free(prior);
+	gsl_vector_free(threshold);
+	TIMING_LAP(t, TIMING_ACCEPT);
+}
+
+void markov_chain_ensemble_burn_in(mcmc * m,
+		const unsigned int burn_in_iterations) {
+	unsigned long iter;
+	unsigned int i;
+	unsigned int w;
+	double mean;
+	double var;
+	const unsigned int n_walkers = get_n_walkers(m);
+
+	debug("Starting ensemble burn-in ...");
+	mcmc_check(m);
+	for (iter = 0; iter < burn_in_iterations; iter += n_walkers) {
+		markov_chain_ensemble_step(m);
+		if (iter / n_walkers % 200 == 0) {
+			dump_ul("\tBurn-in Iteration", iter);
+			IFVERBOSE
+				dump_v("params", get_params(m));
+		}
+	}
+	for (i = 0; i < get_n_par(m); i++) {
+		mean = 0;
+		var = 0;
+		for (w = 0; w < n_walkers; w++)
+			mean += gsl_matrix_get(m->ensemble, w, i) / n_walkers;
+		for (w = 0; w < n_walkers; w++)
+			var += pow(gsl_matrix_get(m->ensemble, w, i) - mean, 2)
+					/ (n_walkers - 1);
+		if (var > 0)
+			set_steps_for(m, sqrt(var), i);
+	}
+	restart_from_best(m);
+	debug("Burn-in done.");
+	dump_v("spread of the walkers", get_steps(m));
+}
+
+unsigned int markov_chain_ensemble_swap(mcmc * a, mcmc * b,
+		const double beta_a, const double beta_b) {
+	unsigned int w;
+	unsigned int n = 0;
+	double like_a;
+	double like_b;
+	double prior_a;
+	double prior_b;
+
+	assert(a->ensemble_prob != NULL && b->ensemble_prob != NULL);
+	assert(a->ensemble->size1 == b->ensemble->size1);
+	for (w = 0; w < a->ensemble->size1; w++) {
+		prior_a = gsl_vector_get(a->ensemble_prior, w);
+		prior_b = gsl_vector_get(b->ensemble_prior, w);
+		like_a = (gsl_vector_get(a->ensemble_prob, w) - prior_a) / beta_a;
+		like_b = (gsl_vector_get(b->ensemble_prob, w) - prior_b) / beta_b;
+		if ((beta_a - beta_b) * (like_b - like_a) > get_next_alog_urandom(a)) {
+			gsl_vector_view x_a = gsl_matrix_row(a->ensemble, w);
+			gsl_vector_view x_b = gsl_matrix_row(b->ensemble, w);
+			require(gsl_vector_swap(&x_a.vector, &x_b.vector));
+			/* the likelihoods are tempered with the other beta now */
+			gsl_vector_set(a->ensemble_prob, w, prior_b + beta_a * like_b);
+			gsl_vector_set(a->ensemble_prior, w, prior_b);
+			gsl_vector_set(b->ensemble_prob, w, prior_a + beta_b * like_a);
+			gsl_vector_set(b->ensemble_prior, w, prior_a);
+			n++;
+		}
+	}
+	show_walker(a);
+	show_walker(b);
+	return n;
+}
@@ -0,0 +1,214 @@
+/*
+    APEMoST - Automated Parameter Estimation and Model Selection Toolkit
+    Copyright (C) 2009  Johannes Buchner
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <omp.h>
+#include <gsl/gsl_randist.h>
+
+#include "mcmc.h"
+#include "mcmc_internal.h"
+#include "debug.h"
+#include "gsl_helper.h"
+#include "timing.h"
+
+#ifdef __NEVER_SET_FOR_DOCUMENTATION_ONLY
+/**
+ * Use Hamiltonian Monte Carlo instead of the random walk when running the
+ * sampler.
+ *
+ * Every chain follows the gradient of its own probability (including its
+ * beta) for #HMC_LEAPFROG_STEPS leapfrog steps. The calibrated step widths
+ * are used as scale of the momentum of each parameter, so the calibration
+ * phases stay the same.
+ *
+ * The gradient is taken from calc_model_gradient() if the application
+ * provides it. Otherwise it is estimated with finite differences, which
+ * costs one additional model evaluation per parameter. These evaluations
+ * run in parallel. In the sampler they are tasks, which the threads
+ * without a chain of their own help with, so they only gain if there are
+ * more threads than chains.
+ */
+#define HMC
+#endif
+
+/**
+ * forward difference of the probability in parameter i
+ */
+static void estimate_partial(const mcmc * m, gsl_vector * gradient,
+		const unsigned int i, const double prob) {
+	mcmc * s = markov_chain_scratch(m);
+	const double value = get_params_for(m, i);
+	double h = HMC_GRADIENT_EPSILON * get_steps_for(m, i);
+
+	if (value + h > get_params_max_for(m, i))
+		h = -h;
+	set_params_for(s, value + h, i);
+	calc_model(s, NULL);
+	gsl_vector_set(gradient, i, (get_prob(s) - prob) / h);
+}
+
+/**
+ * forward differences of the probability.
+ * The probability of the current parameter values has to be up to date.
+ */
+static void estimate_gradient(mcmc * m, gsl_vector * gradient) {
+	int i;
+	const int n_par = get_n_par(m);
+	const double prob = get_prob(m);
+
+	if (omp_in_parallel()) {
+		/* a nested parallel region would be inactive */
+		for (i = 0; i < n_par; i++) {
+#pragma omp task
+			estimate_partial(m, gradient, i, prob);
+		}
+#pragma omp taskwait
+	} else {
+#pragma omp parallel for
+		for (i = 0; i < n_par; i++)
+			estimate_partial(m, gradient, i, prob);
+	}
+}
+
+static void calc_gradient(mcmc * m, gsl_vector * gradient) {
+	if (calc_model_gradient != NULL) {
+		calc_model_gradient(m, gradient);
+	} else {
+		estimate_gradient(m, gradient);
+	}
+}
+
+/**
+ * bounce off the parameter borders. The momentum is inverted on each
+ * reflection, which keeps the leapfrog integrator reversible.
+ */
+static double reflect(double value, const double min, const double max,
+		double * momentum) {
+	if (max <= min)
+		return min;
+	while (value > max || value < min) {
+		if (value > max)
+			value = 2 * max - value;
+		else
+			value = 2 * min - value;
+		*momentum = -*momentum;
+	}
+	return value;
+}
+
+static double kinetic_energy(const gsl_vector * momentum) {
+	unsigned int i;
+	double sum = 0;
+	for (i = 0; i < momentum->size; i++) {
+		sum += gsl_vector_get(momentum, i) * gsl_vector_get(momentum, i);
+	}
+	return sum / 2;
+}
+
+/**
+ * momentum += factor * step width * gradient
+ */
+static void kick(const mcmc * m, gsl_vector * momentum,
+		const gsl_vector * gradient, const double factor) {
+	unsigned int i;
+	for (i = 0; i < get_n_par(m); i++) {
+		gsl_vector_set(momentum, i, gsl_vector_get(momentum, i) + factor
+				* get_steps_for(m, i) * gsl_vector_get(gradient, i));
+	}
+}
+
+/**
+ * parameters += eps * step width * momentum, reflected at the borders
+ */
+static void drift(mcmc * m, gsl_vector * momentum, const double eps) {
+	unsigned int i;
+	double p;
+	double value;
+	for (i = 0; i < get_n_par(m); i++) {
+		p = gsl_vector_get(momentum, i);
+		value = get_params_for(m, i) + eps * get_steps_for(m, i) * p;
+		value = reflect(value, get_params_min_for(m, i),
+				get_params_max_for(m, i), &p);
+		set_params_for(m, value, i);
+		gsl_vector_set(momentum, i, p);
+	}
+}
+
+void markov_chain_hmc_step(mcmc * m) {
+	unsigned int i;
+	unsigned int l;
+	const unsigned int n_par = get_n_par(m);
+	const double prob_old = get_prob(m);
+	const double prior_old = get_prior(m);
+	const double eps = HMC_STEPSIZE * (0.8 + 0.4 * get_next_uniform_random(m));
+	double energy_old;
+	double energy_new;
+	gsl_vector * old_values = dup_vector(get_params(m));
+	gsl_vector * momentum = gsl_vector_alloc(n_par);
+	gsl_vector * gradient = gsl_vector_alloc(n_par);
+	int diverged = 0;
+	TIMING_DECLARE(t)
+
+	TIMING_START(t);
+	mcmc_check(m);
+	for (i = 0; i < n_par; i++) {
+#ifdef BLOCK_RANDOM
+		gsl_vector_set(momentum, i, random_block_normal(m->random_block));
+#else
+		gsl_vector_set(momentum, i, gsl_ran_gaussian(get_random(m), 1.0));
+#endif
+	}
+	energy_old = kinetic_energy(momentum) - prob_old;
+	TIMING_LAP(t, TIMING_PROPOSAL);
+
+	calc_gradient(m, gradient);
+	TIMING_LAP(t, TIMING_MODEL);
+	kick(m, momentum, gradient, eps / 2);
+	for (l = 0; l < HMC_LEAPFROG_STEPS; l++) {
+		drift(m, momentum, eps);
+		TIMING_LAP(t, TIMING_PROPOSAL);
+		calc_model(m, NULL);
+		if (!gsl_finite(get_prob(m))) {
+			diverged = 1;
+			break;
+		}
+		calc_gradient(m, gradient);
+		TIMING_LAP(t, TIMING_MODEL);
+		kick(m, momentum, gradient, l + 1 == HMC_LEAPFROG_STEPS ? eps / 2
+				: eps);
+	}
+	TIMING_LAP(t, TIMING_PROPOSAL);
+	energy_new = kinetic_energy(momentum) - get_prob(m);
+
+	if (diverged == 0 && gsl_finite(energy_new) && (energy_new <= energy_old
+			|| get_next_alog_urandom(m) < energy_old - energy_new)) {
+		IFVERBOSE
+			dump_d("accepting hmc step with energy change", energy_new - energy_old);
+		inc_params_accepts(m);
+		gsl_vector_free(old_values);
+	} else {
+		IFVERBOSE
+			dump_d("rejecting hmc step with energy change", energy_new - energy_old);
+		set_prob(m, prob_old);
+		set_prior(m, prior_old);
+		set_params(m, old_values);
+		inc_params_rejects(m);
+	}
+	gsl_vector_free(momentum);
+	gsl_vector_free(gradient);
+	TIMING_LAP(t, TIMING_ACCEPT);
+}
@@ -21,25 +21,79 @@
 #include <libgen.h>
 
 #include "mcmc.h"
+#include "mcmc_internal.h"
 #include "gsl_helper.h"
 #include "debug.h"
 
-gsl_rng * r = NULL;
+/** one generator per thread, so jobs in different threads are independent */
+static gsl_rng * r = NULL;
+#pragma omp threadprivate(r)
 
 void init_seed(mcmc * m) {
 	if (r == NULL) {
-		gsl_rng_env_setup();
-		r = gsl_rng_alloc(gsl_rng_default);
+#pragma omp critical (random_setup)
+		{
+			gsl_rng_env_setup();
+			r = gsl_rng_alloc(gsl_rng_default);
+		}
 	}
 	m->random = r;
+#ifdef BLOCK_RANDOM
+	m->random_block = random_block_alloc(gsl_rng_get(r));
+	assert(m->random_block != NULL);
+#else
+	m->random_block = NULL;
+#endif
 }
 
-mcmc * mcmc_init(const unsigned int n_pars) {
+void mcmc_reset_random() {
+	if (r != NULL)
+		gsl_rng_set(r, gsl_rng_default_seed);
+}
+
+/**
+ * the parameters listed in #CIRCULAR_PARAMS default to #BOUNDARY_CIRCULAR
+ */
+static void set_circular_params(mcmc * m) {
+	const unsigned int circular[] = { CIRCULAR_PARAMS, 0 };
+	unsigned int j;
+	for (j = 0; circular[j] != 0; j++) {
+		if (circular[j] <= m->n_par)
+			m->params_boundary[circular[j] - 1] = BOUNDARY_CIRCULAR;
+	}
+}
+
+static gsl_vector * chain_vector(mcmc * m, const unsigned int k,
+		double * values) {
+	m->views[k] = gsl_vector_view_array(values, m->n_par);
+	return &m->views[k].vector;
+}
+
+/** rounds up to whole cache lines */
+#define CACHE_LINES(size) (((size) + CACHE_LINE_SIZE - 1) / CACHE_LINE_SIZE \
+		* CACHE_LINE_SIZE)
+
+/**
+ * allocates the object, without a random generator
+ */
+static mcmc * mcmc_alloc(const unsigned int n_pars) {
 	mcmc * m;
+	void * arena;
+	double * values;
+	const size_t head = CACHE_LINES(sizeof(mcmc));
+	size_t size = n_pars * (2 * sizeof(unsigned long) + sizeof(unsigned int));
+
+#ifndef N_PARAMETERS
+	size += 5 * n_pars * sizeof(double);
+#endif
 	IFSEGV
 		debug("allocating mcmc struct");
-	m = (mcmc*) mem_malloc(sizeof(mcmc));
-	assert(m != NULL);
+	/* zeroed; one more cache line, to align the start */
+	arena = mem_calloc(1, head + CACHE_LINES(size) + CACHE_LINE_SIZE);
+	assert(arena != NULL);
+	m = (mcmc*) ((char *) arena + CACHE_LINE_SIZE - (unsigned long) arena
+			% CACHE_LINE_SIZE);
+	m->arena = arena;
 	m->n_iter = 0;
 	m->n_par = n_pars;
 	m->accept = 0;
@@ -49,70 +103,149 @@ mcmc * mcmc_init(const unsigned int n_pars) {
 	m->prob_best = -1e+10;
 	m->files = NULL;
 
-	init_seed(m);
-
-	m->params = gsl_vector_alloc(m->n_par);
-	assert(m->params != NULL);
-	m->params_best = gsl_vector_alloc(m->n_par);
-	assert(m->params_best != NULL);
-
-	m->params_accepts
-			= (unsigned long*) mem_calloc(m->n_par, sizeof(unsigned long));
-	assert(m->params_accepts != NULL);
-	m->params_rejects
-			= (unsigned long*) mem_calloc(m->n_par, sizeof(unsigned long));
-	assert(m->params_rejects != NULL);
-	m->params_step = gsl_vector_calloc(m->n_par);
-	assert(m->params_step != NULL);
-	m->params_min = gsl_vector_calloc(m->n_par);
-	assert(m->params_min != NULL);
-	m->params_max = gsl_vector_calloc(m->n_par);
-	assert(m->params_max != NULL);
+	values = (double *) ((char *) m + head);
+#ifdef N_PARAMETERS
+	if (m->n_par != N_PARAMETERS) {
+		fprintf(stderr, "compiled for %d parameters (N_PARAMETERS), "
+			"but %d given.\n", N_PARAMETERS, m->n_par);
+		exit(1);
+	}
+	m->params = chain_vector(m, 0, m->values.params);
+	m->params_best = chain_vector(m, 1, m->values.params_best);
+	m->params_step = chain_vector(m, 2, m->values.params_step);
+	m->params_min = chain_vector(m, 3, m->values.params_min);
+	m->params_max = chain_vector(m, 4, m->values.params_max);
+#else
+	m->params = chain_vector(m, 0, values);
+	m->params_best = chain_vector(m, 1, values + n_pars);
+	m->params_step = chain_vector(m, 2, values + 2 * n_pars);
+	m->params_min = chain_vector(m, 3, values + 3 * n_pars);
+	m->params_max = chain_vector(m, 4, values + 4 * n_pars);
+	values += 5 * n_pars;
+#endif
+	m->params_accepts = (unsigned long *) values;
+	m->params_rejects = m->params_accepts + n_pars;
+	m->params_boundary = (unsigned int *) (m->params_rejects + n_pars);
+	set_circular_params(m);
 
 	m->params_descr = (const char**) mem_calloc(m->n_par, sizeof(char*));
 
+	m->ensemble = NULL;
+	m->ensemble_prob = NULL;
+	m->ensemble_prior = NULL;
+	m->ensemble_walker = 0;
+
 	m->data = NULL;
+	m->prepared = NULL;
+	m->data_float = NULL;
+	m->additional_data = NULL;
+	m->context = NULL;
 	IFSEGV
 		debug("allocating mcmc struct done");
 	return m;
 }
 
+mcmc * mcmc_init(const unsigned int n_pars) {
+	mcmc * m = mcmc_alloc(n_pars);
+
+	init_seed(m);
+	return m;
+}
+
+static void copy_state(mcmc * c, const mcmc * m) {
+	unsigned int i;
+
+	c->n_iter = m->n_iter;
+	c->accept = m->accept;
+	c->reject = m->reject;
+	c->prob = m->prob;
+	c->prior = m->prior;
+	c->prob_best = m->prob_best;
+	gsl_vector_memcpy(c->params, m->params);
+	gsl_vector_memcpy(c->params_best, m->params_best);
+	gsl_vector_memcpy(c->params_step, m->params_step);
+	gsl_vector_memcpy(c->params_min, m->params_min);
+	gsl_vector_memcpy(c->params_max, m->params_max);
+	for (i = 0; i < get_n_par(m); i++) {
+		c->params_accepts[i] = m->params_accepts[i];
+		c->params_rejects[i] = m->params_rejects[i];
+		c->params_boundary[i] = m->params_boundary[i];
+	}
+	c->data = m->data;
+	c->prepared = m->prepared;
+	c->data_float = m->data_float;
+	c->additional_data = m->additional_data;
+	c->context = m->context;
+}
+
+mcmc * mcmc_clone(const mcmc * m) {
+	unsigned int i;
+	mcmc * c = mcmc_init(get_n_par(m));
+
+	copy_state(c, m);
+	for (i = 0; i < get_n_par(m); i++) {
+		if (m->params_descr[i] != NULL)
+			c->params_descr[i] = my_strdup(m->params_descr[i]);
+	}
+	return c;
+}
+
+mcmc * mcmc_clone_shared(const mcmc * m, const unsigned long seed) {
+	mcmc * c = mcmc_alloc(get_n_par(m));
+
+	/* nothing is drawn from the generator, so copies can be made in
+	 * parallel */
+	c->random = m->random;
+#ifdef BLOCK_RANDOM
+	c->random_block = random_block_alloc(seed);
+	assert(c->random_block != NULL);
+#else
+	(void) seed;
+	c->random_block = NULL;
+#endif
+	copy_state(c, m);
+	mem_free(c->params_descr);
+	c->params_descr = m->params_descr;
+	return c;
+}
+
 mcmc * mcmc_free(mcmc * m) {
 	unsigned int i;
 
 	mcmc_dump_close(m);
 	
-	if (r == m->random) {
+	if (m->random != NULL && r == m->random) {
 		gsl_rng_free(r);
 		r = NULL;
 	}
+	if (m->random_block != NULL)
+		random_block_free(m->random_block);
 	
-	IFSEGV
-		debug("freeing params");
-	gsl_vector_free(m->params);
-	IFSEGV
-		debug("freeing params_best");
-	gsl_vector_free(m->params_best);
-
-	IFSEGV
-		debug("freeing params_descr");
-	for (i = 0; i < get_n_par(m); i++) {
-		mem_free(m->params_descr[i]);
+	if (m->params_descr != NULL) {
+		IFSEGV
+			debug("freeing params_descr");
+		for (i = 0; i < get_n_par(m); i++) {
+			mem_free(m->params_descr[i]);
+		}
+		mem_free(m->params_descr);
 	}
-	mem_free(m->params_descr);
 
-	IFSEGV
-		debug("freeing accepts/rejects");
-	mem_free(m->params_accepts);
-	mem_free(m->params_rejects);
-	IFSEGV
-		debug("freeing step/min/max");
-	gsl_vector_free(m->params_step);
-	gsl_vector_free(m->params_min);
-	gsl_vector_free(m->params_max);
-	if (m->data != NULL)
+	if (m->ensemble != NULL)
+		gsl_matrix_free(m->ensemble);
+	if (m->ensemble_prob != NULL) {
+		gsl_vector_free(m->ensemble_prob);
+		gsl_vector_free(m->ensemble_prior);
+	}
+	if (m->data != NULL) {
 		gsl_matrix_free((gsl_matrix*) m->data);
-	mem_free(m);
+		if (m->prepared != NULL)
+			gsl_matrix_free((gsl_matrix*) m->prepared);
+		if (m->data_float != NULL)
+			mem_free(m->data_float);
+	}
+	IFSEGV
+		debug("freeing mcmc struct with the parameter arrays");
+	mem_free(m->arena);
 	m = NULL;
 	return NULL;
 }
@@ -27,13 +27,18 @@
 #include <stdlib.h>
 
 /**
- * How many digits should be used for writing numbers out?
+ * How many digits should be used for writing numbers out with printf?
  *
- * If you find the precision too low, increase here.
- * If you find the program too slow, decrease here.
+ * Only used with #DUMP_PRINTF. Otherwise numbers are written with as many
+ * digits as needed to read back the same value (see format_double()).
  */
 #define DUMP_FORMAT "%.15e"
 
+/**
+ * Size of the output buffer of each dump file (in bytes).
+ */
+#define DUMP_BUFFER_SIZE 65536
+
 #ifdef __NEVER_SET_FOR_DOCUMENTATION_ONLY
 /**
  * Turns additional sanity checks off.
@@ -68,14 +73,20 @@ mcmc * mcmc_load(const char * filename, const char * datafilename);
 mcmc * mcmc_load_params(const char * filename);
 
 /**
- * loads the data from the given file as x/y values
+ * name of the boundary kind (e.g. #BOUNDARY_REFLECT) in the params file
+ */
+const char * mcmc_boundary_name(const unsigned int boundary);
+
+/**
+ * loads the data from the given file as x/y values and calls
+ * model_prepare() on it, if provided.
  * @param m
  * @param datafilename
  */
 void mcmc_load_data(mcmc * m, const char * datafilename);
 
 /**
- * reference to another object for x and y-data.
+ * reference to another object for x and y-data (and the prepared data).
  *
  * @param m the object to fill
  * @param m_orig the object with loaded data
@@ -88,6 +99,40 @@ void mcmc_reuse_data(mcmc * m, const mcmc * m_orig);
  */
 mcmc * mcmc_free(mcmc * m);
 
+/**
+ * creates a copy of the class.
+ *
+ * Parameter values, limits, step widths and descriptions are copied.
+ * The data, prepared data and additional_data are referenced, not copied;
+ * no dump files are opened.
+ * Before freeing the copy, call <code>set_data(m, NULL)</code> as for
+ * chains that reuse data.
+ *
+ * @param m the object to copy
+ * @return the created mcmc class
+ */
+mcmc * mcmc_clone(const mcmc * m);
+
+/**
+ * creates a copy of the mcmc object, as mcmc_clone(), but the parameter
+ * descriptions and the random generator are shared with m instead of
+ * copied.
+ * Before freeing the copy, call <code>set_params_descr_all(m, NULL)</code>
+ * and <code>set_data(m, NULL)</code>.
+ *
+ * @param m the object to copy
+ * @param seed seed of the buffered random numbers of the copy
+ * (BLOCK_RANDOM)
+ * @return the created mcmc class
+ */
+mcmc * mcmc_clone_shared(const mcmc * m, const unsigned long seed);
+
+/**
+ * restarts the random generator of the calling thread from the seed, as in
+ * a newly started program.
+ */
+void mcmc_reset_random();
+
 /**
  * checks the pointers and dimensions
  */
@@ -148,6 +193,11 @@ void mcmc_dump_probabilities(const mcmc * m, int n_values, const char * suffix);
  */
 void mcmc_check_best(mcmc * m);
 
+/**
+ * @return 1 if all values lie within the limits of the parameters, 0 otherwise
+ */
+int mcmc_within_limits(const mcmc * m, const gsl_vector * params);
+
 #include "markov_chain.h"
 
 #include "mcmc_gettersetter.h"
@@ -172,5 +222,88 @@ void calc_model(mcmc * m, const gsl_vector * old_values);
  */
 void calc_model_for(mcmc * m, const unsigned int i, const double old_value);
 
+#ifdef __GNUC__
+/**
+ * Marks a calculation the application may, but does not have to provide.
+ * If it is not provided, its address is NULL.
+ */
+#define OPTIONAL_CALLBACK __attribute__((weak))
+#else
+#define OPTIONAL_CALLBACK
+#endif
+
+/**
+ * calculate the gradient of the probability with respect to the parameters
+ * at the current parameter values (optional).
+ *
+ * The probability is the one calc_model() sets, i.e. including the beta
+ * of the chain.
+ * If the application does not provide this function, the gradient is
+ * estimated with finite differences.
+ *
+ * @param m
+ * @param gradient here the n_par partial derivatives are stored
+ */
+void calc_model_gradient(mcmc * m, gsl_vector * gradient) OPTIONAL_CALLBACK;
+
+/**
+ * derive quantities from the data that do not depend on the parameters
+ * (optional).
+ *
+ * Called once when the data is loaded. The result is available to
+ * calc_model() as m->prepared and, like the data, shared read-only by
+ * all chains.
+ *
+ * @param data the observations
+ * @return a newly allocated matrix, usually with one row per observation
+ */
+gsl_matrix * model_prepare(const gsl_matrix * data) OPTIONAL_CALLBACK;
+
+/**
+ * calculate the log prior of the current parameter values (optional).
+ *
+ * If the application provides calc_model_likelihood() or
+ * calc_model_likelihood_bounded(), the random walk evaluates the prior
+ * of a proposal first, and skips the likelihood if the proposal is
+ * rejected already by the prior (see #LIKELIHOOD_MAX). Without this
+ * function, the prior is 0. calc_model() is still needed elsewhere and
+ * has to give the same probability.
+ *
+ * @param m
+ * @return log prior, -inf outside of the allowed region
+ */
+double calc_model_prior(mcmc * m) OPTIONAL_CALLBACK;
+
+/**
+ * calculate the part of the probability that depends on the data at the
+ * current parameter values (optional, see calc_model_prior()).
+ *
+ * The probability of the chain is the prior plus this value, so it
+ * includes the beta of the chain.
+ *
+ * @param m
+ * @return tempered log likelihood
+ */
+double calc_model_likelihood(mcmc * m) OPTIONAL_CALLBACK;
+
+/**
+ * calculate the likelihood as calc_model_likelihood(), but stop as soon as
+ * the result is known to be at most bound (optional, instead of
+ * calc_model_likelihood()).
+ *
+ * The random walk passes the lowest value for which the proposal would
+ * still be accepted. If the log likelihood is a sum of non-positive terms
+ * (chi-square, Bernoulli), the partial sum can be returned once it falls
+ * below bound. The bound includes the beta of the chain, so compare it to
+ * beta times the partial sum.
+ *
+ * @param m
+ * @param bound all results at or below this reject the proposal; -inf
+ * for the full calculation
+ * @return tempered log likelihood, or any value at or below bound
+ */
+double calc_model_likelihood_bounded(mcmc * m, const double bound)
+		OPTIONAL_CALLBACK;
+
 #endif
 
@@ -40,3 +40,13 @@ void mcmc_check_best(mcmc * m) {
 	}
 }
 
+int mcmc_within_limits(const mcmc * m, const gsl_vector * params) {
+	unsigned int i;
+	for (i = 0; i < m->n_par; i++) {
+		if (gsl_vector_get(params, i) > gsl_vector_get(m->params_max, i)
+				|| gsl_vector_get(params, i) < gsl_vector_get(m->params_min, i))
+			return 0;
+	}
+	return 1;
+}
+
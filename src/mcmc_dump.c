@@ -22,6 +22,8 @@
 
 #include "mcmc.h"
 #include "debug.h"
+#include "utils.h"
+#include "format_double.h"
 
 #ifdef NODUMP
 #define ASSURE_DUMP_ENABLED return;
@@ -37,15 +39,17 @@ static void mcmc_dump(const gsl_matrix * data, const gsl_vector * y_dat,
 	FILE * output;
 	ASSURE_DUMP_ENABLED;
 	assert(data->size1 == y_dat->size);
-	output = fopen(filename, "w");
+	output = job_fopen(filename, "w");
 	assert(output != NULL);
 	IFVERBOSE
 		dump_s("writing dump to file", filename);
 	for (i = 0; i < data->size1; i++) {
 		for (j = 0; j < data->size2; j++) {
-			fprintf(output, DUMP_FORMAT "\t", gsl_matrix_get(data, i, j));
+			fprint_double(output, gsl_matrix_get(data, i, j));
+			fputc('\t', output);
 		}
-		fprintf(output, DUMP_FORMAT "\n", gsl_vector_get(y_dat, i));
+		fprint_double(output, gsl_vector_get(y_dat, i));
+		fputc('\n', output);
 	}
 	r = fclose(output);
 	assert (r == 0);
@@ -69,8 +73,9 @@ void mcmc_open_dump_files(mcmc * m, const char * suffix, int index, char * mode)
 		sprintf(filenames[i], "%s%s-%d.prob.dump", m->params_descr[i], suffix, index);
 		IFVERBOSE
 			dump_s("probability/distribution file", filenames[i]);
-		m->files[i] = fopen(filenames[i], mode);
+		m->files[i] = job_fopen(filenames[i], mode);
 		assert(m->files[i] != NULL);
+		setvbuf(m->files[i], NULL, _IOFBF, DUMP_BUFFER_SIZE);
 		mem_free(filenames[i]);
 	}
 	mem_free(filenames);
@@ -83,7 +88,8 @@ void mcmc_dump_current(const mcmc * m) {
 	for (i = 0; i < get_n_par(m); i++) {
 		if (m->files[i] == NULL)
 			continue;
-		fprintf(m->files[i], DUMP_FORMAT "\n", gsl_vector_get(m->params, i));
+		fprint_double(m->files[i], gsl_vector_get(m->params, i));
+		fputc('\n', m->files[i]);
 	}
 }
 
@@ -18,6 +18,7 @@
 
 #include "mcmc.h"
 #include "gsl_helper.h"
+#include "debug.h"
 #include <gsl/gsl_rng.h>
 #include <gsl/gsl_randist.h>
 #include <gsl/gsl_sf.h>
@@ -165,6 +166,11 @@ void set_steps_for_normalized(mcmc * m, const double new_step, const unsigned in
  * If in doubt, do not set, as your program then can be used for any
  * problems regardless of number of parameters.
  *
+ * The parameter values, best values, step widths and limits are then
+ * stored in fixed-size arrays inside the mcmc struct instead of separate
+ * vectors, and are accessed directly (see mcmc::values). The loops over
+ * the parameters have a constant count, so the compiler can unroll them.
+ *
  * my favorite trick: automatically count the lines in the current file
  * CCFLAGS="-DN_PARAMETERS="$(cat params|wc -l)"
  */
@@ -183,44 +189,55 @@ void set_params_best(mcmc * m, const gsl_vector * new_params_best) {
 	gsl_vector_memcpy(m->params_best, new_params_best);
 }
 
+#ifndef N_PARAMETERS
 void set_params_for(mcmc * m, const double new_param, const unsigned int i) {
 	assert(i < m->n_par);
 	gsl_vector_set(m->params, i, new_param);
 }
+#endif
 
 gsl_vector * get_params(const mcmc * m) {
 	return m->params;
 }
 
+#ifndef N_PARAMETERS
 double get_params_for(const mcmc * m, const unsigned int i) {
 	return gsl_vector_get(m->params, i);
 }
+#endif
 
 gsl_vector * get_params_min(const mcmc * m) {
 	return m->params_min;
 }
 
+#ifndef N_PARAMETERS
 double get_params_min_for(const mcmc * m, const unsigned int i) {
 	return gsl_vector_get(m->params_min, i);
 }
+#endif
 gsl_vector * get_params_max(const mcmc * m) {
 	return m->params_max;
 }
+#ifndef N_PARAMETERS
 double get_params_max_for(const mcmc * m, const unsigned int i) {
 	return gsl_vector_get(m->params_max, i);
 }
+#endif
 
 gsl_vector * get_params_best(const mcmc * m) {
 	return m->params_best;
 }
+#ifndef N_PARAMETERS
 double get_params_best_for(const mcmc * m, const unsigned int i) {
 	return gsl_vector_get(m->params_best, i);
 }
+#endif
 
 void set_params(mcmc * m, gsl_vector * new_params) {
 	assert(m->n_par == new_params->size);
-	gsl_vector_free(m->params);
-	m->params = new_params;
+	/* the storage belongs to the chain (mcmc::arena); take over the values */
+	gsl_vector_memcpy(m->params, new_params);
+	gsl_vector_free(new_params);
 }
 
 void set_params_descr_all(mcmc * m, const char ** new_par_descr) {
@@ -232,12 +249,31 @@ void set_params_descr_for(mcmc * m, const char * new_par_descr,
 	m->params_descr[i] = new_par_descr;
 }
 
+unsigned int get_params_boundary_for(const mcmc * m, const unsigned int i) {
+	return m->params_boundary[i];
+}
+
+void set_params_boundary_for(mcmc * m, const unsigned int new_boundary,
+		const unsigned int i) {
+	m->params_boundary[i] = new_boundary;
+}
+
 gsl_rng * get_random(const mcmc * m) {
 	return m->random;
 }
 
 void set_random(mcmc * m, gsl_rng * newrandom) {
 	m->random = newrandom;
+	if (m->random_block != NULL && newrandom != NULL)
+		random_block_seed(m->random_block, gsl_rng_get(newrandom));
+}
+
+const void * get_context(const mcmc * m) {
+	return m->context;
+}
+
+void set_context(mcmc * m, const void * new_context) {
+	m->context = new_context;
 }
 
 void set_prob(mcmc * m, const double new_prob) {
@@ -249,17 +285,43 @@ void set_prior(mcmc * m, const double new_prior) {
 const gsl_matrix * get_data(const mcmc * m) {
 	return m->data;
 }
+#ifdef SINGLE_PRECISION
+static const float * data_to_float(const gsl_matrix * data) {
+	unsigned int i;
+	unsigned int j;
+	float * columns = (float *) mem_malloc(data->size1 * data->size2
+			* sizeof(float));
+	assert(columns != NULL);
+	for (j = 0; j < data->size2; j++) {
+		for (i = 0; i < data->size1; i++) {
+			columns[j * data->size1 + i] = (float) gsl_matrix_get(data, i, j);
+		}
+	}
+	return columns;
+}
+#endif
+
 void set_data(mcmc * m, const gsl_matrix * new_data) {
 	m->data = new_data;
+	m->prepared = NULL;
+	m->data_float = NULL;
+	if (new_data != NULL && model_prepare != NULL)
+		m->prepared = model_prepare(new_data);
+#ifdef SINGLE_PRECISION
+	if (new_data != NULL)
+		m->data_float = data_to_float(new_data);
+#endif
 }
 
 gsl_vector * get_steps(const mcmc * m) {
 	return m->params_step;
 }
 
+#ifndef N_PARAMETERS
 double get_steps_for(const mcmc * m, const unsigned int i) {
 	return gsl_vector_get(m->params_step, i);
 }
+#endif
 double get_steps_for_normalized(const mcmc * m, const unsigned int i) {
 	return get_steps_for(m, i) / (get_params_max_for(m, i) -
 			get_params_min_for(m, i));
@@ -284,7 +346,11 @@ double get_next_uniform_plusminus_random(const mcmc * m) {
 	return 2* get_next_uniform_random (m) - 1;
 }
 double get_next_uniform_random(const mcmc * m) {
+#ifdef BLOCK_RANDOM
+	return random_block_uniform(m->random_block);
+#else
 	return gsl_rng_uniform(get_random(m));
+#endif
 }
 
 double get_next_random_jump(const mcmc * m, const double sigma) {
@@ -301,10 +367,18 @@ double get_next_random_jump(const mcmc * m, const double sigma) {
  * proposal distribution.
  */
 #define PROPOSAL
+#ifdef BLOCK_RANDOM
+	return sigma * random_block_normal(m->random_block);
+#else
 	return gsl_ran_gaussian(get_random(m), sigma);
 #endif
+#endif
 }
 double get_next_alog_urandom(const mcmc * m) {
+#ifdef BLOCK_RANDOM
+	return random_block_log_uniform(m->random_block);
+#else
 	return gsl_sf_log(get_next_uniform_random(m));
+#endif
 }
 
@@ -32,25 +32,35 @@ double get_accept_rate_for(const mcmc * m, const unsigned int i);
 double get_accept_rate_global(const mcmc * m);
 unsigned long get_params_accepts_for(const mcmc * m, const unsigned int i);
 unsigned long get_params_rejects_for(const mcmc * m, const unsigned int i);
+unsigned int get_params_boundary_for(const mcmc * m, const unsigned int i);
 gsl_vector * get_params(const mcmc * m);
-double get_params_for(const mcmc * m, const unsigned int i);
 gsl_vector * get_params_min(const mcmc * m);
-double get_params_min_for(const mcmc * m, const unsigned int i);
 gsl_vector * get_params_max(const mcmc * m);
-double get_params_max_for(const mcmc * m, const unsigned int i);
 gsl_vector * get_params_best(const mcmc * m);
-double get_params_best_for(const mcmc * m, const unsigned int i);
 #ifdef N_PARAMETERS
 #define get_n_par(m) N_PARAMETERS
+/* direct access to the arrays in the struct, see mcmc::values */
+#define get_params_for(m, i) ((m)->values.params[(i)])
+#define get_params_min_for(m, i) ((m)->values.params_min[(i)])
+#define get_params_max_for(m, i) ((m)->values.params_max[(i)])
+#define get_params_best_for(m, i) ((m)->values.params_best[(i)])
+#define get_steps_for(m, i) ((m)->values.params_step[(i)])
+#define set_params_for(m, new_param, i) ((m)->values.params[(i)] = (new_param))
 #else
+double get_params_for(const mcmc * m, const unsigned int i);
+double get_params_min_for(const mcmc * m, const unsigned int i);
+double get_params_max_for(const mcmc * m, const unsigned int i);
+double get_params_best_for(const mcmc * m, const unsigned int i);
+double get_steps_for(const mcmc * m, const unsigned int i);
 unsigned int get_n_par(const mcmc * m);
+void set_params_for(mcmc * m, const double new_param, const unsigned int i);
 #endif
 gsl_rng * get_random(const mcmc * m);
+const void * get_context(const mcmc * m);
 double get_prob(const mcmc * m);
 double get_prior(const mcmc * m);
 double get_prob_best(const mcmc * m);
 gsl_vector * get_steps(const mcmc * m);
-double get_steps_for(const mcmc * m, const unsigned int i);
 double get_steps_for_normalized(const mcmc * m, const unsigned int i);
 
 
@@ -61,12 +71,14 @@ void set_minmax_for(mcmc * m, const double new_min, const double new_max,
 void set_model(mcmc * m, gsl_vector * new_model);
 void set_n_par(mcmc * m, const int new_n_par);
 void set_params_best(mcmc * m, const gsl_vector * new_params_best);
-void set_params_for(mcmc * m, const double new_param, const unsigned int i);
 void set_params(mcmc * m, gsl_vector * new_params);
 void set_params_descr_all(mcmc * m, const char ** new_par_descr);
 void set_params_descr_for(mcmc * m, const char * new_par_descr,
 		const unsigned int i);
+void set_params_boundary_for(mcmc * m, const unsigned int new_boundary,
+		const unsigned int i);
 void set_random(mcmc * m, gsl_rng * newrandom);
+void set_context(mcmc * m, const void * new_context);
 void set_prob(mcmc * m, const double new_prob);
 void set_prior(mcmc * m, const double new_prior);
 void set_data(mcmc * m, const gsl_matrix * new_data);
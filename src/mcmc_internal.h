@@ -33,6 +33,11 @@
  */
 mcmc * mcmc_init(const unsigned int n_pars);
 
+/**
+ * copy a string
+ */
+char * my_strdup(const char * s);
+
 /**
  * count the lines (\n) in the file
  * @param filename
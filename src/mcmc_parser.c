@@ -41,25 +41,52 @@ static int strnlen(char * s, int maxlen) {
 	return i;
 }
 
+/** names of the boundary kinds in the params file, by their number */
+static const char * boundary_names[] = { "redraw", "reflect", "circular",
+		"logit", NULL };
+
+const char * mcmc_boundary_name(const unsigned int boundary) {
+	return boundary_names[boundary];
+}
+
 /**
  * returns 0 on success.
  */
 static int load_parameter(mcmc * m, FILE * input, int i) {
 	int col = 0;
+	unsigned int j;
 	double start;
 	double min;
 	double max;
 	double step;
+	char line[MAX_LINE_LENGTH];
+	char boundary[MAX_LINE_LENGTH];
 	char * descr = (char*) mem_calloc(MAX_LINE_LENGTH, sizeof(char));
 	IFDEBUGPARSER
 	dump_i("parsing line", i);
 
-	col = fscanf(input, "%lf\t%lf\t%lf\t%s\t%lf\n", &start, &min, &max, descr,
-			&step);
-	if (col != 5) {
+	if (fgets(line, MAX_LINE_LENGTH, input) == NULL) {
+		fprintf(stderr, "line missing.\n");
+		return 1;
+	}
+	col = sscanf(line, "%lf\t%lf\t%lf\t%s\t%lf\t%s", &start, &min, &max,
+			descr, &step, boundary);
+	if (col != 5 && col != 6) {
 		fprintf(stderr, "only %d fields matched.\n", col);
 		return 1;
 	}
+	if (col == 6) {
+		for (j = 0; boundary_names[j] != NULL; j++) {
+			if (strcmp(boundary, boundary_names[j]) == 0)
+				break;
+		}
+		if (boundary_names[j] == NULL) {
+			fprintf(stderr, "unknown boundary %s (use redraw, reflect, "
+				"circular or logit)\n", boundary);
+			return 1;
+		}
+		m->params_boundary[i] = j;
+	}
 	if (!(descr != NULL && strnlen(descr, MAX_LINE_LENGTH) > 0 && strnlen(
 			descr, MAX_LINE_LENGTH) < MAX_LINE_LENGTH)) {
 		fprintf(stderr, "description invalid: %s\n", descr);
@@ -115,7 +142,7 @@ static void load_data(mcmc * m, const char * filename) {
 	}
 	assert(fclose(input) == 0);
 
-	m->data = data;
+	set_data(m, data);
 
 	IFDEBUGPARSER
 	dump_i("loaded data points", npoints);
@@ -142,6 +169,8 @@ void mcmc_reuse_data(mcmc * m, const mcmc * m_orig) {
 	debug("reusing data from other struct");
 	assert(m_orig->data != NULL);
 	m->data = m_orig->data;
+	m->prepared = m_orig->prepared;
+	m->data_float = m_orig->data_float;
 	mcmc_check(m);
 }
 
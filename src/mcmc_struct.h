@@ -24,8 +24,21 @@
 #include <gsl/gsl_matrix.h>
 #include <gsl/gsl_rng.h>
 
+#include "random_block.h"
+
+#ifndef CACHE_LINE_SIZE
+/**
+ * Size of a cache line in bytes. Each chain is aligned to and padded to
+ * whole cache lines (see mcmc::arena).
+ */
+#define CACHE_LINE_SIZE 64
+#endif
+
 /**
  * The main class of operation.
+ *
+ * The fields used in every step come first, those only used for setup and
+ * output after them.
  */
 typedef struct {
 	/** number of parameters */
@@ -44,25 +57,37 @@ typedef struct {
 	 * random number generator
 	 */
 	gsl_rng * random;
+	/**
+	 * buffered random numbers, seeded from random (only with #BLOCK_RANDOM)
+	 */
+	random_block * random_block;
+	/** number of iterations calculated */
+	unsigned long n_iter;
 	/**
 	 * current parameters
 	 * size = n_par
 	 */
 	gsl_vector * params;
 	/**
-	 * best parameters yet
+	 * current step widths for individual parameters
+	 * size = n_par; set by calibration
+	 */
+	gsl_vector * params_step;
+	/**
+	 * lower limits for each parameter
 	 * size = n_par
 	 */
-	gsl_vector * params_best;
+	gsl_vector * params_min;
 	/**
-	 * files where visited nodes are written to.
+	 * upper limits for each parameter
+	 * size = n_par
 	 */
-	FILE ** files;
+	gsl_vector * params_max;
 	/**
-	 * descriptions of parameters
+	 * best parameters yet
 	 * size = n_par
 	 */
-	const char ** params_descr;
+	gsl_vector * params_best;
 	/**
 	 * number of accepted steps for individual parameters
 	 * size = n_par
@@ -74,20 +99,10 @@ typedef struct {
 	 */
 	unsigned long * params_rejects;
 	/**
-	 * current step widths for individual parameters
-	 * size = n_par; set by calibration
-	 */
-	gsl_vector * params_step;
-	/**
-	 * lower limits for each parameter
-	 * size = n_par
-	 */
-	gsl_vector * params_min;
-	/**
-	 * upper limits for each parameter
+	 * how proposals are kept within the limits, e.g. #BOUNDARY_REFLECT
 	 * size = n_par
 	 */
-	gsl_vector * params_max;
+	unsigned int * params_boundary;
 	/**
 	 * arbitrary sized array containing the observation as found in the
 	 * file "data"
@@ -97,12 +112,71 @@ typedef struct {
 	 * etc.
 	 */
 	const gsl_matrix * data;
-
-	/** number of iterations calculated */
-	unsigned long n_iter;
-
+	/**
+	 * quantities derived from the data by model_prepare(), one row per
+	 * observation; shared by all chains that share the data. NULL if the
+	 * model does not provide model_prepare().
+	 */
+	const gsl_matrix * prepared;
+	/**
+	 * single precision copy of the data, stored column by column: column j
+	 * starts at data_float + j * data->size1. Only set with
+	 * #SINGLE_PRECISION; NULL where the model has to use double precision.
+	 */
+	const float * data_float;
 	/** any extensions can be stored here **/
 	void * additional_data;
+	/** the vectors params to params_max, see mcmc::arena */
+	gsl_vector_view views[5];
+#ifdef N_PARAMETERS
+	/**
+	 * storage of the parameter vectors with #N_PARAMETERS: params,
+	 * params_best, params_step, params_min and params_max are views of
+	 * these arrays, which live in the struct itself.
+	 */
+	struct {
+		double params[N_PARAMETERS];
+		double params_best[N_PARAMETERS];
+		double params_step[N_PARAMETERS];
+		double params_min[N_PARAMETERS];
+		double params_max[N_PARAMETERS];
+	} values;
+#endif
+
+	/* used for setup and output only */
+	/**
+	 * files where visited nodes are written to.
+	 */
+	FILE ** files;
+	/**
+	 * descriptions of parameters
+	 * size = n_par
+	 */
+	const char ** params_descr;
+	/**
+	 * walkers of the ensemble sampler, one per row (only with #ENSEMBLE)
+	 */
+	gsl_matrix * ensemble;
+	/**
+	 * probability of each walker; NULL if it has to be recalculated
+	 */
+	gsl_vector * ensemble_prob;
+	/** prior of each walker */
+	gsl_vector * ensemble_prior;
+	/** the walker the chain holds, the next one in turn after each step */
+	unsigned int ensemble_walker;
+	/**
+	 * the library context the chain belongs to, NULL if none (see apemost.h)
+	 */
+	const void * context;
+	/**
+	 * the allocated block. The struct starts at the first cache line in it
+	 * and is followed by the per-parameter arrays (the values of params to
+	 * params_max unless #N_PARAMETERS is set, params_accepts,
+	 * params_rejects and params_boundary). The block is padded to whole
+	 * cache lines, so chains in different threads do not share any.
+	 */
+	void * arena;
 } mcmc;
 
 #endif /* MCMC_STRUCT_H_ */
@@ -0,0 +1,360 @@
+/*
+    APEMoST - Automated Parameter Estimation and Model Selection Toolkit
+    Copyright (C) 2009  Johannes Buchner
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <omp.h>
+#include <gsl/gsl_randist.h>
+
+#include "mcmc.h"
+#include "mcmc_internal.h"
+#include "parallel_tempering.h"
+#include "parallel_tempering_run.h"
+#include "debug.h"
+#include "define_defaults.h"
+#include "gsl_helper.h"
+#include "utils.h"
+#include "format_double.h"
+
+/**
+ * Nested sampling (Skilling 2004).
+ *
+ * The live points are drawn from the prior (uniform within the limits of
+ * the params file, times exp(prior) if the model sets one). In each
+ * iteration, the k lowest live points die and are replaced in parallel by
+ * Metropolis walks from random survivors, constrained to a higher
+ * likelihood. Removing k points at once shrinks the prior volume as
+ * removing them one after the other with n, n - 1, ..., n - k + 1 live
+ * points.
+ *
+ * Every replacement slot has its own random number generator, so the
+ * result depends on the number of slots (#NESTED_PARALLEL), but not on the
+ * number of threads running them. By default, there is one slot per
+ * thread.
+ */
+
+/** a dead point */
+typedef struct {
+	double loglike;
+	double logweight;
+	/** the parameter values follow */
+	double params[1];
+} nested_sample;
+
+typedef struct {
+	double loglike;
+	unsigned int index;
+} live_order;
+
+static int compare_live_order(const void * a, const void * b) {
+	const double la = ((const live_order *) a)->loglike;
+	const double lb = ((const live_order *) b)->loglike;
+	return (la > lb) - (la < lb);
+}
+
+/**
+ * ln(exp(a) + exp(b))
+ */
+static double logaddexp(const double a, const double b) {
+	if (a == GSL_NEGINF)
+		return b;
+	if (b == GSL_NEGINF)
+		return a;
+	if (a > b)
+		return a + log(1 + exp(b - a));
+	return b + log(1 + exp(a - b));
+}
+
+static void evaluate(const mcmc * m, const gsl_vector * x, double * loglike,
+		double * prior) {
+	mcmc * s = markov_chain_scratch(m);
+	gsl_vector_memcpy(s->params, x);
+	calc_model(s, NULL);
+	*prior = get_prior(s);
+	*loglike = get_prob(s) - get_prior(s);
+}
+
+/**
+ * Metropolis walk on the prior from a live point, rejecting everything
+ * below the likelihood threshold.
+ *
+ * @return number of accepted steps
+ */
+static unsigned int constrained_walk(const mcmc * m, const gsl_rng * rng,
+		const gsl_vector * scale, const double threshold, gsl_vector * x,
+		double * loglike, double * prior) {
+	unsigned int step;
+	unsigned int i;
+	unsigned int accepts = 0;
+	double l;
+	double p;
+	double u;
+	gsl_vector * y = gsl_vector_alloc(x->size);
+
+	for (step = 0; step < NESTED_MCMC_STEPS; step++) {
+		for (i = 0; i < x->size; i++)
+			gsl_vector_set(y, i, gsl_vector_get(x, i) + gsl_ran_gaussian(rng,
+					gsl_vector_get(scale, i)));
+		u = gsl_rng_uniform_pos(rng);
+		if (!mcmc_within_limits(m, y))
+			continue;
+		evaluate(m, y, &l, &p);
+		if (l > threshold && log(u) < p - *prior) {
+			gsl_vector_memcpy(x, y);
+			*loglike = l;
+			*prior = p;
+			accepts++;
+		}
+	}
+	gsl_vector_free(y);
+	return accepts;
+}
+
+/**
+ * spread of the live points in each parameter, times factor
+ */
+static void live_scale(const gsl_matrix * live, const double factor,
+		gsl_vector * scale) {
+	unsigned int i;
+	unsigned int k;
+	double mean;
+	double var;
+	for (i = 0; i < live->size2; i++) {
+		mean = 0;
+		var = 0;
+		for (k = 0; k < live->size1; k++)
+			mean += gsl_matrix_get(live, k, i) / live->size1;
+		for (k = 0; k < live->size1; k++)
+			var += pow(gsl_matrix_get(live, k, i) - mean, 2) / live->size1;
+		gsl_vector_set(scale, i, factor * sqrt(var));
+	}
+}
+
+static nested_sample * add_sample(nested_sample * samples,
+		unsigned long * n_samples, const size_t size, const gsl_vector * x,
+		const double loglike, const double logweight) {
+	nested_sample * s;
+	unsigned int i;
+	if ((*n_samples & (*n_samples - 1)) == 0) {
+		samples = (nested_sample *) mem_realloc(samples, (*n_samples == 0 ? 1
+				: 2 * *n_samples) * size);
+		assert(samples != NULL);
+	}
+	s = (nested_sample *) ((char *) samples + *n_samples * size);
+	s->loglike = loglike;
+	s->logweight = logweight;
+	for (i = 0; i < x->size; i++)
+		s->params[i] = gsl_vector_get(x, i);
+	(*n_samples)++;
+	return samples;
+}
+
+static void write_samples(const mcmc * m, const nested_sample * samples,
+		const unsigned long n_samples, const size_t size, const double logz,
+		const double logz_error) {
+	unsigned long j;
+	unsigned int i;
+	const nested_sample * s;
+	FILE * f = job_fopen(NESTED_SAMPLES_FILE, "w");
+
+	if (f == NULL) {
+		perror("could not write " NESTED_SAMPLES_FILE);
+		return;
+	}
+	fprintf(f, "# ln Z = %f +- %f\n# weight\tloglikelihood", logz, logz_error);
+	for (i = 0; i < get_n_par(m); i++)
+		fprintf(f, "\t%s", get_params_descr(m)[i]);
+	fputc('\n', f);
+	for (j = 0; j < n_samples; j++) {
+		s = (const nested_sample *) ((const char *) samples + j * size);
+		fprint_double(f, exp(s->logweight - logz));
+		fputc('\t', f);
+		fprint_double(f, s->loglike);
+		for (i = 0; i < get_n_par(m); i++) {
+			fputc('\t', f);
+			fprint_double(f, s->params[i]);
+		}
+		fputc('\n', f);
+	}
+	fclose(f);
+}
+
+void nested_sampling(const unsigned long max_iterations) {
+	mcmc * m = mcmc_load(PARAMS_FILENAME, DATA_FILENAME);
+	const unsigned int n_par = get_n_par(m);
+	const unsigned int n_live = NESTED_LIVE_POINTS;
+	const size_t size = sizeof(nested_sample) + (n_par - 1) * sizeof(double);
+	unsigned int n_parallel = NESTED_PARALLEL;
+	int k;
+	unsigned int i;
+	unsigned int j;
+	unsigned long iter = 0;
+	unsigned long n_samples = 0;
+	unsigned long n_evaluations = n_live;
+	unsigned long accepts;
+	double logx = 0;
+	double logz = GSL_NEGINF;
+	double logz_error;
+	double information = 0;
+	double threshold;
+	double factor = 1;
+	int flat_prior = 1;
+	nested_sample * samples = NULL;
+	const nested_sample * s;
+	live_order * order = (live_order *) mem_calloc(n_live, sizeof(live_order));
+	gsl_matrix * live = gsl_matrix_alloc(n_live, n_par);
+	double * live_loglike = (double *) mem_calloc(n_live, sizeof(double));
+	double * live_prior = (double *) mem_calloc(n_live, sizeof(double));
+	gsl_vector * scale = gsl_vector_alloc(n_par);
+	gsl_rng ** rngs;
+
+	if (n_parallel == 0)
+		n_parallel = omp_get_max_threads();
+	if (n_parallel > n_live / 2)
+		n_parallel = n_live / 2;
+	rngs = (gsl_rng **) mem_calloc(n_parallel, sizeof(gsl_rng *));
+	for (i = 0; i < n_parallel; i++) {
+		rngs[i] = gsl_rng_alloc(gsl_rng_default);
+		gsl_rng_set(rngs[i], gsl_rng_get(get_random(m)));
+	}
+	m->additional_data = mem_malloc(sizeof(parallel_tempering_mcmc));
+	set_beta(m, 1.0);
+	mcmc_check(m);
+
+	printf("Nested sampling with %d live points, %d replaced at once\n",
+			n_live, n_parallel);
+	fflush(stdout);
+	for (i = 0; i < n_live; i++) {
+		for (j = 0; j < n_par; j++)
+			gsl_matrix_set(live, i, j, get_params_min_for(m, j)
+					+ (get_params_max_for(m, j) - get_params_min_for(m, j))
+							* get_next_uniform_random(m));
+	}
+#pragma omp parallel for
+	for (k = 0; k < (int) n_live; k++) {
+		gsl_vector_view x = gsl_matrix_row(live, k);
+		evaluate(m, &x.vector, &live_loglike[k], &live_prior[k]);
+	}
+	for (i = 1; i < n_live; i++) {
+		if (live_prior[i] != live_prior[0])
+			flat_prior = 0;
+	}
+	if (!flat_prior) {
+		/* the uniform points have to follow the prior first */
+		live_scale(live, 0.5, scale);
+#pragma omp parallel for private(i)
+		for (k = 0; k < (int) n_parallel; k++) {
+			/* each slot walks its points in turn, with its generator */
+			for (i = k; i < n_live; i += n_parallel) {
+				gsl_vector_view x = gsl_matrix_row(live, i);
+				constrained_walk(m, rngs[k], scale, GSL_NEGINF, &x.vector,
+						&live_loglike[i], &live_prior[i]);
+			}
+		}
+		n_evaluations += n_live * NESTED_MCMC_STEPS;
+	}
+
+	register_signal_handlers();
+	while (run && (max_iterations == 0 || iter < max_iterations)) {
+		for (i = 0; i < n_live; i++) {
+			order[i].loglike = live_loglike[i];
+			order[i].index = i;
+		}
+		qsort(order, n_live, sizeof(live_order), compare_live_order);
+		if (order[n_live - 1].loglike + logx - logz < log(NESTED_TOLERANCE))
+			break;
+
+		for (i = 0; i < n_parallel; i++) {
+			gsl_vector_view x = gsl_matrix_row(live, order[i].index);
+			double logweight = order[i].loglike + logx + log(1 - exp(-1.0
+					/ (n_live - i)));
+			samples = add_sample(samples, &n_samples, size, &x.vector,
+					order[i].loglike, logweight);
+			logz = logaddexp(logz, logweight);
+			logx -= 1.0 / (n_live - i);
+		}
+		threshold = order[n_parallel - 1].loglike;
+
+		/* start each replacement from a random survivor */
+		live_scale(live, factor, scale);
+		for (i = 0; i < n_parallel; i++) {
+			gsl_vector_view start;
+			j = order[n_parallel + gsl_rng_uniform_int(get_random(m), n_live
+					- n_parallel)].index;
+			start = gsl_matrix_row(live, j);
+			gsl_matrix_set_row(live, order[i].index, &start.vector);
+			live_loglike[order[i].index] = live_loglike[j];
+			live_prior[order[i].index] = live_prior[j];
+		}
+		accepts = 0;
+#pragma omp parallel for reduction(+:accepts)
+		for (k = 0; k < (int) n_parallel; k++) {
+			const unsigned int w = order[k].index;
+			gsl_vector_view x = gsl_matrix_row(live, w);
+			accepts += constrained_walk(m, rngs[k], scale, threshold,
+					&x.vector, &live_loglike[w], &live_prior[w]);
+		}
+		n_evaluations += n_parallel * NESTED_MCMC_STEPS;
+		/* keep the acceptance rate of the walks between 20% and 50% */
+		if (accepts < 0.2 * n_parallel * NESTED_MCMC_STEPS)
+			factor /= 1.2;
+		else if (accepts > 0.5 * n_parallel * NESTED_MCMC_STEPS)
+			factor *= 1.2;
+
+		iter++;
+		if (iter % 100 == 0) {
+			printf("iteration: %lu, ln Z: %.3f, ln X: %.2f, step scale: %.3f\r",
+					iter, logz, logx, factor);
+			fflush(stdout);
+		}
+	}
+	printf("\n");
+
+	/* the live points share the remaining prior volume */
+	for (i = 0; i < n_live; i++) {
+		gsl_vector_view x = gsl_matrix_row(live, i);
+		double logweight = live_loglike[i] + logx - log(n_live);
+		samples = add_sample(samples, &n_samples, size, &x.vector,
+				live_loglike[i], logweight);
+		logz = logaddexp(logz, logweight);
+	}
+	for (j = 0; j < n_samples; j++) {
+		s = (const nested_sample *) ((const char *) samples + j * size);
+		information += exp(s->logweight - logz) * s->loglike;
+	}
+	information -= logz;
+	logz_error = sqrt(information / n_live);
+
+	printf("nested sampling: %lu iterations, %lu model evaluations, "
+		"information %.2f nats\n", iter, n_evaluations, information);
+	printf("ln Z = %.5f +- %.5f\n", logz, logz_error);
+	write_samples(m, samples, n_samples, size, logz, logz_error);
+	printf("wrote %lu weighted samples to %s\n", n_samples, NESTED_SAMPLES_FILE);
+	print_data_probability(logz);
+
+	for (i = 0; i < n_parallel; i++)
+		gsl_rng_free(rngs[i]);
+	mem_free(rngs);
+	mem_free(samples);
+	mem_free(order);
+	mem_free(live_loglike);
+	mem_free(live_prior);
+	gsl_matrix_free(live);
+	gsl_vector_free(scale);
+	mem_free(m->additional_data);
+	m = mcmc_free(m);
+}
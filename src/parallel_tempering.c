@@ -27,7 +27,12 @@
 #include "define_defaults.h"
 #include "gsl_helper.h"
 #include "parallel_tempering_run.h"
+#include "parallel_tempering_metrics.h"
+#include "parallel_tempering_control.h"
 #include "utils.h"
+#include "timing.h"
+#include "trace.h"
+#include "format_double.h"
 
 void register_signal_handlers();
 
@@ -49,7 +54,46 @@ void report(const mcmc ** chains, const int n_beta) {
 		i++;
 	}
 	printf("done.\n");
+#ifdef PHASE_TIMING
+	timing_report(stdout);
+#endif
+}
+
+/**
+ * frees the chains made by setup_chains()
+ */
+static void free_chains(mcmc ** chains, const unsigned int n_beta) {
+	unsigned int i;
+	unsigned int j;
+
+	for (i = n_beta; i-- > 0;) {
+		mem_free(chains[i]->additional_data);
+		if (i != 0)
+			set_params_descr_all(chains[i], NULL);
+		for (j = 0; j < i; j++) {
+			if (chains[j]->data == chains[i]->data) {
+				/* this was reused, thus avoid double free */
+				set_data(chains[i], NULL);
+				break;
+			}
+		}
+		chains[i] = mcmc_free(chains[i]);
+		mem_free(chains[i]);
+	}
+	mem_free(chains);
+}
+
+#ifdef PHASE_TIMING
+static void write_timing_file() {
+	FILE * f = job_fopen(TIMING_FILE, "w");
+	if (f == NULL) {
+		perror("could not write " TIMING_FILE);
+		return;
+	}
+	timing_report(f);
+	fclose(f);
 }
+#endif
 
 
 #ifdef __NEVER_SET_FOR_DOCUMENTATION_ONLY
@@ -82,6 +126,23 @@ void calibrate_first() {
 	const unsigned long burn_in_iterations = BURN_IN_ITERATIONS;
 	const unsigned long iter_limit = ITER_LIMIT;
 	const double mul = MUL;
+#ifdef CALIBRATION_CACHE
+	char cache[FILENAME_MAX];
+
+	switch (calibration_cache_find(cache)) {
+	case CALIBRATION_CACHE_HIT:
+		printf("using cached calibration %s\n", cache);
+		calibration_cache_read(cache, chains, N_BETA);
+		write_calibrations_file(chains, N_BETA);
+		write_params_file(chains[0]);
+		free_chains(chains, N_BETA);
+		return;
+	case CALIBRATION_CACHE_WARM:
+		printf("starting from cached calibration %s\n", cache);
+		calibration_cache_read(cache, chains, 1);
+		break;
+	}
+#endif
 
 	printf("Starting markov chain calibration\n");
 	fflush(stdout);
@@ -92,6 +153,31 @@ void calibrate_first() {
 			DEFAULT_ADJUST_STEP);
 	write_calibrations_file(chains, 1);
 	write_params_file(chains[0]);
+	free_chains(chains, N_BETA);
+}
+
+/**
+ * calibrates chain i with given beta and initial step widths, starting from
+ * the best values of the first chain
+ */
+static void calibrate_chain(mcmc ** chains, const int i) {
+	TRACE_DECLARE(t)
+
+	TRACE_START(t);
+	set_params(chains[i], dup_vector(get_params_best(chains[0])));
+	calc_model(chains[i], NULL);
+	mcmc_check(chains[i]);
+	printf("\tChain %2d - beta = %f\tsteps: ", i, get_beta(chains[i]));
+	dump_vectorln(get_steps(chains[i]));
+	fflush(stdout);
+#ifndef SKIP_CALIBRATE_ALLCHAINS
+	markov_chain_calibrate(chains[i], BURN_IN_ITERATIONS,
+			TARGET_ACCEPTANCE_RATE, MAX_AR_DEVIATION, ITER_LIMIT, MUL,
+			DEFAULT_ADJUST_STEP);
+#else
+	burn_in(chains[i], BURN_IN_ITERATIONS);
+#endif
+	TRACE_EVENT(t, "calibrate chain", i, "beta", get_beta(chains[i]));
 }
 
 /**
@@ -113,19 +199,51 @@ void calibrate_first() {
  * new start values (calibration_result)
  **/
 void calibrate_rest() {
-	int n_beta = N_BETA;
+	mcmc ** chains = setup_chains();
+#ifdef CALIBRATION_CACHE
+	char cache[FILENAME_MAX];
+	int i;
+
+	switch (calibration_cache_find(cache)) {
+	case CALIBRATION_CACHE_HIT:
+		printf("using cached calibration %s\n", cache);
+		calibration_cache_read(cache, chains, N_BETA);
+		write_calibrations_file(chains, N_BETA);
+		free_chains(chains, N_BETA);
+		return;
+	case CALIBRATION_CACHE_WARM:
+		printf("starting from cached calibration %s\n", cache);
+		calibration_cache_read(cache, chains, N_BETA);
+		read_calibration_file(chains, 1);
+		printf("Calibrating chains\n");
+#pragma omp parallel for
+		for (i = 1; i < N_BETA; i++) {
+			calibrate_chain(chains, i);
+		}
+		break;
+	default:
+		read_calibration_file(chains, 1);
+		calibrate_chains(chains, N_BETA, BETA_0);
+	}
+	calibration_cache_store(chains, N_BETA);
+#else
+	read_calibration_file(chains, 1);
+	calibrate_chains(chains, N_BETA, BETA_0);
+#endif
+	write_calibration_summary(chains, N_BETA);
+	write_calibrations_file(chains, N_BETA);
+	free_chains(chains, N_BETA);
+}
+
+void calibrate_chains(mcmc ** chains, const int n_beta, double beta_0) {
 	const double desired_acceptance_rate = TARGET_ACCEPTANCE_RATE;
 	const double max_ar_deviation = MAX_AR_DEVIATION;
-	double beta_0 = BETA_0;
 	const unsigned long burn_in_iterations = BURN_IN_ITERATIONS;
 	const unsigned long iter_limit = ITER_LIMIT;
 	const double mul = MUL;
 	unsigned int n_par;
 	int i;
 	gsl_vector * stepwidth_factors;
-	mcmc ** chains = setup_chains();
-
-	read_calibration_file(chains, 1);
 
 	printf("Calibrating chains\n");
 	fflush(stdout);
@@ -140,8 +258,7 @@ void calibrate_rest() {
 					chains[0], stepwidth_factors)));
 		else
 			set_beta(chains[i], get_chain_beta(i, n_beta, beta_0));
-		gsl_vector_free(get_steps(chains[i]));
-		chains[i]->params_step = dup_vector(get_steps(chains[0]));
+		gsl_vector_memcpy(get_steps(chains[i]), get_steps(chains[0]));
 		gsl_vector_scale(get_steps(chains[i]), pow(get_beta(chains[i]), -0.5));
 		set_params(chains[i], dup_vector(get_params_best(chains[0])));
 		calc_model(chains[i], NULL);
@@ -172,28 +289,13 @@ void calibrate_rest() {
 
 #pragma omp parallel for
 	for (i = 1; i < n_beta; i++) {
-		printf("\tChain %2d - ", i);
-		fflush(stdout);
 		chains[i]->additional_data
 				= mem_malloc(sizeof(parallel_tempering_mcmc));
 		set_beta(chains[i], get_chain_beta(i, n_beta, beta_0));
-		gsl_vector_free(get_steps(chains[i]));
-		chains[i]->params_step = dup_vector(get_steps(chains[0]));
+		gsl_vector_memcpy(get_steps(chains[i]), get_steps(chains[0]));
 		gsl_vector_scale(get_steps(chains[i]), pow(get_beta(chains[i]), -0.5));
 		gsl_vector_mul(get_steps(chains[i]), stepwidth_factors);
-		set_params(chains[i], dup_vector(get_params_best(chains[0])));
-		calc_model(chains[i], NULL);
-		mcmc_check(chains[i]);
-		printf("beta = %f\tsteps: ", get_beta(chains[i]));
-		dump_vectorln(get_steps(chains[i]));
-		fflush(stdout);
-#ifndef SKIP_CALIBRATE_ALLCHAINS
-		markov_chain_calibrate(chains[i], burn_in_iterations,
-				desired_acceptance_rate, max_ar_deviation, iter_limit, mul,
-				DEFAULT_ADJUST_STEP);
-#else
-		burn_in(chains[i], burn_in_iterations);
-#endif
+		calibrate_chain(chains, i);
 	}
 	gsl_vector_free(stepwidth_factors);
 	fflush(stdout);
@@ -202,8 +304,6 @@ void calibrate_rest() {
 		printf("\tChain %2d - beta = %f \tsteps: ", i, get_beta(chains[i]));
 		dump_vectorln(get_steps(chains[i]));
 	}
-	write_calibration_summary(chains, n_beta);
-	write_calibrations_file(chains, n_beta);
 }
 
 void prepare_and_run_sampler(const unsigned long max_iterations, int append) {
@@ -215,9 +315,13 @@ void prepare_and_run_sampler(const unsigned long max_iterations, int append) {
 
 	debug("reading calibrations file")
 	read_calibration_file(chains, n_beta);
+	for (i = 0; i < n_beta; i++) {
+		/* the first step must compare against the start values */
+		calc_model(chains[i], NULL);
+	}
 
 	debug("opening dump files")
-	mcmc_open_dump_files(chains[i], "-chain", i, (append == 1 ? "a" : "w"));
+	mcmc_open_dump_files(chains[0], "-chain", 0, (append == 1 ? "a" : "w"));
 
 #ifdef DUMP_ALL_CHAINS
 	for (i = 1; i < n_beta; i++) {
@@ -237,16 +341,7 @@ void prepare_and_run_sampler(const unsigned long max_iterations, int append) {
 	debug("reporting")
 	report((const mcmc **) chains, n_beta);
 
-	for (i = 0; i < n_beta; i++) {
-		mem_free(chains[i]->additional_data);
-		if (i != 0) {
-			/* this was reused, thus avoid double free */
-			set_data(chains[i], NULL);
-		}
-		chains[i] = mcmc_free(chains[i]);
-		mem_free(chains[i]);
-	}
-	mem_free(chains);
+	free_chains(chains, n_beta);
 }
 
 #ifdef __NEVER_SET_FOR_DOCUMENTATION_ONLY
@@ -270,6 +365,7 @@ void adapt(mcmc ** chains, const unsigned int n_beta, const unsigned int n_swap)
 
 #ifdef RWM
 	static double prob_old[100];
+#pragma omp threadprivate(prob_old)
 #endif
 
 #ifdef RWM
@@ -309,7 +405,10 @@ void dump(const mcmc ** chains, const unsigned int n_beta,
 		const unsigned long iter, FILE * acceptance_file,
 		FILE ** probabilities_file) {
 	unsigned int i;
+	TRACE_DECLARE(t)
+
 	if (iter % PRINT_PROB_INTERVAL == 0) {
+		TRACE_START(t);
 		if (dumpflag) {
 			report(chains, n_beta);
 			dumpflag = 0;
@@ -324,6 +423,10 @@ void dump(const mcmc ** chains, const unsigned int n_beta,
 		}
 		fprintf(acceptance_file, "\n");
 		fflush(acceptance_file);
+#ifdef PHASE_TIMING
+		write_timing_file();
+#endif
+		TRACE_EVENT(t, "dump", -1, "iteration", iter);
 		IFDEBUG {
 			debug("dumping distribution");
 			dump_ul("iteration", iter);
@@ -338,34 +441,72 @@ void dump(const mcmc ** chains, const unsigned int n_beta,
 					get_params_accepts_global(chains[0]),
 					get_params_rejects_global(chains[0]));
 			dump_vector(get_params(chains[0]));
-			printf(" [%d/%lu ticks]\r", get_duration(), get_ticks_per_second());
+			printf(" [%d ms]\r", get_duration());
 			fflush(stdout);
 		}
 	}
 }
 
+#ifdef SINGLE_PRECISION
+/**
+ * compare the probabilities of the chains to double precision
+ * (see #SINGLE_PRECISION_CHECK_INTERVAL)
+ */
+static void check_precision(mcmc ** chains, const int n_beta,
+		const unsigned long iter) {
+	int i;
+	double drift;
+
+	for (i = 0; i < n_beta; i++) {
+		drift = markov_chain_check_precision(chains[i]);
+		IFDEBUG
+			dump_d("single precision deviation", drift);
+		if (fabs(drift) > SINGLE_PRECISION_TOLERANCE) {
+			fprintf(stderr, "single precision deviates by %g from double "
+					"precision in chain %d at iteration %lu\n", drift, i, iter);
+		}
+	}
+}
+#endif
+
 void run_sampler(mcmc ** chains, const int n_beta, const unsigned int n_swap,
 		const unsigned long max_iterations, char * mode) {
 	int i;
 	unsigned long iter = chains[0]->n_iter;
 	unsigned int subiter;
 	FILE * acceptance_file;
+	/* in the job directory, so the jobs of a batch do not share them */
+#ifdef METRICS_SOCKET
+	char metrics_path[FILENAME_MAX];
+	const int metrics = metrics_listen_unix(job_path(metrics_path,
+			METRICS_SOCKET));
+#elif defined(METRICS_PORT)
+	const int metrics = metrics_listen_tcp(METRICS_PORT);
+#endif
+#ifdef CONTROL_FIFO
+	char control_path[FILENAME_MAX];
+	const int control_fd = control_open(job_path(control_path, CONTROL_FIFO));
+#endif
+	sampler_control control;
+	TIMING_DECLARE(t)
+	TRACE_DECLARE(trace_timer)
 
 	FILE ** probabilities_file = (FILE**) mem_calloc(n_beta, sizeof(FILE*));
 	char buf[100];
 	assert(probabilities_file != NULL);
 	for (i = 0; i < n_beta; i++) {
 		sprintf(buf, "prob-chain%d.dump", i);
-		probabilities_file[i] = fopen(buf, mode);
+		probabilities_file[i] = job_fopen(buf, mode);
 		if (probabilities_file[i] == NULL) {
 			fprintf(stderr, "opening file %s failed\n", buf);
 			perror("opening file failed");
 			exit(1);
 		}
+		setvbuf(probabilities_file[i], NULL, _IOFBF, DUMP_BUFFER_SIZE);
 	}
 	assert(n_beta < 100);
 
-	acceptance_file = fopen("acceptance_rate.dump.gnuplot", "w");
+	acceptance_file = job_fopen("acceptance_rate.dump.gnuplot", "w");
 	if (acceptance_file != NULL) {
 		fprintf(acceptance_file,
 				"# format: iteration | number of accepts for each chain\n");
@@ -381,32 +522,87 @@ void run_sampler(mcmc ** chains, const int n_beta, const unsigned int n_swap,
 		fprintf(acceptance_file, "\n");
 		fclose(acceptance_file);
 	}
-	acceptance_file = fopen("acceptance_rate.dump", mode);
+	acceptance_file = job_fopen("acceptance_rate.dump", mode);
 	assert(acceptance_file != NULL);
+	control.max_iterations = max_iterations;
+	control.thinning = 1;
+	control.dumping = 1;
+	control.paused = (int *) mem_calloc(n_beta, sizeof(int));
+	assert(control.paused != NULL);
 	get_duration();
-	run = 1;
+	timing_init(n_beta);
 	dumpflag = 0;
 	printf("starting the analysis\n");
 	fflush(stdout);
 
-	while (run && (max_iterations == 0 || iter < max_iterations)) {
-#pragma omp parallel for
+	while (run && (control.max_iterations == 0 || iter
+			< control.max_iterations)) {
+#pragma omp parallel for private(subiter) schedule(static)
 		for (i = 0; i < n_beta; i++) {
+			TIMING_DECLARE(step_timer)
+			TRACE_DECLARE(block)
+
+			if (control.paused[i])
+				continue;
+			TRACE_START(block);
+			timing_select(i);
 			for (subiter = 0; subiter < n_swap; subiter++) {
+#ifdef HMC
+				markov_chain_hmc_step(chains[i]);
+#elif defined(ENSEMBLE)
+				markov_chain_ensemble_step(chains[i]);
+#else
 				markov_chain_step(chains[i]);
+#endif
+				TIMING_START(step_timer);
 				mcmc_check_best(chains[i]);
-				mcmc_append_current_parameters(chains[i]);
-				fprintf(probabilities_file[i], "%6e\t%6e\n",
-						get_prob(chains[i]), get_prob(chains[i]) - get_prior(
-								chains[i]));
+				if (control.dumping && (iter + subiter) % control.thinning
+						== 0) {
+					mcmc_append_current_parameters(chains[i]);
+					fprint_double(probabilities_file[i], get_prob(chains[i]));
+					fputc('\t', probabilities_file[i]);
+					fprint_double(probabilities_file[i], get_prob(chains[i])
+							- get_prior(chains[i]));
+					fputc('\n', probabilities_file[i]);
+				}
+				TIMING_LAP(step_timer, TIMING_DUMP);
 			}
+			TRACE_EVENT(block, "steps", i, "iteration", iter);
 		}
+		timing_select(-1);
+#ifdef SINGLE_PRECISION
+		if (SINGLE_PRECISION_CHECK_INTERVAL > 0 && iter
+				% SINGLE_PRECISION_CHECK_INTERVAL < n_swap)
+			check_precision(chains, n_beta, iter);
+#endif
+		TIMING_START(t);
+		TRACE_START(trace_timer);
 		adapt(chains, n_beta, iter);
+		TRACE_EVENT(trace_timer, "adapt", -1, NULL, 0);
+		TIMING_LAP(t, TIMING_ADAPT);
 		iter += n_swap;
 		tempering_interaction(chains, n_beta, iter);
+		TIMING_LAP(t, TIMING_SWAP);
 		dump((const mcmc **) chains, n_beta, iter, acceptance_file,
 				probabilities_file);
+#ifdef METRICS
+		metrics_serve(metrics, (const mcmc **) chains, n_beta, iter,
+				acceptance_file, probabilities_file);
+#endif
+#ifdef CONTROL_FIFO
+		control_poll(control_fd, &control, chains, n_beta, acceptance_file,
+				probabilities_file);
+#endif
 	}
+#ifdef CONTROL_FIFO
+	control_close(control_fd, control_path);
+#endif
+	mem_free(control.paused);
+#ifdef METRICS_SOCKET
+	metrics_close(metrics, metrics_path);
+#elif defined(METRICS_PORT)
+	metrics_close(metrics, NULL);
+#endif
 	if (fclose(acceptance_file) != 0) {
 		assert(0);
 	}
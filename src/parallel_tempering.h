@@ -50,6 +50,40 @@
 
 #define CALIBRATION_FILE "calibration_results"
 
+#ifndef NESTED_LIVE_POINTS
+/**
+ * number of live points of nested sampling. The error of ln Z goes with
+ * 1/sqrt(NESTED_LIVE_POINTS).
+ */
+#define NESTED_LIVE_POINTS 400
+#endif
+
+#ifndef NESTED_MCMC_STEPS
+/**
+ * Metropolis steps taken to draw a replacement for a live point
+ */
+#define NESTED_MCMC_STEPS 20
+#endif
+
+#ifndef NESTED_PARALLEL
+/**
+ * live points replaced per iteration of nested sampling.
+ * 0 means one per thread, which makes the result depend on the number of
+ * threads.
+ */
+#define NESTED_PARALLEL 0
+#endif
+
+#ifndef NESTED_TOLERANCE
+/**
+ * nested sampling stops when the live points could change ln Z by less
+ * than this
+ */
+#define NESTED_TOLERANCE 0.01
+#endif
+
+#define NESTED_SAMPLES_FILE "nested_samples.dump"
+
 /** applications can run the follwing functions */
 
 void calibrate_first();
@@ -58,8 +92,38 @@ void prepare_and_run_sampler(unsigned long max_iterations, int append);
 
 void calibrate_rest();
 
+/**
+ * calibrates the chains 1 to n_beta - 1, starting from the calibrated
+ * first chain.
+ *
+ * @param beta_0 beta of the hottest chain, or negative for automatic
+ */
+void calibrate_chains(mcmc ** chains, const int n_beta, double beta_0);
+
 void analyse_marginal_distributions();
 
 void analyse_data_probability();
 
+/**
+ * prints the model probability and the table for comparing models
+ */
+void print_data_probability(const double data_logprob);
+
+/**
+ * Calculates the model probability by nested sampling, without the
+ * tempering ladder. Only the params and data files are needed.
+ * Writes the weighted posterior samples to #NESTED_SAMPLES_FILE.
+ */
+void nested_sampling(const unsigned long max_iterations);
+
+/**
+ * Runs all phases for each directory listed in the manifest file (one per
+ * line, # starts a comment). The files are read and written in these
+ * directories.
+ *
+ * The jobs are distributed over the OpenMP threads; each job runs on one
+ * thread.
+ */
+void run_batch(const char * manifest, const unsigned long max_iterations);
+
 #endif /* PARALLEL_TEMPERING_H_ */
@@ -0,0 +1,161 @@
+/*
+    APEMoST - Automated Parameter Estimation and Model Selection Toolkit
+    Copyright (C) 2009  Johannes Buchner
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <omp.h>
+
+#include "mcmc.h"
+#include "mcmc_internal.h"
+#include "parallel_tempering.h"
+#include "parallel_tempering_run.h"
+#include "debug.h"
+#include "utils.h"
+
+/**
+ * @return the directories listed in the manifest, NULL-terminated
+ */
+static char ** read_manifest(const char * manifest, unsigned int * n_jobs) {
+	char buf[FILENAME_MAX];
+	char ** jobs = NULL;
+	unsigned int size = 0;
+	int len;
+	FILE * f = openfile(manifest);
+
+	*n_jobs = 0;
+	while (fgets(buf, FILENAME_MAX, f) != NULL) {
+		len = strlen(buf);
+		while (len > 0 && isspace(buf[len - 1]))
+			buf[--len] = 0;
+		if (len == 0 || buf[0] == '#')
+			continue;
+		if (*n_jobs + 1 >= size) {
+			size = 2 * size + 16;
+			jobs = (char **) mem_realloc(jobs, size * sizeof(char *));
+			assert(jobs != NULL);
+		}
+		jobs[(*n_jobs)++] = my_strdup(buf);
+	}
+	fclose(f);
+	if (jobs != NULL)
+		jobs[*n_jobs] = NULL;
+	return jobs;
+}
+
+/**
+ * runs all phases in the directory and ends the process.
+ */
+static void run_job(const char * directory, const unsigned long max_iterations) {
+	set_job_directory(directory);
+	/* each job runs on one thread; the jobs keep all threads busy */
+	omp_set_num_threads(1);
+	printf("job %s: starting\n", directory);
+	fflush(stdout);
+	/* each phase starts from the seed, as it does in its own process */
+	mcmc_reset_random();
+	calibrate_first();
+	mcmc_reset_random();
+	calibrate_rest();
+	mcmc_reset_random();
+	prepare_and_run_sampler(max_iterations, 0);
+	mcmc_reset_random();
+	analyse_marginal_distributions();
+	analyse_data_probability();
+	printf("job %s: done\n", directory);
+	fflush(stdout);
+	exit(0);
+}
+
+void run_batch(const char * manifest, const unsigned long max_iterations) {
+	unsigned int n_jobs;
+	unsigned int i;
+	unsigned int next = 0;
+	unsigned int running = 0;
+	unsigned int done = 0;
+	unsigned int failed = 0;
+	int status;
+	pid_t pid;
+	pid_t * pids;
+	const unsigned int n_processes = omp_get_max_threads();
+	char ** jobs = read_manifest(manifest, &n_jobs);
+
+	if (max_iterations == 0) {
+		fprintf(stderr, "batch mode needs MAX_ITERATIONS to be set.\n");
+		exit(1);
+	}
+#if defined(METRICS_PORT) && !defined(METRICS_SOCKET)
+	fprintf(stderr, "batch mode can not serve the metrics of all jobs on one "
+		"port, use METRICS_SOCKET.\n");
+	exit(1);
+#endif
+	pids = (pid_t *) mem_calloc(n_jobs + 1, sizeof(pid_t));
+	assert(pids != NULL);
+	printf("running %d jobs in %d processes\n", n_jobs, n_processes);
+	fflush(stdout);
+	/* Ctrl-C stops the sampler of the running jobs and no new ones start */
+	register_signal_handlers();
+	/*
+	 * every job is a process of its own: a job that fails (exits) does not
+	 * end the others, and the state kept by the phases (timing, metrics,
+	 * control) is not shared. No parallel region may run here before, as
+	 * the threads of the team would be missing in the copies.
+	 */
+	while (running > 0 || (run && next < n_jobs)) {
+		if (run && next < n_jobs && running < n_processes) {
+			pid = fork();
+			if (pid == 0)
+				run_job(jobs[next], max_iterations);
+			if (pid < 0) {
+				perror("could not start job");
+				printf("job %s: failed\n", jobs[next]);
+				failed++;
+			} else {
+				running++;
+			}
+			pids[next++] = pid;
+			continue;
+		}
+		pid = wait(&status);
+		if (pid < 0) {
+			if (errno == EINTR)
+				continue;
+			perror("waiting for the jobs");
+			break;
+		}
+		running--;
+		for (i = 0; i < next && pids[i] != pid; i++)
+			;
+		if (WIFEXITED(status) && WEXITSTATUS(status) == 0) {
+			done++;
+		} else {
+			printf("job %s: failed\n", jobs[i]);
+			failed++;
+		}
+		fflush(stdout);
+	}
+	printf("%d of %d jobs done, %d failed\n", done, n_jobs, failed);
+	mem_free(pids);
+	for (i = 0; i < n_jobs; i++)
+		mem_free(jobs[i]);
+	if (jobs != NULL)
+		mem_free(jobs);
+}
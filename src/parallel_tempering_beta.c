@@ -25,6 +25,7 @@
 void set_beta(mcmc * m, double newbeta) {
 	((parallel_tempering_mcmc *) m->additional_data)->beta = newbeta;
 	((parallel_tempering_mcmc *) m->additional_data)->swapcount = 0;
+	((parallel_tempering_mcmc *) m->additional_data)->swaptries = 0;
 }
 double get_beta(const mcmc * m) {
 	return ((parallel_tempering_mcmc *) m->additional_data)->beta;
@@ -35,6 +36,12 @@ void inc_swapcount(mcmc * m) {
 unsigned long get_swapcount(const mcmc * m) {
 	return ((parallel_tempering_mcmc *) m->additional_data)->swapcount;
 }
+void inc_swaptries(mcmc * m) {
+	((parallel_tempering_mcmc *) m->additional_data)->swaptries++;
+}
+unsigned long get_swaptries(const mcmc * m) {
+	return ((parallel_tempering_mcmc *) m->additional_data)->swaptries;
+}
 
 void print_current_positions(const mcmc ** chains, const int n_beta) {
 	int i;
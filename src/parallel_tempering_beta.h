@@ -73,6 +73,11 @@ typedef struct {
 	 */
 	unsigned long swapcount;
 
+	/**
+	 * times a swap with the next chain was tried
+	 */
+	unsigned long swaptries;
+
 } parallel_tempering_mcmc;
 
 void set_beta(mcmc * m, const double newbeta);
@@ -83,5 +88,9 @@ void inc_swapcount(mcmc * m);
 
 unsigned long get_swapcount(const mcmc * m);
 
+void inc_swaptries(mcmc * m);
+
+unsigned long get_swaptries(const mcmc * m);
+
 #endif
 
@@ -0,0 +1,198 @@
+/*
+    APEMoST - Automated Parameter Estimation and Model Selection Toolkit
+    Copyright (C) 2009  Johannes Buchner
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <string.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include "mcmc.h"
+#include "parallel_tempering_config.h"
+#include "debug.h"
+#include "define_defaults.h"
+#include "utils.h"
+
+/**
+ * everything besides the binary that changes the calibration
+ */
+static const char settings[] = TOSTRING(N_BETA) " " TOSTRING(BETA_0) " "
+TOSTRING(BETA_ALIGNMENT) " " TOSTRING(BURN_IN_ITERATIONS) " "
+TOSTRING(TARGET_ACCEPTANCE_RATE) " " TOSTRING(MAX_AR_DEVIATION) " "
+TOSTRING(ITER_LIMIT) " " TOSTRING(MUL);
+
+/**
+ * 64 bit FNV-1a hash, in four parts of 16 bits, as C89 has no 64 bit type
+ */
+typedef struct {
+	unsigned long part[4];
+} fnv_hash;
+
+static void fnv1a_init(fnv_hash * h) {
+	/* 0xcbf29ce484222325 */
+	h->part[0] = 0x2325;
+	h->part[1] = 0x8422;
+	h->part[2] = 0x9ce4;
+	h->part[3] = 0xcbf2;
+}
+
+static void fnv1a(fnv_hash * h, const unsigned char * buf, const size_t n) {
+	size_t i;
+	unsigned int k;
+	unsigned long old[4];
+	unsigned long t;
+
+	for (i = 0; i < n; i++) {
+		h->part[0] ^= buf[i];
+		/* multiply by the prime 2^40 + 0x1b3 */
+		for (k = 0; k < 4; k++)
+			old[k] = h->part[k];
+		t = 0;
+		for (k = 0; k < 4; k++) {
+			t += old[k] * 0x1b3;
+			if (k >= 2)
+				t += old[k - 2] << 8;
+			h->part[k] = t & 0xffff;
+			t >>= 16;
+		}
+	}
+}
+
+static void fnv1a_print(char * s, const fnv_hash * h) {
+	sprintf(s, "%04lx%04lx%04lx%04lx", h->part[3], h->part[2], h->part[1],
+			h->part[0]);
+}
+
+/**
+ * writes the hash of the file (and closes it)
+ *
+ * @return 0, or -1 if the file could not be opened
+ */
+static int hash_file(char * s, FILE * f) {
+	unsigned char buf[4096];
+	size_t n;
+	fnv_hash hash;
+
+	fnv1a_init(&hash);
+	if (f != NULL) {
+		while ((n = fread(buf, 1, sizeof(buf), f)) > 0)
+			fnv1a(&hash, buf, n);
+		fclose(f);
+	}
+	fnv1a_print(s, &hash);
+	return f == NULL ? -1 : 0;
+}
+
+/**
+ * file name of the entry without the data hash
+ */
+static void cache_prefix(char * prefix) {
+	fnv_hash hash;
+
+	hash_file(prefix, fopen("/proc/self/exe", "rb"));
+	strcat(prefix, "-");
+	hash_file(prefix + strlen(prefix), job_fopen(PARAMS_FILENAME, "rb"));
+	strcat(prefix, "-");
+	fnv1a_init(&hash);
+	fnv1a(&hash, (const unsigned char *) settings, strlen(settings));
+	fnv1a_print(prefix + strlen(prefix), &hash);
+	strcat(prefix, "-");
+}
+
+static void cache_path(char * path, const char * name) {
+	sprintf(path, "%s/%s", CALIBRATION_CACHE_DIR, name);
+}
+
+int calibration_cache_find(char * path) {
+	char prefix[128];
+	char name[128];
+	char latest[FILENAME_MAX];
+	time_t latest_time = 0;
+	struct stat st;
+	struct dirent * entry;
+	DIR * dir;
+
+	cache_prefix(prefix);
+	strcpy(name, prefix);
+	/* without data, nothing can be reused */
+	if (hash_file(name + strlen(name), job_fopen(DATA_FILENAME, "rb")) != 0)
+		return CALIBRATION_CACHE_MISS;
+	cache_path(path, name);
+	if (access(path, R_OK) == 0)
+		return CALIBRATION_CACHE_HIT;
+
+	dir = opendir(CALIBRATION_CACHE_DIR);
+	if (dir == NULL)
+		return CALIBRATION_CACHE_MISS;
+	latest[0] = 0;
+	while ((entry = readdir(dir)) != NULL) {
+		/* entries being written have a suffix */
+		if (strncmp(entry->d_name, prefix, strlen(prefix)) != 0 || strchr(
+				entry->d_name, '.') != NULL)
+			continue;
+		cache_path(path, entry->d_name);
+		if (stat(path, &st) == 0 && (latest[0] == 0 || st.st_mtime
+				> latest_time)) {
+			strcpy(latest, path);
+			latest_time = st.st_mtime;
+		}
+	}
+	closedir(dir);
+	strcpy(path, latest);
+	return latest[0] == 0 ? CALIBRATION_CACHE_MISS : CALIBRATION_CACHE_WARM;
+}
+
+void calibration_cache_read(const char * path, mcmc ** chains,
+		const unsigned int n_chains) {
+	FILE * f = fopen(path, "r");
+	if (f == NULL) {
+		perror("could not read calibration cache entry");
+		exit(1);
+	}
+	read_calibration(f, chains, n_chains);
+	fclose(f);
+}
+
+void calibration_cache_store(mcmc ** chains, const unsigned int n_chains) {
+	char name[128];
+	char path[FILENAME_MAX];
+	char tmp[FILENAME_MAX + 64];
+	FILE * f;
+
+	cache_prefix(name);
+	if (hash_file(name + strlen(name), job_fopen(DATA_FILENAME, "rb")) != 0)
+		return;
+	cache_path(path, name);
+	/* several jobs and processes may store at once, so only complete
+	 * entries get the name */
+	sprintf(tmp, "%s.%ld.%p", path, (long) getpid(), (void *) chains);
+	mkdir(CALIBRATION_CACHE_DIR, 0777);
+	f = fopen(tmp, "w");
+	if (f == NULL) {
+		perror("could not write calibration cache entry");
+		return;
+	}
+	write_calibration(f, chains, n_chains);
+	if (fclose(f) != 0 || rename(tmp, path) != 0) {
+		perror("could not write calibration cache entry");
+		remove(tmp);
+		return;
+	}
+	printf("stored calibration in %s\n", path);
+}
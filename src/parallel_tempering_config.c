@@ -24,19 +24,24 @@
 #include "define_defaults.h"
 #include "gsl_helper.h"
 #include "utils.h"
+#include "format_double.h"
 
 void write_params_file(mcmc * m) {
 	unsigned int i;
-	FILE * f = fopen(PARAMS_FILENAME "_suggested", "w");
+	FILE * f = job_fopen(PARAMS_FILENAME "_suggested", "w");
 	if (f != NULL) {
 		for (i = 0; i < get_n_par(m); i++) {
-			fprintf(
-					f,
-					DUMP_FORMAT "\t" DUMP_FORMAT "\t" DUMP_FORMAT "\t%s\t" DUMP_FORMAT "\n",
-					gsl_vector_get(get_params_best(m), i), gsl_vector_get(
-							get_params_min(m), i), gsl_vector_get(
-							get_params_max(m), i), get_params_descr(m)[i],
-					gsl_vector_get(get_steps(m), i));
+			fprint_double(f, gsl_vector_get(get_params_best(m), i));
+			fputc('\t', f);
+			fprint_double(f, gsl_vector_get(get_params_min(m), i));
+			fputc('\t', f);
+			fprint_double(f, gsl_vector_get(get_params_max(m), i));
+			fprintf(f, "\t%s\t", get_params_descr(m)[i]);
+			fprint_double(f, gsl_vector_get(get_steps(m), i));
+			if (get_params_boundary_for(m, i) != BOUNDARY_REDRAW)
+				fprintf(f, "\t%s", mcmc_boundary_name(
+						get_params_boundary_for(m, i)));
+			fputc('\n', f);
 		}
 		fclose(f);
 		printf("new suggested parameters file has been written\n");
@@ -53,21 +58,25 @@ void write_calibration_summary(mcmc ** chains, unsigned int n_chains) {
 	unsigned int n_pars = get_n_par(chains[0]);
 	gsl_vector * steps;
 
-	FILE * f = fopen("calibration_summary", "w");
+	FILE * f = job_fopen("calibration_summary", "w");
 	if (f != NULL) {
 		fprintf(f, "Summary of calibrations\n");
 		fprintf(f, "\nBETA TABLE\n");
 		fprintf(f, "Chain # | Calculated | Calibrated\n");
 		for (i = 0; i < n_chains; i++) {
-			fprintf(f, "Chain %d | " DUMP_FORMAT " | %f\n", i, get_chain_beta(
-					i, n_chains, beta_0), get_beta(chains[i]));
+			fprintf(f, "Chain %d | ", i);
+			fprint_double(f, get_chain_beta(i, n_chains, beta_0));
+			fprintf(f, " | ");
+			fprint_double(f, get_beta(chains[i]));
+			fprintf(f, "\n");
 		}
 		fprintf(f, "\nSTEPWIDTH TABLE\n");
 		fprintf(f, "Chain # | Calibrated stepwidths... \n");
 		for (i = 0; i < n_chains; i++) {
 			fprintf(f, "%d", i);
 			for (j = 0; j < n_pars; j++) {
-				fprintf(f, "\t" DUMP_FORMAT, get_steps_for(chains[i], j));
+				fputc('\t', f);
+				fprint_double(f, get_steps_for(chains[i], j));
 			}
 			fprintf(f, "\n");
 		}
@@ -81,7 +90,8 @@ void write_calibration_summary(mcmc ** chains, unsigned int n_chains) {
 			steps = dup_vector(get_steps(chains[0]));
 			gsl_vector_scale(steps, pow(get_beta(chains[i]), -0.5));
 			for (j = 0; j < n_pars; j++) {
-				fprintf(f, "\t" DUMP_FORMAT, gsl_vector_get(steps, j));
+				fputc('\t', f);
+				fprint_double(f, gsl_vector_get(steps, j));
 			}
 			gsl_vector_free(steps);
 			fprintf(f, "\n");
@@ -93,30 +103,56 @@ void write_calibration_summary(mcmc ** chains, unsigned int n_chains) {
 	}
 }
 mcmc ** setup_chains() {
-	unsigned int i;
+	int i;
 	mcmc ** chains;
+	unsigned long * seeds;
 	const char * params_filename = PARAMS_FILENAME;
 	const char * data_filename = DATA_FILENAME;
-	const unsigned int n_beta = N_BETA;
+	const int n_beta = N_BETA;
+#ifdef NUMA
+	int first[NUMA_MAX_NODES];
+#endif
 	chains = (mcmc**) mem_calloc(n_beta, sizeof(mcmc*));
 	assert(chains != NULL);
 
 	printf("Initializing %d chains ...\n", n_beta);
+	chains[0] = mcmc_load_params(params_filename);
+	mcmc_load_data(chains[0], data_filename);
+	mcmc_check(chains[0]);
+#ifdef NUMA
+	numa_pin_threads();
+	for (i = 0; i < NUMA_MAX_NODES; i++)
+		first[i] = -1;
+	first[numa_current_node()] = 0;
+#endif
+	/* before the copies are made, as they read the first chain */
+	chains[0]->additional_data = mem_malloc(sizeof(parallel_tempering_mcmc));
+	set_beta(chains[0], 1);
+	/* drawn in chain order, so the seeds do not depend on the threads */
+	seeds = (unsigned long *) mem_calloc(n_beta, sizeof(unsigned long));
+	assert(seeds != NULL);
+#ifdef BLOCK_RANDOM
+	for (i = 1; i < n_beta; i++)
+		seeds[i] = gsl_rng_get(get_random(chains[0]));
+#endif
+	/* the other chains are copies of the first one, made by the thread
+	 * that runs them in the sampler (same schedule). They share its
+	 * generator, as the generators of the threads all start with the
+	 * same seed. The loop runs over all chains, so the schedule is that of
+	 * the sampler. */
+#pragma omp parallel for schedule(static)
 	for (i = 0; i < n_beta; i++) {
-		chains[i] = mcmc_load_params(params_filename);
-		if (i == 0) {
-			mcmc_load_data(chains[i], data_filename);
-			chains[i]->additional_data
-					= mem_malloc(sizeof(parallel_tempering_mcmc));
-			set_beta(chains[i], 1.0);
-		} else {
-			mcmc_reuse_data(chains[i], chains[0]);
-		}
-		mcmc_check(chains[i]);
+		if (i == 0)
+			continue;
+		chains[i] = mcmc_clone_shared(chains[0], seeds[i]);
+#ifdef NUMA
+		numa_local_data(chains, i, first);
+#endif
 		chains[i]->additional_data = mem_malloc(
 				sizeof(parallel_tempering_mcmc));
 		set_beta(chains[i], 1);
 	}
+	mem_free(seeds);
 	IFDEBUG
 	printf("Initializing %d chains ... done\n", n_beta);
 	return chains;
@@ -128,18 +164,13 @@ mcmc ** setup_chains() {
  * @return lines read
  **/
 void read_calibration_file(mcmc ** chains, unsigned int n_chains) {
-	unsigned int i;
-	unsigned int j;
-	unsigned int err = 0;
-	unsigned int n_par = get_n_par(chains[0]);
-	double v;
 	int r;
 	FILE * f;
 
 	IFDEBUG
 	printf("opening calibration file %s\n", CALIBRATION_FILE);
 
-	f = fopen(CALIBRATION_FILE, "r");
+	f = job_fopen(CALIBRATION_FILE, "r");
 	if (f == NULL) {
 		perror("could not read calibration file '" CALIBRATION_FILE "'");
 		exit(1);
@@ -147,6 +178,19 @@ void read_calibration_file(mcmc ** chains, unsigned int n_chains) {
 
 	IFDEBUG
 	printf("reading calibration file %s\n", CALIBRATION_FILE);
+	read_calibration(f, chains, n_chains);
+
+	r = fclose(f);
+	assert(r == 0);
+}
+
+void read_calibration(FILE * f, mcmc ** chains, unsigned int n_chains) {
+	unsigned int i;
+	unsigned int j;
+	unsigned int err = 0;
+	unsigned int n_par = get_n_par(chains[0]);
+	double v;
+
 	for (i = 0; i < n_chains && !feof(f); i++) {
 		if (fscanf(f, "%lf", &v) != 1)
 			err++;
@@ -168,37 +212,41 @@ void read_calibration_file(mcmc ** chains, unsigned int n_chains) {
 		}
 		set_params_best(chains[i], get_params(chains[i]));
 	}
-
-	r = fclose(f);
-	assert(r == 0);
 }
 
 void write_calibrations_file(mcmc ** chains, const unsigned int n_chains) {
 	FILE * f;
-	unsigned int i;
-	unsigned int j;
-	unsigned int n_par = get_n_par(chains[0]);
 	int r;
 
-	f = fopen(CALIBRATION_FILE, "w");
+	f = job_fopen(CALIBRATION_FILE, "w");
 	if (f == NULL) {
 		perror("error writing to calibration results file");
 		exit(1);
 	}
+	write_calibration(f, chains, n_chains);
+	r = fclose(f);
+	assert(r == 0);
+	printf("wrote calibration results for %d chains to %s\n", n_chains,
+			CALIBRATION_FILE);
+}
+
+void write_calibration(FILE * f, mcmc ** chains, const unsigned int n_chains) {
+	unsigned int i;
+	unsigned int j;
+	unsigned int n_par = get_n_par(chains[0]);
+
 	for (j = 0; j < n_chains; j++) {
-		fprintf(f, DUMP_FORMAT, get_beta(chains[j]));
+		fprint_double(f, get_beta(chains[j]));
 		for (i = 0; i < n_par; i++) {
-			fprintf(f, "\t" DUMP_FORMAT, get_steps_for(chains[j], i));
+			fputc('\t', f);
+			fprint_double(f, get_steps_for(chains[j], i));
 		}
 		for (i = 0; i < n_par; i++) {
-			fprintf(f, "\t" DUMP_FORMAT, get_params_for(chains[j], i));
+			fputc('\t', f);
+			fprint_double(f, get_params_for(chains[j], i));
 		}
 		fprintf(f, "\n");
 	}
-	r = fclose(f);
-	assert(r == 0);
-	printf("wrote calibration results for %d chains to %s\n", n_chains,
-			CALIBRATION_FILE);
 }
 
 
@@ -34,4 +34,85 @@ void read_calibration_file(mcmc ** chains, unsigned int n_chains);
 
 void write_calibrations_file(mcmc ** chains, const unsigned int n_chains);
 
+/**
+ * read betas, stepwidths and start values of the chains from an open file
+ * in the format of #CALIBRATION_FILE
+ */
+void read_calibration(FILE * f, mcmc ** chains, unsigned int n_chains);
+
+/**
+ * write betas, stepwidths and current values of the chains to an open file
+ */
+void write_calibration(FILE * f, mcmc ** chains, const unsigned int n_chains);
+
+#ifdef __NEVER_SET_FOR_DOCUMENTATION_ONLY
+/**
+ * Keep the results of calibrate_rest in #CALIBRATION_CACHE_DIR and reuse
+ * them.
+ *
+ * The entries are keyed by hashes of the model binary, the params file,
+ * the calibration and tempering settings and the data file. If all match,
+ * calibrate_first and calibrate_rest just copy the entry. If only the data
+ * differs, the calibration starts from the step widths and betas of the most
+ * recent such entry, which usually needs few iterations.
+ */
+#define CALIBRATION_CACHE
+#endif
+
+#ifndef CALIBRATION_CACHE_DIR
+/**
+ * directory of the calibration cache (see #CALIBRATION_CACHE), relative to
+ * where the program is started. Use an absolute path to share it.
+ */
+#define CALIBRATION_CACHE_DIR "calibration_cache"
+#endif
+
+/** no usable entry in the calibration cache */
+#define CALIBRATION_CACHE_MISS 0
+/** entry for the same model, params file, settings and data */
+#define CALIBRATION_CACHE_HIT 1
+/** entry for the same model, params file and settings, other data */
+#define CALIBRATION_CACHE_WARM 2
+
+/**
+ * looks up the calibration cache for the current job
+ *
+ * @param path is set to the entry found (FILENAME_MAX characters)
+ * @return #CALIBRATION_CACHE_HIT, #CALIBRATION_CACHE_WARM or
+ * #CALIBRATION_CACHE_MISS
+ */
+int calibration_cache_find(char * path);
+
+/**
+ * read an entry of the calibration cache into the chains
+ */
+void calibration_cache_read(const char * path, mcmc ** chains,
+		const unsigned int n_chains);
+
+/**
+ * store the calibration of the chains for the current job
+ */
+void calibration_cache_store(mcmc ** chains, const unsigned int n_chains);
+
+/** nodes beyond this share the data of the last one (see #NUMA) */
+#define NUMA_MAX_NODES 64
+
+/**
+ * @return the NUMA node of the CPU the calling thread runs on, 0 if unknown
+ */
+int numa_current_node();
+
+/**
+ * pin each OpenMP thread to one CPU, unless OMP_PROC_BIND is set.
+ */
+void numa_pin_threads();
+
+/**
+ * give chain i the data of chains[0] on the node of the calling thread.
+ * The first chain on a node gets a copy, the others reuse it.
+ *
+ * @param first index of the first chain on each node, -1 if none yet
+ */
+void numa_local_data(mcmc ** chains, const unsigned int i, int * first);
+
 #endif /* PARALLEL_TEMPERING_CONFIG_H_ */
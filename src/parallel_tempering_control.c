@@ -0,0 +1,144 @@
+/*
+    APEMoST - Automated Parameter Estimation and Model Selection Toolkit
+    Copyright (C) 2009  Johannes Buchner
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+/* for mkfifo and the non-blocking reads */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include "mcmc.h"
+#include "parallel_tempering_control.h"
+#include "parallel_tempering_config.h"
+#include "parallel_tempering_run.h"
+#include "utils.h"
+#include "debug.h"
+
+/** longest command line */
+#define CONTROL_LINE_LENGTH 256
+
+int control_open(const char * path) {
+	int fd;
+
+	if (mkfifo(path, 0600) != 0 && errno != EEXIST) {
+		perror("control: could not create the pipe");
+		return -1;
+	}
+	/* opened for writing too, so reading does not see the end of file
+	 * whenever a writer is done */
+	fd = open(path, O_RDWR | O_NONBLOCK);
+	if (fd < 0)
+		perror("control: could not open the pipe");
+	return fd;
+}
+
+void control_close(const int fd, const char * path) {
+	if (fd < 0)
+		return;
+	close(fd);
+	unlink(path);
+}
+
+static void checkpoint(mcmc ** chains, const unsigned int n_beta,
+		FILE * acceptance_file, FILE ** probabilities_file) {
+	unsigned int i;
+	FILE * f;
+
+	fflush(acceptance_file);
+	for (i = 0; i < n_beta; i++) {
+		fflush(probabilities_file[i]);
+		mcmc_dump_flush(chains[i]);
+	}
+	f = job_fopen(CHECKPOINT_FILE, "w");
+	if (f == NULL) {
+		perror("control: could not write " CHECKPOINT_FILE);
+		return;
+	}
+	write_calibration(f, chains, n_beta);
+	fclose(f);
+	printf("\nwrote checkpoint to %s\n", CHECKPOINT_FILE);
+}
+
+static void execute(const char * line, sampler_control * c, mcmc ** chains,
+		const unsigned int n_beta, FILE * acceptance_file,
+		FILE ** probabilities_file) {
+	char command[CONTROL_LINE_LENGTH];
+	char word[CONTROL_LINE_LENGTH];
+	unsigned long n;
+	const int args = sscanf(line, "%s %lu", command, &n);
+
+	if (args < 1)
+		return;
+	if (strcmp(command, "checkpoint") == 0) {
+		checkpoint(chains, n_beta, acceptance_file, probabilities_file);
+	} else if (strcmp(command, "thin") == 0 && args == 2 && n > 0) {
+		c->thinning = n;
+		printf("\nwriting every %lu. iteration\n", n);
+	} else if (strcmp(command, "dump") == 0 && sscanf(line, "%*s %s", word)
+			== 1 && (strcmp(word, "on") == 0 || strcmp(word, "off") == 0)) {
+		c->dumping = strcmp(word, "on") == 0;
+		printf("\nwriting dump files: %s\n", word);
+	} else if (strcmp(command, "stop") == 0 && args == 1) {
+		printf("\nstopping on request\n");
+		run = 0;
+	} else if (strcmp(command, "stop") == 0) {
+		c->max_iterations = n;
+		printf("\nstopping after %lu iterations\n", n);
+	} else if ((strcmp(command, "pause") == 0 || strcmp(command, "resume")
+			== 0) && args == 2 && n < n_beta) {
+		c->paused[n] = strcmp(command, "pause") == 0;
+		printf("\nchain %lu: %sd\n", n, command);
+	} else {
+		fprintf(stderr, "control: unknown command: %s\n", line);
+	}
+}
+
+void control_poll(const int fd, sampler_control * c, mcmc ** chains,
+		const unsigned int n_beta, FILE * acceptance_file,
+		FILE ** probabilities_file) {
+	static char buffer[CONTROL_LINE_LENGTH];
+	static unsigned int length = 0;
+	char * end;
+	ssize_t r;
+
+	if (fd < 0)
+		return;
+	while ((r = read(fd, buffer + length, sizeof(buffer) - 1 - length)) > 0) {
+		length += r;
+		buffer[length] = 0;
+		while ((end = strchr(buffer, '\n')) != NULL) {
+			*end = 0;
+			IFDEBUG
+				printf("control: %s\n", buffer);
+			execute(buffer, c, chains, n_beta, acceptance_file,
+					probabilities_file);
+			length -= end + 1 - buffer;
+			memmove(buffer, end + 1, length + 1);
+		}
+		if (length == sizeof(buffer) - 1) {
+			fprintf(stderr, "control: command too long\n");
+			length = 0;
+		}
+	}
+	fflush(stdout);
+}
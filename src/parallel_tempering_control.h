@@ -0,0 +1,102 @@
+/*
+    APEMoST - Automated Parameter Estimation and Model Selection Toolkit
+    Copyright (C) 2009  Johannes Buchner
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef PARALLEL_TEMPERING_CONTROL_H_
+#define PARALLEL_TEMPERING_CONTROL_H_
+
+#include <stdio.h>
+#include "mcmc.h"
+
+#ifdef __NEVER_SET_FOR_DOCUMENTATION_ONLY
+/**
+ * Steer a running sampler by writing commands to this named pipe
+ * (FIFO), which is created at the start of the run, e.g.
+ * <code>echo "thin 10" > control</code>.
+ *
+ * The commands are one per line:
+ * <ul>
+ * <li>checkpoint: flush all files and write the current positions to
+ * #CHECKPOINT_FILE</li>
+ * <li>thin n: only write every n-th iteration to the dump files</li>
+ * <li>dump on|off: write the visited parameters and probabilities or
+ * not</li>
+ * <li>stop [n]: stop now, or after n iterations in total (0 for
+ * never)</li>
+ * <li>pause i / resume i: stop or restart stepping chain i</li>
+ * </ul>
+ * They are carried out between two blocks of #N_SWAP steps.
+ */
+#define CONTROL_FIFO "control"
+#endif
+
+#ifndef CHECKPOINT_FILE
+/**
+ * Written by the checkpoint command (see #CONTROL_FIFO), in the format of
+ * the calibration file. Copy it over calibration_results to continue from
+ * there with <code>run --append</code>.
+ */
+#define CHECKPOINT_FILE "checkpoint_results"
+#endif
+
+/**
+ * state of the sampler that can be changed while it runs
+ */
+typedef struct {
+	/**
+	 * stop after this many iterations, 0 for never
+	 */
+	unsigned long max_iterations;
+	/**
+	 * write every n-th iteration to the dump files
+	 */
+	unsigned int thinning;
+	/**
+	 * write to the dump files at all?
+	 */
+	int dumping;
+	/**
+	 * for each chain, whether it is paused
+	 */
+	int * paused;
+} sampler_control;
+
+/**
+ * creates the named pipe at path, if needed, and opens it without
+ * blocking.
+ *
+ * @return file descriptor, or -1 if it could not be opened
+ */
+int control_open(const char * path);
+
+/**
+ * reads the commands written to the pipe so far and carries them out.
+ *
+ * @param acceptance_file the open acceptance_rate.dump
+ * @param probabilities_file the open prob-chain*.dump files
+ */
+void control_poll(const int fd, sampler_control * c, mcmc ** chains,
+		const unsigned int n_beta, FILE * acceptance_file,
+		FILE ** probabilities_file);
+
+/**
+ * closes and removes the pipe.
+ */
+void control_close(const int fd, const char * path);
+
+#endif /* PARALLEL_TEMPERING_CONTROL_H_ */
@@ -21,6 +21,7 @@
 #include "debug.h"
 #include "mcmc_internal.h"
 #include "gsl_helper.h"
+#include "trace.h"
 
 static int check_swap_probability(mcmc * a, mcmc * b) {
 	double a_beta, b_beta;
@@ -58,6 +59,7 @@ int parallel_tempering_decide_swap_random(mcmc ** chains, int n_beta,
 		a = (int) (n_beta * 1000 * get_next_uniform_random(chains[0]))
 				% (n_beta - 1);
 		b = (a + 1) % n_beta;
+		inc_swaptries(chains[a]);
 		if (check_swap_probability(chains[a], chains[b]) == 1)
 			return a;
 	}
@@ -75,6 +77,7 @@ int parallel_tempering_decide_swap_nonrandom(mcmc ** chains, int n_beta,
 		return -1;
 	if (iter % n_swap == 0) {
 		a = iter / n_swap % (n_beta - 1);
+		inc_swaptries(chains[a]);
 		if (check_swap_probability(chains[a], chains[a + 1]) == 1)
 			return a;
 	}
@@ -91,22 +94,55 @@ int parallel_tempering_decide_swap_now(mcmc ** chains, int n_beta) {
 		return -1;
 	a = (int) (n_beta * 1000 * get_next_uniform_random(chains[0])) % (n_beta
 			- 1);
+	inc_swaptries(chains[a]);
 	if (check_swap_probability(chains[a], chains[a + 1]) == 1)
 		return a;
 	return -1;
 }
 
+#ifdef ENSEMBLE
+/**
+ * chooses one chain by random and swaps walkers with the next one (see
+ * markov_chain_ensemble_swap). Every pair of walkers is a swap try.
+ *
+ * @return the chain, if walkers were swapped, -1 otherwise
+ */
+static int parallel_tempering_ensemble_swap(mcmc ** chains, int n_beta) {
+	int a;
+	unsigned int w;
+	unsigned int n;
+	assert(n_beta > 0);
+	if (n_beta == 1)
+		return -1;
+	a = (int) (n_beta * 1000 * get_next_uniform_random(chains[0])) % (n_beta
+			- 1);
+	/* a paused chain may not have an ensemble yet */
+	if (chains[a]->ensemble_prob == NULL || chains[a + 1]->ensemble_prob
+			== NULL)
+		return -1;
+	n = markov_chain_ensemble_swap(chains[a], chains[a + 1], get_beta(
+			chains[a]), get_beta(chains[a + 1]));
+	for (w = 0; w < chains[a]->ensemble->size1; w++)
+		inc_swaptries(chains[a]);
+	for (w = 0; w < n; w++)
+		inc_swapcount(chains[a]);
+	if (n > 0)
+		return a;
+	return -1;
+}
+#endif
+
 static void parallel_tempering_do_swap(mcmc ** chains, int n_beta, int a) {
 	double r;
 	int b;
-	gsl_vector * temp;
 	assert(a < n_beta - 1);
 	b = a + 1;
 	IFDEBUG
 		printf("swapping %d with %d\n", a, b);
-	temp = dup_vector(get_params(chains[a]));
-	set_params(chains[a], dup_vector(get_params(chains[b])));
-	set_params(chains[b], temp);
+#ifndef ENSEMBLE
+	/* the walkers have been swapped already */
+	gsl_vector_swap(get_params(chains[a]), get_params(chains[b]));
+#endif
 
 	r = get_prob_best(chains[a]);
 	if (r > get_prob_best(chains[b])) {
@@ -125,9 +161,13 @@ static void parallel_tempering_do_swap(mcmc ** chains, int n_beta, int a) {
 void tempering_interaction(mcmc ** chains, unsigned int n_beta,
 		unsigned long iter) {
 	int candidate;
+	TRACE_DECLARE(t)
 	(void) iter;
 
-#ifdef RANDOMSWAP
+	TRACE_START(t);
+#ifdef ENSEMBLE
+	candidate = parallel_tempering_ensemble_swap(chains, n_beta);
+#elif defined(RANDOMSWAP)
 	candidate = parallel_tempering_decide_swap_random(chains, n_beta, 1);
 #else
 	candidate = parallel_tempering_decide_swap_now(chains, n_beta);
@@ -136,7 +176,10 @@ void tempering_interaction(mcmc ** chains, unsigned int n_beta,
 	if (candidate != -1) {
 		/* wait for threads to reach iteration */
 		parallel_tempering_do_swap(chains, n_beta, candidate);
+#ifndef ENSEMBLE
 		inc_swapcount(chains[candidate]);
+#endif
 	}
+	TRACE_EVENT(t, "swap", candidate, "accepted", candidate != -1);
 }
 
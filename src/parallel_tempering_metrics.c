@@ -0,0 +1,228 @@
+/*
+    APEMoST - Automated Parameter Estimation and Model Selection Toolkit
+    Copyright (C) 2009  Johannes Buchner
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+/* for the socket functions */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/time.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "mcmc.h"
+#include "parallel_tempering_beta.h"
+#include "parallel_tempering_metrics.h"
+#include "timing.h"
+#include "debug.h"
+
+/** replies must not hold up the sampler for longer than this */
+#define METRICS_TIMEOUT_USEC 100000
+
+static int listen_on(const int fd, const struct sockaddr * address,
+		const socklen_t length) {
+	if (bind(fd, address, length) != 0 || listen(fd, 16) != 0) {
+		perror("metrics: could not listen");
+		close(fd);
+		return -1;
+	}
+	/* a scraper hanging up early must not end the run */
+	signal(SIGPIPE, SIG_IGN);
+	return fd;
+}
+
+int metrics_listen_tcp(const int port) {
+	struct sockaddr_in address;
+	int one = 1;
+	const int fd = socket(AF_INET, SOCK_STREAM, 0);
+
+	if (fd < 0) {
+		perror("metrics: socket");
+		return -1;
+	}
+	setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+	memset(&address, 0, sizeof(address));
+	address.sin_family = AF_INET;
+	address.sin_port = htons(port);
+	address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	return listen_on(fd, (struct sockaddr *) &address, sizeof(address));
+}
+
+int metrics_listen_unix(const char * path) {
+	struct sockaddr_un address;
+	const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+
+	if (fd < 0) {
+		perror("metrics: socket");
+		return -1;
+	}
+	if (strlen(path) >= sizeof(address.sun_path)) {
+		fprintf(stderr, "metrics: socket path too long: %s\n", path);
+		close(fd);
+		return -1;
+	}
+	memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	strcpy(address.sun_path, path);
+	unlink(path);
+	return listen_on(fd, (struct sockaddr *) &address, sizeof(address));
+}
+
+void metrics_close(const int fd, const char * path) {
+	if (fd < 0)
+		return;
+	close(fd);
+	if (path != NULL)
+		unlink(path);
+}
+
+static long file_size(FILE * f) {
+	long size;
+	if (f == NULL)
+		return 0;
+	size = ftell(f);
+	return size < 0 ? 0 : size;
+}
+
+/**
+ * size of all files the sampler writes to
+ */
+static long dump_bytes(const mcmc ** chains, const unsigned int n_beta,
+		FILE * acceptance_file, FILE ** probabilities_file) {
+	unsigned int i;
+	unsigned int j;
+	long sum = file_size(acceptance_file);
+
+	for (i = 0; i < n_beta; i++) {
+		sum += file_size(probabilities_file[i]);
+		if (chains[i]->files == NULL)
+			continue;
+		for (j = 0; j < get_n_par(chains[i]); j++)
+			sum += file_size(chains[i]->files[j]);
+	}
+	return sum;
+}
+
+static void write_metrics(FILE * f, const mcmc ** chains,
+		const unsigned int n_beta, const unsigned long iter,
+		const double iter_rate, const long bytes) {
+	unsigned int i;
+
+	fprintf(f, "# HELP apemost_iterations_total Iterations done so far "
+		"(all chains step together).\n");
+	fprintf(f, "# TYPE apemost_iterations_total counter\n");
+	fprintf(f, "apemost_iterations_total %lu\n", iter);
+	fprintf(f, "# HELP apemost_iterations_per_second Iterations per second "
+		"over the last second (all chains step together).\n");
+	fprintf(f, "# TYPE apemost_iterations_per_second gauge\n");
+	fprintf(f, "apemost_iterations_per_second %f\n", iter_rate);
+
+	fprintf(f, "# HELP apemost_beta Inverse temperature of the chain.\n");
+	fprintf(f, "# TYPE apemost_beta gauge\n");
+	for (i = 0; i < n_beta; i++)
+		fprintf(f, "apemost_beta{chain=\"%u\"} %f\n", i, get_beta(chains[i]));
+	fprintf(f, "# HELP apemost_acceptance_rate Accepted steps of the chain.\n");
+	fprintf(f, "# TYPE apemost_acceptance_rate gauge\n");
+	for (i = 0; i < n_beta; i++)
+		fprintf(f, "apemost_acceptance_rate{chain=\"%u\"} %f\n", i,
+				get_accept_rate_global(chains[i]));
+	fprintf(f, "# HELP apemost_best_log_probability Highest log probability "
+		"the chain has seen.\n");
+	fprintf(f, "# TYPE apemost_best_log_probability gauge\n");
+	for (i = 0; i < n_beta; i++)
+		fprintf(f, "apemost_best_log_probability{chain=\"%u\"} %f\n", i,
+				get_prob_best(chains[i]));
+
+	fprintf(f, "# HELP apemost_swaps_total Accepted swaps of the neighbouring "
+		"chains.\n");
+	fprintf(f, "# TYPE apemost_swaps_total counter\n");
+	for (i = 0; i + 1 < n_beta; i++)
+		fprintf(f, "apemost_swaps_total{pair=\"%u-%u\"} %lu\n", i, i + 1,
+				get_swapcount(chains[i]));
+	fprintf(f, "# HELP apemost_swap_tries_total Tried swaps of the "
+		"neighbouring chains.\n");
+	fprintf(f, "# TYPE apemost_swap_tries_total counter\n");
+	for (i = 0; i + 1 < n_beta; i++)
+		fprintf(f, "apemost_swap_tries_total{pair=\"%u-%u\"} %lu\n", i, i + 1,
+				get_swaptries(chains[i]));
+
+	fprintf(f, "# HELP apemost_dump_bytes Size of the dump files.\n");
+	fprintf(f, "# TYPE apemost_dump_bytes gauge\n");
+	fprintf(f, "apemost_dump_bytes %ld\n", bytes);
+}
+
+void metrics_serve(const int fd, const mcmc ** chains,
+		const unsigned int n_beta, const unsigned long iter,
+		FILE * acceptance_file, FILE ** probabilities_file) {
+	static unsigned long last_time = 0;
+	static unsigned long last_iter = 0;
+	static double iter_rate = 0;
+	const unsigned long now = timing_now();
+	struct timeval timeout;
+	fd_set pending;
+	char request[1024];
+	int client;
+	FILE * f;
+
+	if (fd < 0)
+		return;
+	if (last_time == 0 || iter < last_iter) {
+		last_time = now;
+		last_iter = iter;
+	} else if (timing_seconds(last_time, now) >= 1) {
+		iter_rate = (iter - last_iter) / timing_seconds(last_time, now);
+		last_time = now;
+		last_iter = iter;
+	}
+
+	while (1) {
+		FD_ZERO(&pending);
+		FD_SET(fd, &pending);
+		timeout.tv_sec = 0;
+		timeout.tv_usec = 0;
+		if (select(fd + 1, &pending, NULL, NULL, &timeout) <= 0)
+			return;
+		client = accept(fd, NULL, NULL);
+		if (client < 0)
+			return;
+		timeout.tv_usec = METRICS_TIMEOUT_USEC;
+		setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+		setsockopt(client, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+		/* every path gets the metrics, so the request is not looked at */
+		if (recv(client, request, sizeof(request), 0) < 0) {
+			IFDEBUG
+				perror("metrics: reading the request");
+		}
+		f = fdopen(client, "w");
+		if (f == NULL) {
+			close(client);
+			continue;
+		}
+		fprintf(f, "HTTP/1.0 200 OK\r\n"
+			"Content-Type: text/plain; version=0.0.4\r\n\r\n");
+		write_metrics(f, chains, n_beta, iter, iter_rate, dump_bytes(chains,
+				n_beta, acceptance_file, probabilities_file));
+		fclose(f);
+	}
+}
@@ -0,0 +1,81 @@
+/*
+    APEMoST - Automated Parameter Estimation and Model Selection Toolkit
+    Copyright (C) 2009  Johannes Buchner
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef PARALLEL_TEMPERING_METRICS_H_
+#define PARALLEL_TEMPERING_METRICS_H_
+
+#include <stdio.h>
+#include "mcmc.h"
+
+#ifdef __NEVER_SET_FOR_DOCUMENTATION_ONLY
+/**
+ * Serve the state of the sampler in the Prometheus text format over HTTP
+ * on 127.0.0.1 at this port, e.g. for cluster dashboards.
+ *
+ * The requests are answered by the sampler between two blocks of
+ * #N_SWAP steps, so no additional thread is started.
+ *
+ * <code>curl http://127.0.0.1:9100/metrics</code>
+ */
+#define METRICS_PORT 9100
+/**
+ * Serve the metrics (see #METRICS_PORT) on a Unix domain socket at this
+ * path instead, e.g. "apemost.sock". The file is removed when the run
+ * ends.
+ *
+ * <code>curl --unix-socket apemost.sock http://localhost/metrics</code>
+ */
+#define METRICS_SOCKET "apemost.sock"
+#endif
+
+#if defined(METRICS_PORT) || defined(METRICS_SOCKET)
+#define METRICS
+#endif
+
+/**
+ * listen on 127.0.0.1 at the given port.
+ *
+ * @return socket, or -1 if it could not be opened
+ */
+int metrics_listen_tcp(const int port);
+
+/**
+ * listen on a Unix domain socket at path. An existing file at path is
+ * replaced.
+ *
+ * @return socket, or -1 if it could not be opened
+ */
+int metrics_listen_unix(const char * path);
+
+/**
+ * stops listening and removes the socket file at path (may be NULL).
+ */
+void metrics_close(const int fd, const char * path);
+
+/**
+ * answers the pending requests without waiting for new ones.
+ *
+ * @param acceptance_file the open acceptance_rate.dump
+ * @param probabilities_file the open prob-chain*.dump files
+ */
+void metrics_serve(const int fd, const mcmc ** chains,
+		const unsigned int n_beta, const unsigned long iter,
+		FILE * acceptance_file, FILE ** probabilities_file);
+
+#endif /* PARALLEL_TEMPERING_METRICS_H_ */
@@ -0,0 +1,120 @@
+/*
+    APEMoST - Automated Parameter Estimation and Model Selection Toolkit
+    Copyright (C) 2009  Johannes Buchner
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+/* for sched_getcpu and the CPU affinity functions */
+#define _GNU_SOURCE
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <dirent.h>
+#include <omp.h>
+
+#include "mcmc.h"
+#include "parallel_tempering_config.h"
+#include "debug.h"
+
+#ifdef __NEVER_SET_FOR_DOCUMENTATION_ONLY
+/**
+ * Keep the memory of each chain on the NUMA node of the thread that runs
+ * it (for machines with several sockets).
+ *
+ * The OpenMP threads are pinned to one CPU each, unless OMP_PROC_BIND is
+ * set, in which case the binding of the OpenMP runtime is used. Each chain
+ * is allocated by the thread that runs it, so its memory is placed on the
+ * local node. The data is copied once per node, by the first chain on
+ * that node.
+ */
+#define NUMA
+#endif
+
+int numa_current_node() {
+	char path[64];
+	DIR * dir;
+	struct dirent * entry;
+	int node = 0;
+	const int cpu = sched_getcpu();
+
+	if (cpu < 0)
+		return 0;
+	sprintf(path, "/sys/devices/system/cpu/cpu%d", cpu);
+	dir = opendir(path);
+	if (dir == NULL)
+		return 0;
+	while ((entry = readdir(dir)) != NULL) {
+		if (sscanf(entry->d_name, "node%d", &node) == 1)
+			break;
+		node = 0;
+	}
+	closedir(dir);
+	if (node >= NUMA_MAX_NODES)
+		node = NUMA_MAX_NODES - 1;
+	return node;
+}
+
+void numa_pin_threads() {
+	cpu_set_t available;
+	int n_cpus;
+
+	if (getenv("OMP_PROC_BIND") != NULL) {
+		IFDEBUG
+			debug("using the thread binding of OMP_PROC_BIND");
+		return;
+	}
+	if (sched_getaffinity(0, sizeof(available), &available) != 0) {
+		perror("sched_getaffinity");
+		return;
+	}
+	n_cpus = CPU_COUNT(&available);
+#pragma omp parallel
+	{
+		cpu_set_t pinned;
+		int cpu;
+		int k = omp_get_thread_num() % n_cpus;
+
+		for (cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+			if (CPU_ISSET(cpu, &available) && k-- == 0)
+				break;
+		}
+		CPU_ZERO(&pinned);
+		CPU_SET(cpu, &pinned);
+		if (sched_setaffinity(0, sizeof(pinned), &pinned) != 0)
+			perror("sched_setaffinity");
+	}
+}
+
+void numa_local_data(mcmc ** chains, const unsigned int i, int * first) {
+	const int node = numa_current_node();
+	gsl_matrix * copy;
+
+#pragma omp critical (numa_data)
+	{
+		if (first[node] < 0) {
+			IFDEBUG
+				printf("copying data to node %d for chain %d\n", node, i);
+			first[node] = i;
+			copy = gsl_matrix_alloc(chains[0]->data->size1,
+					chains[0]->data->size2);
+			assert(copy != NULL);
+			gsl_matrix_memcpy(copy, chains[0]->data);
+			set_data(chains[i], copy);
+		} else {
+			mcmc_reuse_data(chains[i], chains[first[node]]);
+		}
+	}
+}
@@ -18,9 +18,9 @@
 
 #include "mcmc.h"
 #include "parallel_tempering_run.h"
+#include "timing.h"
 
 #include <signal.h>
-#include <time.h>
 
 int run = 1;
 int dumpflag;
@@ -38,13 +38,14 @@ void sigusr_handler(int signalnr) {
 	dumpflag = 1;
 }
 
-#include <time.h>
-
 int get_duration() {
-	static clock_t stored = 0;
-	clock_t new = stored;
-	stored = clock();
-	return stored - new;
+	static unsigned long stored = 0;
+#pragma omp threadprivate(stored)
+	unsigned long new = stored;
+	stored = timing_now();
+	if (new == 0)
+		return 0;
+	return (int) (1000 * timing_seconds(new, stored));
 }
 
 void register_signal_handlers() {
@@ -54,6 +55,6 @@ void register_signal_handlers() {
 }
 
 long unsigned int get_ticks_per_second() {
-	return CLOCKS_PER_SEC;
+	return 1000;
 }
 
@@ -22,8 +22,14 @@
 extern int run;
 extern int dumpflag;
 
+/**
+ * @return wall-clock milliseconds since the last call
+ */
 int get_duration();
 void register_signal_handlers();
+/**
+ * @return units of get_duration() per second
+ */
 long unsigned int get_ticks_per_second();
 
 #endif
@@ -0,0 +1,218 @@
+/*
+    APEMoST - Automated Parameter Estimation and Model Selection Toolkit
+    Copyright (C) 2009  Johannes Buchner
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <limits.h>
+#include <math.h>
+
+#include "random_block.h"
+
+#if ULONG_MAX > 0xffffffffUL
+
+/*
+ * xoshiro256+ by David Blackman and Sebastiano Vigna; normal numbers by the
+ * ziggurat method of George Marsaglia and Wai Wan Tsang, "The Ziggurat
+ * Method for Generating Random Variables" (2000).
+ */
+
+/** 2^-53 */
+#define DOUBLE_UNIT (1.0 / 9007199254740992.0)
+/** start of the tail of the ziggurat */
+#define ZIGGURAT_R 3.442619855899
+
+static long kn[128];
+static double wn[128];
+static double fn[128];
+static int ziggurat_ready = 0;
+
+static void ziggurat_setup() {
+	const double m1 = 2147483648.0;
+	const double vn = 9.91256303526217e-3;
+	double dn = ZIGGURAT_R;
+	double tn = dn;
+	double q = vn / exp(-.5 * dn * dn);
+	int i;
+
+	kn[0] = (long) ((dn / q) * m1);
+	kn[1] = 0;
+	wn[0] = q / m1;
+	wn[127] = dn / m1;
+	fn[0] = 1.;
+	fn[127] = exp(-.5 * dn * dn);
+	for (i = 126; i >= 1; i--) {
+		dn = sqrt(-2. * log(vn / dn + exp(-.5 * dn * dn)));
+		kn[i + 1] = (long) ((dn / tn) * m1);
+		tn = dn;
+		fn[i] = exp(-.5 * dn * dn);
+		wn[i] = dn / m1;
+	}
+}
+
+static unsigned long splitmix(unsigned long * x) {
+	unsigned long z = (*x += 0x9e3779b97f4a7c15UL);
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9UL;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111ebUL;
+	return z ^ (z >> 31);
+}
+
+/**
+ * next RANDOM_BLOCK_SIZE raw numbers. The lanes are independent, so the
+ * inner loop can be vectorised.
+ */
+static void fill_raw(random_block * b) {
+	unsigned int i;
+	unsigned int l;
+	unsigned long t;
+
+	for (i = 0; i < RANDOM_BLOCK_SIZE; i += RANDOM_LANES) {
+		for (l = 0; l < RANDOM_LANES; l++) {
+			b->raw[i + l] = b->state[0][l] + b->state[3][l];
+			t = b->state[1][l] << 17;
+			b->state[2][l] ^= b->state[0][l];
+			b->state[3][l] ^= b->state[1][l];
+			b->state[1][l] ^= b->state[2][l];
+			b->state[0][l] ^= b->state[3][l];
+			b->state[2][l] ^= t;
+			b->state[3][l] = (b->state[3][l] << 45) | (b->state[3][l] >> 19);
+		}
+	}
+	b->next_raw = 0;
+}
+
+static unsigned long next_raw(random_block * b) {
+	if (b->next_raw >= RANDOM_BLOCK_SIZE)
+		fill_raw(b);
+	return b->raw[b->next_raw++];
+}
+
+/** [0, 1) from the upper 53 bits */
+static double to_uniform(const unsigned long x) {
+	return (x >> 11) * DOUBLE_UNIT;
+}
+
+/** (0, 1) from the upper 53 bits */
+static double to_open_uniform(const unsigned long x) {
+	return ((x >> 11) + 0.5) * DOUBLE_UNIT;
+}
+
+/**
+ * slow path of the ziggurat, when the point is not inside the rectangle
+ * of its layer
+ */
+static double normal_tail(random_block * b, long hz, unsigned int iz) {
+	double x;
+	double y;
+	unsigned long u;
+
+	while (1) {
+		x = hz * wn[iz];
+		if (iz == 0) {
+			do {
+				x = -log(to_open_uniform(next_raw(b))) / ZIGGURAT_R;
+				y = -log(to_open_uniform(next_raw(b)));
+			} while (y + y < x * x);
+			return hz > 0 ? ZIGGURAT_R + x : -ZIGGURAT_R - x;
+		}
+		if (fn[iz] + to_uniform(next_raw(b)) * (fn[iz - 1] - fn[iz]) < exp(
+				-.5 * x * x))
+			return x;
+		u = next_raw(b);
+		hz = (long) (u >> 32) - 2147483648L;
+		iz = (unsigned int) (u >> 25) & 127;
+		if (labs(hz) < kn[iz])
+			return hz * wn[iz];
+	}
+}
+
+void random_block_seed(random_block * b, unsigned long seed) {
+	unsigned int i;
+	unsigned int l;
+	for (l = 0; l < RANDOM_LANES; l++) {
+		for (i = 0; i < 4; i++) {
+			b->state[i][l] = splitmix(&seed);
+		}
+	}
+	b->next_raw = RANDOM_BLOCK_SIZE;
+	b->next_normal = RANDOM_BLOCK_SIZE;
+	b->next_uniform = RANDOM_BLOCK_SIZE;
+	b->next_log_uniform = RANDOM_BLOCK_SIZE;
+}
+
+random_block * random_block_alloc(unsigned long seed) {
+	random_block * b = (random_block *) malloc(sizeof(random_block));
+	if (b == NULL)
+		return NULL;
+#pragma omp critical (ziggurat_setup)
+	{
+		if (!ziggurat_ready) {
+			ziggurat_setup();
+			ziggurat_ready = 1;
+		}
+	}
+	random_block_seed(b, seed);
+	return b;
+}
+
+void random_block_free(random_block * b) {
+	free(b);
+}
+
+double random_block_fill_normal(random_block * b) {
+	unsigned int i;
+	unsigned long u;
+	long hz;
+	unsigned int iz;
+
+	for (i = 0; i < RANDOM_BLOCK_SIZE; i++) {
+		u = next_raw(b);
+		hz = (long) (u >> 32) - 2147483648L;
+		iz = (unsigned int) (u >> 25) & 127;
+		if (labs(hz) < kn[iz])
+			b->normal[i] = hz * wn[iz];
+		else
+			b->normal[i] = normal_tail(b, hz, iz);
+	}
+	b->next_normal = 1;
+	return b->normal[0];
+}
+
+double random_block_fill_uniform(random_block * b) {
+	unsigned int i;
+	fill_raw(b);
+	for (i = 0; i < RANDOM_BLOCK_SIZE; i++) {
+		b->uniform[i] = to_uniform(b->raw[i]);
+	}
+	b->next_raw = RANDOM_BLOCK_SIZE;
+	b->next_uniform = 1;
+	return b->uniform[0];
+}
+
+double random_block_fill_log_uniform(random_block * b) {
+	unsigned int i;
+	fill_raw(b);
+	for (i = 0; i < RANDOM_BLOCK_SIZE; i++) {
+		b->log_uniform[i] = log(to_open_uniform(b->raw[i]));
+	}
+	b->next_raw = RANDOM_BLOCK_SIZE;
+	b->next_log_uniform = 1;
+	return b->log_uniform[0];
+}
+
+#elif defined BLOCK_RANDOM
+#error "BLOCK_RANDOM needs 64 bit long integers"
+#endif
@@ -0,0 +1,92 @@
+/*
+    APEMoST - Automated Parameter Estimation and Model Selection Toolkit
+    Copyright (C) 2009  Johannes Buchner
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RANDOM_BLOCK_H_
+#define RANDOM_BLOCK_H_
+
+#ifdef __NEVER_SET_FOR_DOCUMENTATION_ONLY
+/**
+ * Draw the random numbers of the proposals and acceptance tests from
+ * blocks that are filled in bulk, one set of blocks per chain.
+ *
+ * The blocks are filled by several interleaved xoshiro256+ generators
+ * (which the compiler can vectorise); normal numbers are made with the
+ * ziggurat method. Taking a number is an array read.
+ *
+ * The generators of each chain are seeded from the GSL generator, so
+ * GSL_RNG_SEED still applies, but the sequence differs from the one
+ * without this option.
+ */
+#define BLOCK_RANDOM
+#endif
+
+#ifndef RANDOM_BLOCK_SIZE
+/**
+ * number of values generated at once for each kind of random number
+ */
+#define RANDOM_BLOCK_SIZE 512
+#endif
+
+/** number of interleaved generators */
+#define RANDOM_LANES 4
+
+typedef struct {
+	/** xoshiro256+ state, one column per lane */
+	unsigned long state[4][RANDOM_LANES];
+	unsigned long raw[RANDOM_BLOCK_SIZE];
+	double normal[RANDOM_BLOCK_SIZE];
+	double uniform[RANDOM_BLOCK_SIZE];
+	double log_uniform[RANDOM_BLOCK_SIZE];
+	unsigned int next_raw;
+	unsigned int next_normal;
+	unsigned int next_uniform;
+	unsigned int next_log_uniform;
+} random_block;
+
+random_block * random_block_alloc(unsigned long seed);
+
+/**
+ * restarts the generators from the seed and discards the buffered numbers
+ */
+void random_block_seed(random_block * b, unsigned long seed);
+
+void random_block_free(random_block * b);
+
+/**
+ * refill the block and return its first value.
+ * Use the macros below instead.
+ */
+double random_block_fill_normal(random_block * b);
+double random_block_fill_uniform(random_block * b);
+double random_block_fill_log_uniform(random_block * b);
+
+/** standard normal distributed number */
+#define random_block_normal(b) ((b)->next_normal < RANDOM_BLOCK_SIZE ? \
+		(b)->normal[(b)->next_normal++] : random_block_fill_normal(b))
+
+/** uniformly distributed in [0, 1) */
+#define random_block_uniform(b) ((b)->next_uniform < RANDOM_BLOCK_SIZE ? \
+		(b)->uniform[(b)->next_uniform++] : random_block_fill_uniform(b))
+
+/** logarithm of a number uniformly distributed in (0, 1) */
+#define random_block_log_uniform(b) \
+		((b)->next_log_uniform < RANDOM_BLOCK_SIZE ? \
+		(b)->log_uniform[(b)->next_log_uniform++] : \
+		random_block_fill_log_uniform(b))
+
+#endif /* RANDOM_BLOCK_H_ */
@@ -0,0 +1,254 @@
+/*
+    APEMoST - Automated Parameter Estimation and Model Selection Toolkit
+    Copyright (C) 2009  Johannes Buchner
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <gsl/gsl_math.h>
+
+#include "tdigest.h"
+#include "input.h"
+
+static void * tdigest_allocate(const unsigned long size) {
+	void * p = malloc(size);
+	if (p == NULL) {
+		perror("could not allocate t-digest");
+		exit(1);
+	}
+	return p;
+}
+
+tdigest * tdigest_alloc(const double compression, const double gap) {
+	tdigest * t = (tdigest*) tdigest_allocate(sizeof(tdigest));
+	t->compression = compression;
+	t->gap = gap;
+	t->n = 0;
+	t->nbuffer = 0;
+	t->buffer_size = (unsigned long) (5 * compression) + 10;
+	/* the centroids are merged in place from the buffer */
+	t->centroids = NULL;
+	t->buffer = (tdigest_centroid*) tdigest_allocate(t->buffer_size
+			* sizeof(tdigest_centroid));
+	t->total_weight = 0;
+	return t;
+}
+
+void tdigest_free(tdigest * t) {
+	free(t->centroids);
+	free(t->buffer);
+	free(t);
+}
+
+static void add_centroid(tdigest * t, const tdigest_centroid * c) {
+	if (t->nbuffer == t->buffer_size)
+		tdigest_compress(t);
+	t->buffer[t->nbuffer++] = *c;
+	t->total_weight += c->weight;
+}
+
+void tdigest_add(tdigest * t, const double value) {
+	tdigest_centroid c;
+	c.mean = value;
+	c.weight = 1;
+	c.min = value;
+	c.max = value;
+	add_centroid(t, &c);
+}
+
+void tdigest_merge(tdigest * a, tdigest * b) {
+	unsigned long i;
+	tdigest_compress(b);
+	for (i = 0; i < b->n; i++)
+		add_centroid(a, &b->centroids[i]);
+}
+
+static int compare_centroids(const void * av, const void * bv) {
+	const tdigest_centroid * a = (const tdigest_centroid *) av;
+	const tdigest_centroid * b = (const tdigest_centroid *) bv;
+	if (a->mean < b->mean)
+		return -1;
+	if (a->mean > b->mean)
+		return 1;
+	return 0;
+}
+
+/** scale function k1, the size limit of the centroids */
+static double scale(const tdigest * t, double q) {
+	if (q > 1)
+		q = 1;
+	return t->compression / (2 * M_PI) * asin(2 * q - 1);
+}
+
+void tdigest_compress(tdigest * t) {
+	unsigned long n_all = t->n + t->nbuffer;
+	tdigest_centroid * all;
+	tdigest_centroid * current;
+	unsigned long i;
+	double q0 = 0;
+	double k0;
+
+	if (t->nbuffer == 0)
+		return;
+	all = (tdigest_centroid*) tdigest_allocate(n_all
+			* sizeof(tdigest_centroid));
+	if (t->n > 0)
+		memcpy(all, t->centroids, t->n * sizeof(tdigest_centroid));
+	memcpy(all + t->n, t->buffer, t->nbuffer * sizeof(tdigest_centroid));
+	qsort(all, n_all, sizeof(tdigest_centroid), compare_centroids);
+
+	/* merge neighbours as long as the size limit allows */
+	current = &all[0];
+	k0 = scale(t, 0);
+	for (i = 1; i < n_all; i++) {
+		if (scale(t, (q0 + current->weight + all[i].weight)
+				/ t->total_weight) - k0 <= 1 && (t->gap <= 0 || all[i].min
+				- current->max <= t->gap)) {
+			current->mean += (all[i].mean - current->mean) * all[i].weight
+					/ (current->weight + all[i].weight);
+			current->weight += all[i].weight;
+			if (all[i].min < current->min)
+				current->min = all[i].min;
+			if (all[i].max > current->max)
+				current->max = all[i].max;
+		} else {
+			q0 += current->weight;
+			k0 = scale(t, q0 / t->total_weight);
+			current++;
+			*current = all[i];
+		}
+	}
+	free(t->centroids);
+	t->n = current - all + 1;
+	t->centroids = (tdigest_centroid*) realloc(all, t->n
+			* sizeof(tdigest_centroid));
+	t->nbuffer = 0;
+}
+
+double tdigest_quantile_between(const tdigest * t, const unsigned long first,
+		const unsigned long last, const double q) {
+	const tdigest_centroid * c = &t->centroids[first];
+	const unsigned long n = last - first + 1;
+	double total = 0;
+	double target;
+	double center = 0;
+	double next_center;
+	unsigned long i;
+
+	for (i = 0; i < n; i++)
+		total += c[i].weight;
+	target = q * total;
+	if (n == 1)
+		return c[0].min + q * (c[0].max - c[0].min);
+	/* before the center of the first and after that of the last centroid,
+	 * interpolate towards the extreme values */
+	if (target < c[0].weight / 2)
+		return c[0].min + (c[0].mean - c[0].min) * target / (c[0].weight / 2);
+	if (target > total - c[n - 1].weight / 2)
+		return c[n - 1].mean + (c[n - 1].max - c[n - 1].mean) * (target
+				- total + c[n - 1].weight / 2) / (c[n - 1].weight / 2);
+	center = c[0].weight / 2;
+	for (i = 0; i + 1 < n; i++) {
+		next_center = center + (c[i].weight + c[i + 1].weight) / 2;
+		if (target <= next_center)
+			return c[i].mean + (c[i + 1].mean - c[i].mean) * (target - center)
+					/ (next_center - center);
+		center = next_center;
+	}
+	return c[n - 1].mean;
+}
+
+double tdigest_quantile(tdigest * t, const double q) {
+	tdigest_compress(t);
+	if (t->n == 0)
+		return 0;
+	return tdigest_quantile_between(t, 0, t->n - 1, q);
+}
+
+unsigned int tdigest_features(tdigest * t, double * medians,
+		double * leftquartiles, double * rightquartiles,
+		double * percentages, const unsigned int max_features) {
+	unsigned int nfeatures = 0;
+	unsigned long first = 0;
+	unsigned long last;
+	double weight;
+
+	tdigest_compress(t);
+	while (first < t->n && nfeatures < max_features) {
+		weight = t->centroids[first].weight;
+		for (last = first; last + 1 < t->n; last++) {
+			if (t->gap > 0 && t->centroids[last + 1].min
+					- t->centroids[last].max > t->gap)
+				break;
+			weight += t->centroids[last + 1].weight;
+		}
+		medians[nfeatures] = tdigest_quantile_between(t, first, last, 0.5);
+		leftquartiles[nfeatures] = tdigest_quantile_between(t, first, last,
+				0.25);
+		rightquartiles[nfeatures] = tdigest_quantile_between(t, first, last,
+				0.75);
+		percentages[nfeatures] = weight / t->total_weight;
+		nfeatures++;
+		first = last + 1;
+	}
+	return nfeatures;
+}
+
+typedef struct {
+	tdigest ** digests;
+	double min;
+	double max;
+} read_state;
+
+static void read_block(const double * values, unsigned long nrows,
+		unsigned int ncolumns, int thread, void * state) {
+	read_state * s = (read_state*) state;
+	unsigned long j;
+
+	for (j = 0; j < nrows * ncolumns; j++) {
+		if (values[j] >= s->min && values[j] <= s->max)
+			tdigest_add(s->digests[thread], values[j]);
+	}
+}
+
+tdigest * tdigest_read(const char * filename, const double min,
+		const double max, const double compression, const double gap) {
+	input_file * input;
+	read_state s;
+	int t;
+	const int n_threads = input_max_threads();
+	tdigest * result;
+
+	s.min = min;
+	s.max = max;
+	s.digests = (tdigest**) tdigest_allocate(n_threads * sizeof(tdigest*));
+	for (t = 0; t < n_threads; t++)
+		s.digests[t] = tdigest_alloc(compression, gap);
+
+	input = input_open(filename);
+	input_process(input, read_block, &s, 0);
+	input_close(input);
+
+	result = s.digests[0];
+	for (t = 1; t < n_threads; t++) {
+		tdigest_merge(result, s.digests[t]);
+		tdigest_free(s.digests[t]);
+	}
+	free(s.digests);
+	tdigest_compress(result);
+	return result;
+}
@@ -0,0 +1,113 @@
+/*
+    APEMoST - Automated Parameter Estimation and Model Selection Toolkit
+    Copyright (C) 2009  Johannes Buchner
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TDIGEST_H_
+#define TDIGEST_H_
+
+/**
+ * t-digest: a summary of a stream of values, from which quantiles can be
+ * read with a relative accuracy that is best in the tails.
+ *
+ * The values are clustered into centroids, whose size is limited by the
+ * compression parameter: about compression * pi / 2 centroids are kept,
+ * regardless of the number of values. Higher compression means more
+ * accuracy and memory.
+ *
+ * Additionally, centroids never span a gap wider than the given gap width,
+ * so features separated by such gaps are kept apart exactly.
+ */
+
+#ifndef TDIGEST_COMPRESSION
+/**
+ * default compression for the tools
+ */
+#define TDIGEST_COMPRESSION 500
+#endif
+
+typedef struct {
+	double mean;
+	double weight;
+	/** smallest value in the centroid */
+	double min;
+	/** largest value in the centroid */
+	double max;
+} tdigest_centroid;
+
+typedef struct {
+	double compression;
+	double gap;
+	/** sorted by mean after tdigest_compress() */
+	tdigest_centroid * centroids;
+	unsigned long n;
+	/** values added since the last compression */
+	tdigest_centroid * buffer;
+	unsigned long nbuffer;
+	unsigned long buffer_size;
+	double total_weight;
+} tdigest;
+
+/**
+ * @param gap do not merge values farther apart than this (0 to disable)
+ */
+tdigest * tdigest_alloc(const double compression, const double gap);
+
+void tdigest_free(tdigest * t);
+
+void tdigest_add(tdigest * t, const double value);
+
+/**
+ * adds all values summarized in b to a.
+ */
+void tdigest_merge(tdigest * a, tdigest * b);
+
+/**
+ * merges the added values into the centroids.
+ */
+void tdigest_compress(tdigest * t);
+
+/**
+ * @param q between 0 and 1
+ */
+double tdigest_quantile(tdigest * t, const double q);
+
+/**
+ * quantile among the values in the centroids first to last (inclusive),
+ * after tdigest_compress().
+ */
+double tdigest_quantile_between(const tdigest * t, const unsigned long first,
+		const unsigned long last, const double q);
+
+/**
+ * finds the features, separated by gaps of the gap width given to
+ * tdigest_alloc(), and measures their median, quartiles and share of all
+ * values.
+ *
+ * @return number of features, at most max_features
+ */
+unsigned int tdigest_features(tdigest * t, double * medians,
+		double * leftquartiles, double * rightquartiles,
+		double * percentages, const unsigned int max_features);
+
+/**
+ * summarizes the values of a file (see input.h) that lie between min and
+ * max. Uses all threads.
+ */
+tdigest * tdigest_read(const char * filename, const double min,
+		const double max, const double compression, const double gap);
+
+#endif /* TDIGEST_H_ */
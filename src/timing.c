@@ -0,0 +1,173 @@
+/*
+    APEMoST - Automated Parameter Estimation and Model Selection Toolkit
+    Copyright (C) 2009  Johannes Buchner
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _POSIX_C_SOURCE 199309L
+#include <stdlib.h>
+#include <time.h>
+#include <omp.h>
+
+#include "timing.h"
+
+#define CACHE_LINE 64
+
+static const char * phase_names[TIMING_N_PHASES] = { "proposal", "model",
+		"accept", "dump", "swap", "adapt" };
+
+/**
+ * counters of one chain. Padded, so that chains stepped by different
+ * threads do not share cache lines.
+ */
+typedef union {
+	struct {
+		unsigned long ticks[TIMING_N_PHASES];
+		unsigned long calls[TIMING_N_PHASES];
+		/** thread that last worked on the chain */
+		int thread;
+	} s;
+	char padding[2 * CACHE_LINE];
+} timing_slot;
+
+/** slot 0 is for work not done for a single chain; chain i uses slot i+1 */
+static timing_slot * slots = NULL;
+static void * slots_allocation = NULL;
+static unsigned int n_slots = 0;
+
+static int selected = 0;
+#pragma omp threadprivate(selected)
+
+static double ticks_per_second = 0;
+
+static unsigned long clock_gettime_now() {
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec * 1000000000UL + t.tv_nsec;
+}
+
+unsigned long timing_now() {
+#if defined(__x86_64__) && !defined(TIMING_CLOCK_GETTIME)
+	unsigned int lo;
+	unsigned int hi;
+	__asm__ __volatile__ ("rdtsc" : "=a" (lo), "=d" (hi));
+	return ((unsigned long) hi << 32) | lo;
+#else
+	return clock_gettime_now();
+#endif
+}
+
+double timing_ticks_per_second() {
+#if defined(__x86_64__) && !defined(TIMING_CLOCK_GETTIME)
+	unsigned long start;
+	unsigned long start_ns;
+	unsigned long now_ns;
+	if (ticks_per_second == 0) {
+		/* compare against the monotonic clock for 20ms */
+		start_ns = clock_gettime_now();
+		start = timing_now();
+		do {
+			now_ns = clock_gettime_now();
+		} while (now_ns - start_ns < 20000000UL);
+		ticks_per_second = (timing_now() - start) * 1e9 / (now_ns - start_ns);
+	}
+#else
+	ticks_per_second = 1e9;
+#endif
+	return ticks_per_second;
+}
+
+double timing_seconds(const unsigned long start, const unsigned long stop) {
+	return (stop - start) / timing_ticks_per_second();
+}
+
+void timing_init(const unsigned int n_chains) {
+	unsigned int i;
+	unsigned int j;
+
+	if (n_slots != n_chains + 1) {
+		free(slots_allocation);
+		n_slots = n_chains + 1;
+		slots_allocation = malloc(n_slots * sizeof(timing_slot) + CACHE_LINE);
+		if (slots_allocation == NULL) {
+			perror("could not allocate timing counters");
+			exit(1);
+		}
+		slots = (timing_slot*) ((char*) slots_allocation + CACHE_LINE
+				- (unsigned long) slots_allocation % CACHE_LINE);
+	}
+	for (i = 0; i < n_slots; i++) {
+		for (j = 0; j < TIMING_N_PHASES; j++) {
+			slots[i].s.ticks[j] = 0;
+			slots[i].s.calls[j] = 0;
+		}
+		slots[i].s.thread = 0;
+	}
+	/* calibrate now, not within a measurement */
+	timing_ticks_per_second();
+}
+
+void timing_select(const int chain) {
+	selected = chain + 1;
+}
+
+void timing_add(const unsigned int phase, const unsigned long ticks) {
+	if (selected < 0 || (unsigned int) selected >= n_slots)
+		return;
+	slots[selected].s.ticks[phase] += ticks;
+	slots[selected].s.calls[phase]++;
+	slots[selected].s.thread = omp_get_thread_num();
+}
+
+void timing_report(FILE * f) {
+	unsigned int i;
+	unsigned int j;
+	unsigned long ticks;
+	unsigned long calls;
+	double total;
+
+	if (n_slots == 0)
+		return;
+	fprintf(f, "time spent in each phase [s]\n");
+	fprintf(f, "%7s %7s", "chain", "thread");
+	for (j = 0; j < TIMING_N_PHASES; j++) {
+		fprintf(f, " %10s", phase_names[j]);
+	}
+	fprintf(f, " %10s\n", "total");
+	for (i = 0; i < n_slots; i++) {
+		total = 0;
+		if (i == 0)
+			fprintf(f, "%7s %7s", "all", "-");
+		else
+			fprintf(f, "%7d %7d", i - 1, slots[i].s.thread);
+		for (j = 0; j < TIMING_N_PHASES; j++) {
+			total += timing_seconds(0, slots[i].s.ticks[j]);
+			fprintf(f, " %10.3f", timing_seconds(0, slots[i].s.ticks[j]));
+		}
+		fprintf(f, " %10.3f\n", total);
+	}
+	fprintf(f, "%15s", "mean [us/call]");
+	for (j = 0; j < TIMING_N_PHASES; j++) {
+		ticks = 0;
+		calls = 0;
+		for (i = 0; i < n_slots; i++) {
+			ticks += slots[i].s.ticks[j];
+			calls += slots[i].s.calls[j];
+		}
+		fprintf(f, " %10.3f", calls == 0 ? 0 : 1e6 * timing_seconds(0, ticks)
+				/ calls);
+	}
+	fprintf(f, "\n");
+}
@@ -0,0 +1,112 @@
+/*
+    APEMoST - Automated Parameter Estimation and Model Selection Toolkit
+    Copyright (C) 2009  Johannes Buchner
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TIMING_H_
+#define TIMING_H_
+
+#include <stdio.h>
+
+#ifdef __NEVER_SET_FOR_DOCUMENTATION_ONLY
+/**
+ * Measure the wall-clock time spent in each phase of the sampler
+ * (proposal, model evaluation, accept/reject, dump, swap and adapt),
+ * separately for each chain.
+ *
+ * The table is printed when the program receives SIGUSR1, and written to
+ * #TIMING_FILE every #PRINT_PROB_INTERVAL iterations.
+ *
+ * The time stamp counter is used on x86-64, clock_gettime() otherwise.
+ * Each reading costs a few dozen cycles, so this is only noticeable for
+ * very fast models.
+ */
+#define PHASE_TIMING
+/**
+ * Use clock_gettime() even if the time stamp counter is available.
+ */
+#define TIMING_CLOCK_GETTIME
+#endif
+
+#ifndef TIMING_FILE
+/**
+ * File where the phase timing table is written to (see #PHASE_TIMING).
+ */
+#define TIMING_FILE "timing_summary"
+#endif
+
+#define TIMING_PROPOSAL 0
+#define TIMING_MODEL 1
+#define TIMING_ACCEPT 2
+#define TIMING_DUMP 3
+#define TIMING_SWAP 4
+#define TIMING_ADAPT 5
+#define TIMING_N_PHASES 6
+
+#ifdef PHASE_TIMING
+/** declares a time stamp variable (without semicolon) */
+#define TIMING_DECLARE(t) unsigned long t = 0;
+/** starts measuring */
+#define TIMING_START(t) do { (t) = timing_now(); } while (0)
+/** adds the time since t to the phase, and restarts measuring */
+#define TIMING_LAP(t, phase) do { unsigned long timing_lap_ = timing_now(); \
+	timing_add((phase), timing_lap_ - (t)); (t) = timing_lap_; } while (0)
+#else
+#define TIMING_DECLARE(t)
+#define TIMING_START(t) do { } while (0)
+#define TIMING_LAP(t, phase) do { } while (0)
+#endif
+
+/**
+ * current time in ticks.
+ */
+unsigned long timing_now();
+
+/**
+ * @return how many ticks timing_now() advances per second
+ */
+double timing_ticks_per_second();
+
+/**
+ * @return seconds between the two time stamps
+ */
+double timing_seconds(const unsigned long start, const unsigned long stop);
+
+/**
+ * prepares the counters for the given number of chains and resets them.
+ */
+void timing_init(const unsigned int n_chains);
+
+/**
+ * following measurements of the calling thread are accounted to the
+ * given chain. Use -1 for work that is not done for a single chain
+ * (e.g. swaps).
+ */
+void timing_select(const int chain);
+
+/**
+ * accounts time to a phase of the currently selected chain.
+ * Every chain is only stepped by one thread at a time, so no locking is
+ * needed.
+ */
+void timing_add(const unsigned int phase, const unsigned long ticks);
+
+/**
+ * writes the table of the time spent in each phase.
+ */
+void timing_report(FILE * f);
+
+#endif /* TIMING_H_ */
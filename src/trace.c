@@ -0,0 +1,143 @@
+/*
+    APEMoST - Automated Parameter Estimation and Model Selection Toolkit
+    Copyright (C) 2009  Johannes Buchner
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <omp.h>
+
+#include "trace.h"
+#include "utils.h"
+
+#ifndef TRACE_MAX_THREADS
+#define TRACE_MAX_THREADS 256
+#endif
+
+typedef struct {
+	const char * name;
+	const char * value_name;
+	unsigned long start;
+	unsigned long stop;
+	int chain;
+	double value;
+} trace_record;
+
+typedef struct {
+	/** number of events recorded so far, also those overwritten */
+	unsigned long count;
+	int thread;
+	trace_record records[TRACE_BUFFER_SIZE];
+} trace_buffer;
+
+static trace_buffer * buffers[TRACE_MAX_THREADS];
+static int n_buffers = 0;
+static unsigned long trace_start = 0;
+
+static trace_buffer * own_buffer = NULL;
+#pragma omp threadprivate(own_buffer)
+
+static void write_trace_file() {
+	FILE * f = job_fopen(TRACE_FILE, "w");
+	if (f == NULL) {
+		perror("could not write trace file");
+		return;
+	}
+	trace_write(f);
+	fclose(f);
+}
+
+static trace_buffer * register_buffer() {
+	trace_buffer * b = (trace_buffer*) malloc(sizeof(trace_buffer));
+	if (b == NULL) {
+		perror("could not allocate trace buffer");
+		exit(1);
+	}
+	b->count = 0;
+#pragma omp critical (trace_register)
+	{
+		if (n_buffers == 0) {
+			trace_start = timing_now();
+			timing_ticks_per_second();
+			atexit(write_trace_file);
+		}
+		if (n_buffers < TRACE_MAX_THREADS) {
+			b->thread = n_buffers;
+			buffers[n_buffers++] = b;
+		} else {
+			free(b);
+			b = NULL;
+		}
+	}
+	return b;
+}
+
+void trace_event(const char * name, const unsigned long start,
+		const unsigned long stop, const int chain, const char * value_name,
+		const double value) {
+	trace_record * r;
+	if (own_buffer == NULL) {
+		own_buffer = register_buffer();
+		if (own_buffer == NULL)
+			return;
+	}
+	r = &own_buffer->records[own_buffer->count % TRACE_BUFFER_SIZE];
+	r->name = name;
+	r->value_name = value_name;
+	r->start = start;
+	r->stop = stop;
+	r->chain = chain;
+	r->value = value;
+	own_buffer->count++;
+}
+
+/** microseconds since the trace started */
+static double trace_us(const unsigned long t) {
+	if (t < trace_start)
+		return 0;
+	return 1e6 * timing_seconds(trace_start, t);
+}
+
+void trace_write(FILE * f) {
+	int i;
+	unsigned long j;
+	unsigned long first;
+	const trace_record * r;
+	int separator = 0;
+
+	fprintf(f, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n");
+	for (i = 0; i < n_buffers; i++) {
+		fprintf(f, "%s{\"name\": \"thread_name\", \"ph\": \"M\", "
+			"\"pid\": 1, \"tid\": %d, \"args\": {\"name\": \"thread %d\"}}",
+				separator ? ",\n" : "", buffers[i]->thread,
+				buffers[i]->thread);
+		separator = 1;
+		first = 0;
+		if (buffers[i]->count > TRACE_BUFFER_SIZE)
+			first = buffers[i]->count - TRACE_BUFFER_SIZE;
+		for (j = first; j < buffers[i]->count; j++) {
+			r = &buffers[i]->records[j % TRACE_BUFFER_SIZE];
+			fprintf(f, ",\n{\"name\": \"%s\", \"cat\": \"apemost\", "
+				"\"ph\": \"X\", \"pid\": 1, \"tid\": %d, "
+				"\"ts\": %.3f, \"dur\": %.3f, \"args\": {\"chain\": %d",
+					r->name, buffers[i]->thread, trace_us(r->start),
+					trace_us(r->stop) - trace_us(r->start), r->chain);
+			if (r->value_name != NULL)
+				fprintf(f, ", \"%s\": %.6g", r->value_name, r->value);
+			fprintf(f, "}}");
+		}
+	}
+	fprintf(f, "\n]}\n");
+}
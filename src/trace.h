@@ -0,0 +1,93 @@
+/*
+    APEMoST - Automated Parameter Estimation and Model Selection Toolkit
+    Copyright (C) 2009  Johannes Buchner
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TRACE_H_
+#define TRACE_H_
+
+#include <stdio.h>
+#include "timing.h"
+
+#ifdef __NEVER_SET_FOR_DOCUMENTATION_ONLY
+/**
+ * Record a timeline of what each thread is doing and write it to
+ * #TRACE_FILE when the program ends.
+ *
+ * The file uses the Chrome trace event format, and can be opened with
+ * chrome://tracing or https://ui.perfetto.dev . It shows the blocks of
+ * steps of each chain, swaps, adapting, flushing the dump files and the
+ * iterations of the calibration. Gaps between the blocks are time the
+ * thread spent waiting for the other threads.
+ *
+ * Each thread records into its own ring buffer, so only the last
+ * #TRACE_BUFFER_SIZE events per thread are kept.
+ */
+#define TRACE
+#endif
+
+#ifndef TRACE_FILE
+/**
+ * File the timeline is written to (see #TRACE). Every program phase
+ * (calibrate_first, run, ...) overwrites it.
+ */
+#define TRACE_FILE "trace.json"
+#endif
+
+#ifndef TRACE_BUFFER_SIZE
+/**
+ * Number of events kept per thread (see #TRACE).
+ */
+#define TRACE_BUFFER_SIZE 100000
+#endif
+
+#ifdef TRACE
+/** declares a time stamp variable (without semicolon) */
+#define TRACE_DECLARE(t) unsigned long t = 0;
+/** starts an event */
+#define TRACE_START(t) do { (t) = timing_now(); } while (0)
+/**
+ * records an event from t until now.
+ * The chain may be -1, value_name NULL if there is nothing to annotate.
+ */
+#define TRACE_EVENT(t, name, chain, value_name, value) \
+	trace_event((name), (t), timing_now(), (chain), (value_name), (value))
+#else
+#define TRACE_DECLARE(t)
+#define TRACE_START(t) do { } while (0)
+#define TRACE_EVENT(t, name, chain, value_name, value) do { } while (0)
+#endif
+
+/**
+ * stores an event in the ring buffer of the calling thread.
+ *
+ * The name and value_name have to be constant strings, only the pointers
+ * are kept. The trace is written to #TRACE_FILE on exit.
+ *
+ * @param start time stamp of timing_now()
+ * @param stop time stamp of timing_now()
+ */
+void trace_event(const char * name, const unsigned long start,
+		const unsigned long stop, const int chain, const char * value_name,
+		const double value);
+
+/**
+ * writes the recorded events of all threads in the Chrome trace event
+ * format.
+ */
+void trace_write(FILE * f);
+
+#endif /* TRACE_H_ */
@@ -18,9 +18,39 @@
 
 #include "utils.h"
 #include <ctype.h>
+#include <string.h>
+
+static const char * job_directory = NULL;
+#pragma omp threadprivate(job_directory)
+
+void set_job_directory(const char * directory) {
+	job_directory = directory;
+}
+
+const char * get_job_directory() {
+	return job_directory;
+}
+
+char * job_path(char * buf, const char * filename) {
+	if (job_directory == NULL || filename[0] == '/') {
+		strncpy(buf, filename, FILENAME_MAX - 1);
+	} else {
+		strncpy(buf, job_directory, FILENAME_MAX - 1);
+		buf[FILENAME_MAX - 1] = 0;
+		strncat(buf, "/", FILENAME_MAX - 1 - strlen(buf));
+		strncat(buf, filename, FILENAME_MAX - 1 - strlen(buf));
+	}
+	buf[FILENAME_MAX - 1] = 0;
+	return buf;
+}
+
+FILE * job_fopen(const char * filename, const char * mode) {
+	char path[FILENAME_MAX];
+	return fopen(job_path(path, filename), mode);
+}
 
 FILE * openfile(const char * filename) {
-	FILE * input = fopen(filename, "r");
+	FILE * input = job_fopen(filename, "r");
 	if (input == NULL) {
 		fprintf(stderr, "error opening file %s\n", filename);
 		perror("file could not be opened");
@@ -29,7 +29,34 @@
 #endif
 
 /**
- * open the file or die
+ * Sets the directory relative file names are looked up in, for the calling
+ * thread. NULL means the working directory.
+ *
+ * This allows running independent jobs in different threads.
+ */
+void set_job_directory(const char * directory);
+
+/**
+ * @return the job directory of the calling thread, NULL for the working
+ * directory
+ */
+const char * get_job_directory();
+
+/**
+ * writes the path of filename in the job directory of the calling thread
+ * into buf (FILENAME_MAX chars).
+ *
+ * @return buf
+ */
+char * job_path(char * buf, const char * filename);
+
+/**
+ * fopen in the job directory
+ */
+FILE * job_fopen(const char * filename, const char * mode);
+
+/**
+ * open the file (in the job directory) or die
  */
 FILE * openfile(const char * filename);
 
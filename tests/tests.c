@@ -10,6 +10,10 @@
 #include "debug.h"
 #include "gsl_helper.h"
 #include "histogram.h"
+#include "input.h"
+#include "tdigest.h"
+#include "format_double.h"
+#include "random_block.h"
 
 #define DUMPONFAIL 1
 
@@ -47,6 +51,21 @@
 			return 1; \
 		} \
 	}
+/*
+ * with N_PARAMETERS, only chains of that many parameters can be allocated;
+ * tests that need another number are skipped
+ */
+#ifdef N_PARAMETERS
+#define NEEDS_PARAMETERS(n) { \
+		if((n) != N_PARAMETERS) { \
+			printf("  skipped: needs %d parameters\n", n); \
+			return 0; \
+		} \
+	}
+#else
+#define NEEDS_PARAMETERS(n)
+#endif
+
 int count_tests();
 
 /* example test function. return value is 0 iff succeeded.*/
@@ -77,6 +96,7 @@ int test_hist(void) {
 
 int test_create(void) {
 	mcmc * m;
+	NEEDS_PARAMETERS(3);
 	debug("test-create");
 	m = mcmc_init(3);
 	ASSERTEQUALI(m->n_par, 3, "number of parameters");
@@ -87,9 +107,13 @@ int test_create(void) {
 }
 
 int test_load(void) {
-	mcmc * m = mcmc_load("tests/testinput1", "tests/testlc.dat");
-	gsl_vector_const_view x_data = gsl_matrix_const_column(m->data, 0);
-	gsl_vector_const_view y_data = gsl_matrix_const_column(m->data, 1);
+	mcmc * m;
+	gsl_vector_const_view x_data;
+	gsl_vector_const_view y_data;
+	NEEDS_PARAMETERS(3);
+	m = mcmc_load("tests/testinput1", "tests/testlc.dat");
+	x_data = gsl_matrix_const_column(m->data, 0);
+	y_data = gsl_matrix_const_column(m->data, 1);
 	ASSERT(m != NULL, "loaded");
 	ASSERTEQUALI(m->n_par, 3, "number of parameters");
 	ASSERTEQUALD(gsl_vector_get(m->params, 0), 0.7, "start");
@@ -121,8 +145,10 @@ int test_load(void) {
 }
 
 int test_append(void) {
-	mcmc * m = mcmc_init(3);
+	mcmc * m;
 	int i;
+	NEEDS_PARAMETERS(3);
+	m = mcmc_init(3);
 	for (i = 0; i < 10; i++) {
 		mcmc_append_current_parameters(m);
 		ASSERTEQUALI(i + 1, (int)m->n_iter, "number of iterations");
@@ -132,9 +158,11 @@ int test_append(void) {
 }
 
 int test_random(void) {
-	mcmc * m = mcmc_load("tests/testinput1", "tests/testlc.dat");
+	mcmc * m;
 	double v = 0, last_v;
 	int i;
+	NEEDS_PARAMETERS(3);
+	m = mcmc_load("tests/testinput1", "tests/testlc.dat");
 	for (i = 0; i < 10; i++) {
 		last_v = v;
 		v = get_next_uniform_random(m);
@@ -160,8 +188,11 @@ int test_mod(void) {
 }
 
 int test_write(void) {
-	mcmc * m = mcmc_load("tests/testinput1", "tests/testlc.dat");
-	gsl_vector_const_view y_data = gsl_matrix_const_column(m->data, 1);
+	mcmc * m;
+	gsl_vector_const_view y_data;
+	NEEDS_PARAMETERS(3);
+	m = mcmc_load("tests/testinput1", "tests/testlc.dat");
+	y_data = gsl_matrix_const_column(m->data, 1);
 	debug("lets cheat and say we got the y-data as model");
 	mcmc_dump_y_dat(m, &y_data.vector, "model.dump");
 	m = mcmc_free(m);
@@ -169,7 +200,9 @@ int test_write(void) {
 }
 
 int test_write_prob(void) {
-	mcmc * m = mcmc_load("tests/testinput1", "tests/testlc.dat");
+	mcmc * m;
+	NEEDS_PARAMETERS(3);
+	m = mcmc_load("tests/testinput1", "tests/testlc.dat");
 	mcmc_open_dump_files(m, "", 0, "w");
 	debug("add starting points, ...");
 	mcmc_append_current_parameters(m);
@@ -192,6 +225,338 @@ int test_write_prob(void) {
 	return 0;
 }
 
+int test_input(void) {
+	const char * numbers[] = { "0", "-0.5", "3.14159", "1e-5", "2.5E+10",
+			"0.1234567890123456789", "1e300", "-4.94065645841247e-324",
+			"nan", "12345678901234567", NULL };
+	const char * stop;
+	int i;
+	FILE * f;
+	gsl_vector * min = gsl_vector_alloc(2);
+	gsl_vector * max = gsl_vector_alloc(2);
+
+	for (i = 0; numbers[i] != NULL; i++) {
+		double v = input_parse_double(numbers[i], numbers[i] + strlen(
+				numbers[i]), &stop);
+		double expected = strtod(numbers[i], NULL);
+		ASSERT(*stop == 0, numbers[i]);
+		ASSERT(v == expected || (v != v && expected != expected), numbers[i]);
+	}
+	f = fopen("input-test.dump", "w");
+	ASSERT(f != NULL, "write file");
+	fprintf(f, "# comment\n1.5\t-2\n\n-3, 4e1\n0 2");
+	fclose(f);
+	ASSERTEQUALI((int)input_column_count("input-test.dump"), 2, "columns");
+	find_min_max("input-test.dump", min, max);
+	ASSERTEQUALD(gsl_vector_get(min, 0), -3.0, "min");
+	ASSERTEQUALD(gsl_vector_get(max, 0), 1.5, "max");
+	ASSERTEQUALD(gsl_vector_get(min, 1), -2.0, "min");
+	ASSERTEQUALD(gsl_vector_get(max, 1), 40.0, "max");
+
+	f = fopen("input-test.dump", "wb");
+	ASSERT(f != NULL, "write file");
+	input_write_binary_header(f, 2);
+	fwrite(max->data, sizeof(double), 2, f);
+	fwrite(min->data, sizeof(double), 2, f);
+	fclose(f);
+	find_min_max("input-test.dump", max, min);
+	ASSERTEQUALD(gsl_vector_get(max, 0), -3.0, "binary min");
+	ASSERTEQUALD(gsl_vector_get(min, 1), 40.0, "binary max");
+	remove("input-test.dump");
+	gsl_vector_free(min);
+	gsl_vector_free(max);
+	return 0;
+}
+
+int test_tdigest(void) {
+	tdigest * t = tdigest_alloc(100, 10);
+	double medians[3];
+	double leftquartiles[3];
+	double rightquartiles[3];
+	double percentages[3];
+	int i;
+
+	for (i = 0; i < 30000; i++) {
+		tdigest_add(t, (i * 7919) % 10000);
+		if (i % 3 == 0)
+			tdigest_add(t, 100000 + i % 1000);
+	}
+	ASSERT(t->n < 400, "bounded size");
+	ASSERTEQUALD(tdigest_quantile(t, 0.25), 3333.0, "quartile");
+	ASSERTEQUALI((int)tdigest_features(t, medians, leftquartiles,
+			rightquartiles, percentages, 3), 2, "features");
+	ASSERTEQUALD(medians[0], 5000.0, "median");
+	ASSERTEQUALD(leftquartiles[0], 2500.0, "left quartile");
+	ASSERTEQUALD(rightquartiles[0], 7500.0, "right quartile");
+	ASSERTEQUALD(percentages[0], 0.75, "share");
+	ASSERTEQUALD(medians[1], 100500.0, "median");
+	tdigest_free(t);
+	return 0;
+}
+
+int test_format_double(void) {
+	const double numbers[] = { 0.1, 0.3, 1, -2.5, 1e-5, 1e15, 1e16, 5e-324,
+			2.2250738585072014e-308, 1.7976931348623157e308, 123456789012.125 };
+	char buf[FORMAT_DOUBLE_SIZE];
+	unsigned int i;
+	double v;
+
+	for (i = 0; i < sizeof(numbers) / sizeof(double); i++) {
+		format_double(buf, numbers[i]);
+		ASSERT(strtod(buf, NULL) == numbers[i], buf);
+	}
+	format_double(buf, 0.1);
+	ASSERT(strcmp(buf, "0.1") == 0, "shortest");
+	format_double(buf, 1.5e-7);
+	ASSERT(strcmp(buf, "1.5e-7") == 0, "exponent");
+	for (i = 0; i < 100000; i++) {
+		v = (rand() / (RAND_MAX + 1.0) - 0.5) * pow(10, rand() % 600 - 300);
+		format_double(buf, v);
+		if (strtod(buf, NULL) != v) {
+			ASSERT(0, buf);
+		}
+	}
+	ASSERT(1, "random numbers");
+	return 0;
+}
+
+int test_random_block(void) {
+	random_block * a = random_block_alloc(1);
+	random_block * b = random_block_alloc(1);
+	double sum = 0;
+	double sumsq = 0;
+	double v;
+	int i;
+	int different = 0;
+	int outside = 0;
+	const int n = 100000;
+
+	for (i = 0; i < n; i++) {
+		v = random_block_normal(a);
+		sum += v;
+		sumsq += v * v;
+		if (v != random_block_normal(b))
+			different++;
+	}
+	ASSERTEQUALI(different, 0, "same seed, same numbers");
+	ASSERT(fabs(sum / n) < 0.02, "normal mean");
+	ASSERT(fabs(sumsq / n - 1) < 0.02, "normal variance");
+	sum = 0;
+	for (i = 0; i < n; i++) {
+		v = random_block_uniform(a);
+		if (v < 0 || v >= 1)
+			outside++;
+		sum += v;
+	}
+	ASSERT(fabs(sum / n - 0.5) < 0.01, "uniform mean");
+	sum = 0;
+	for (i = 0; i < n; i++) {
+		v = random_block_log_uniform(a);
+		if (v >= 0)
+			outside++;
+		sum += v;
+	}
+	ASSERTEQUALI(outside, 0, "range");
+	ASSERT(fabs(sum / n + 1) < 0.02, "log uniform mean");
+	random_block_seed(a, 2);
+	ASSERT(random_block_uniform(a) != random_block_uniform(b), "reseeded");
+	random_block_free(a);
+	random_block_free(b);
+	return 0;
+}
+
+int test_boundary(void) {
+	mcmc * m;
+	FILE * f;
+	int i;
+	unsigned int j;
+	unsigned int outside = 0;
+
+	NEEDS_PARAMETERS(4);
+	f = fopen("boundary-test.dump", "w");
+	ASSERT(f != NULL, "write file");
+	fprintf(f, "0.9\t0\t1\tA\t0.5\treflect\n");
+	fprintf(f, "0.1\t0\t6.2\tB\t2\tcircular\n");
+	fprintf(f, "1e-3\t0\t1e-2\tC\t0.1\tlogit\n");
+	fprintf(f, "3\t2\t4\tD\t0.5\n");
+	fclose(f);
+	m = mcmc_load("boundary-test.dump", "tests/testlc.dat");
+	remove("boundary-test.dump");
+	ASSERTEQUALI(m->n_par, 4, "number of parameters");
+	ASSERTEQUALI((int)get_params_boundary_for(m, 0), BOUNDARY_REFLECT, "reflect");
+	ASSERTEQUALI((int)get_params_boundary_for(m, 1), BOUNDARY_CIRCULAR, "circular");
+	ASSERTEQUALI((int)get_params_boundary_for(m, 2), BOUNDARY_LOGIT, "logit");
+	ASSERTEQUALI((int)get_params_boundary_for(m, 3), BOUNDARY_REDRAW, "default");
+
+	for (i = 0; i < 10000; i++) {
+		markov_chain_step(m);
+		for (j = 0; j < get_n_par(m); j++) {
+			if (get_params_for(m, j) < get_params_min_for(m, j)
+					|| get_params_for(m, j) > get_params_max_for(m, j))
+				outside++;
+		}
+	}
+	ASSERTEQUALI((int)outside, 0, "within borders");
+	m = mcmc_free(m);
+	return 0;
+}
+
+int test_boundary_flat(void) {
+	mcmc * m;
+	FILE * f;
+	int i;
+	unsigned int j;
+	double sum[3] = { 0, 0, 0 };
+	double sumsq[3] = { 0, 0, 0 };
+	double v;
+	double width;
+	double mean;
+	const int n = 200000;
+
+	NEEDS_PARAMETERS(3);
+	f = fopen("boundary-test.dump", "w");
+	ASSERT(f != NULL, "write file");
+	fprintf(f, "0.9\t0\t1\tA\t0.3\treflect\n");
+	fprintf(f, "5.9\t2\t6\tB\t1.2\tlogit\n");
+	fprintf(f, "0.1\t-1\t1\tC\t0.6\tcircular\n");
+	fclose(f);
+	m = mcmc_load("boundary-test.dump", "tests/testlc.dat");
+	remove("boundary-test.dump");
+
+	debug("the test model is flat, so each parameter has to fill its range");
+	for (i = 0; i < n; i++) {
+		markov_chain_step(m);
+		for (j = 0; j < 3; j++) {
+			v = get_params_for(m, j);
+			sum[j] += v;
+			sumsq[j] += v * v;
+		}
+	}
+	for (j = 0; j < 3; j++) {
+		width = get_params_max_for(m, j) - get_params_min_for(m, j);
+		mean = sum[j] / n;
+		ASSERT(fabs(mean - (get_params_min_for(m, j) + get_params_max_for(m, j))
+				/ 2) < 0.02 * width, m->params_descr[j]);
+		ASSERT(fabs((sumsq[j] / n - mean * mean) / (width * width / 12) - 1)
+				< 0.05, m->params_descr[j]);
+	}
+	m = mcmc_free(m);
+	return 0;
+}
+
+/**
+ * @return the walker at the position of the chain, or the number of walkers
+ */
+static unsigned int reported_walker(const mcmc * m, gsl_vector * x) {
+	unsigned int w;
+	for (w = 0; w < m->ensemble->size1; w++) {
+		gsl_matrix_get_row(x, m->ensemble, w);
+		gsl_vector_sub(x, get_params(m));
+		if (gsl_vector_isnull(x))
+			break;
+	}
+	return w;
+}
+
+int test_ensemble(void) {
+	mcmc * m;
+	gsl_vector * x;
+	unsigned int outside = 0;
+	unsigned int i;
+	unsigned int j;
+	unsigned int w;
+	unsigned int previous;
+
+	NEEDS_PARAMETERS(3);
+	m = mcmc_load("tests/testinput1", "tests/testlc.dat");
+	x = gsl_vector_alloc(3);
+
+	for (i = 0; i < 100; i++) {
+		markov_chain_ensemble_step(m);
+		for (w = 0; w < m->ensemble->size1; w++) {
+			for (j = 0; j < 3; j++) {
+				if (gsl_matrix_get(m->ensemble, w, j) < get_params_min_for(m, j)
+						|| gsl_matrix_get(m->ensemble, w, j)
+								> get_params_max_for(m, j))
+					outside++;
+			}
+		}
+	}
+	ASSERTEQUALI((int)m->ensemble->size1, 8, "number of walkers");
+	ASSERTEQUALI((int)outside, 0, "within borders");
+	ASSERTEQUALI((int)(get_params_accepts_sum(m) + get_params_rejects_sum(m)),
+			3 * 100 * 8, "every walker moved");
+	/* without dumping, as the library does */
+	previous = reported_walker(m, x);
+	for (i = 0; i < 3; i++) {
+		markov_chain_ensemble_step(m);
+		w = reported_walker(m, x);
+		ASSERT(w < m->ensemble->size1 && w != previous,
+				"reports walker in turn");
+		previous = w;
+	}
+	gsl_vector_free(x);
+	m = mcmc_free(m);
+	return 0;
+}
+
+int test_parameter_storage(void) {
+	mcmc * m;
+	mcmc * c;
+	gsl_vector * v;
+	unsigned int i;
+
+	NEEDS_PARAMETERS(3);
+	m = mcmc_load("tests/testinput1", "tests/testlc.dat");
+#ifdef N_PARAMETERS
+	ASSERT(get_params(m)->data == m->values.params, "params in the struct");
+	ASSERT(get_params_best(m)->data == m->values.params_best, "best in the struct");
+	ASSERT(get_steps(m)->data == m->values.params_step, "steps in the struct");
+	ASSERT(m->params_min->data == m->values.params_min, "min in the struct");
+	ASSERT(m->params_max->data == m->values.params_max, "max in the struct");
+#endif
+	ASSERTEQUALI((int)get_params(m)->size, 3, "view size");
+	ASSERTEQUALI((int)get_params(m)->stride, 1, "view stride");
+
+	v = gsl_vector_alloc(3);
+	for (i = 0; i < 3; i++)
+		gsl_vector_set(v, i, 1.5 + i);
+	set_params(m, v);
+	ASSERTEQUALD(get_params_for(m, 0), 1.5, "set_params");
+	ASSERTEQUALD(get_params_for(m, 2), 3.5, "set_params");
+#ifdef N_PARAMETERS
+	ASSERTEQUALD(m->values.params[1], 2.5, "set_params stores inline");
+#endif
+
+	c = mcmc_clone(m);
+	ASSERT(get_params(c)->data != get_params(m)->data, "clone has own storage");
+#ifdef N_PARAMETERS
+	ASSERT(get_params(c)->data == c->values.params, "clone views its struct");
+	ASSERT(c->params_max->data == c->values.params_max, "clone views its struct");
+#endif
+	for (i = 0; i < 3; i++) {
+		ASSERTEQUALD(get_params_for(c, i), get_params_for(m, i), "clone params");
+		ASSERTEQUALD(get_params_min_for(c, i), get_params_min_for(m, i), "clone min");
+		ASSERTEQUALD(get_params_max_for(c, i), get_params_max_for(m, i), "clone max");
+	}
+
+	set_params_for(c, 0.5, 0);
+	gsl_vector_swap(get_params(m), get_params(c));
+	ASSERTEQUALD(get_params_for(m, 0), 0.5, "swapped");
+	ASSERTEQUALD(get_params_for(c, 0), 1.5, "swapped");
+	ASSERTEQUALD(get_params_for(c, 2), 3.5, "swapped");
+#ifdef N_PARAMETERS
+	ASSERTEQUALD(m->values.params[0], 0.5, "swapped inline");
+	ASSERT(get_params(m)->data == m->values.params, "views kept");
+#endif
+	/* the data and the generator belong to m */
+	set_data(c, NULL);
+	set_random(c, NULL);
+	c = mcmc_free(c);
+	m = mcmc_free(m);
+	return 0;
+}
+
 void calc_prob(mcmc * m) {
 	(void) m;
 }
@@ -209,7 +574,9 @@ void calc_model_for(mcmc * m, const unsigned int index, const double old_value)
 int (*tests_registration[])(void) = {
 /* this is test 1 *//*test_tests, */
 test_hist, test_create, test_load, test_append, test_random, test_mod,
-		test_write, test_write_prob,
+		test_write, test_write_prob, test_input,
+		test_tdigest, test_format_double, test_random_block, test_boundary,
+		test_boundary_flat, test_ensemble, test_parameter_storage,
 
 		/* register more tests before here */
 		NULL, };
@@ -12,6 +12,7 @@
 #include "debug.h"
 #include "histogram.h"
 #include "utils.h"
+#include "input.h"
 
 void usage(char * progname) {
 	fprintf(
@@ -20,7 +21,7 @@ void usage(char * progname) {
 				"\n"
 				"\tnbins\tNumber of bins to use\n"
 				"\tfiles\tfiles to include. these should contain float values "
-				"in one or more columns\n"
+				"in one or more columns (text or binary)\n"
 				"\n"
 				"This program calculates a histogram from datafiles.\n",
 			progname);
@@ -59,7 +60,7 @@ void run(unsigned int nbins, char ** filenames, unsigned int filecount) {
 	unsigned int ncolumns;
 
 	debug("looking for number of columns ...");
-	ncolumns = get_column_count(filenames[0]);
+	ncolumns = input_column_count(filenames[0]);
 	dump_i("number of columns", ncolumns);
 	min = gsl_vector_alloc(ncolumns);
 	max = gsl_vector_alloc(ncolumns);
@@ -69,9 +70,9 @@ void run(unsigned int nbins, char ** filenames, unsigned int filecount) {
 	dump_s("in file", filenames[0]);
 	find_min_max(filenames[0], min, max);
 	for (i = 1; i < filecount; i++) {
-		if (ncolumns != get_column_count(filenames[i])) {
+		if (ncolumns != input_column_count(filenames[i])) {
 			fprintf(stderr, "number of columns different in file %s: %i vs %i in %s\n",
-					filenames[i], ncolumns, get_column_count(filenames[i]),
+					filenames[i], ncolumns, input_column_count(filenames[i]),
 					filenames[0]);
 			exit(1);
 		}
@@ -30,11 +30,47 @@
 #include <string.h>
 #include <ctype.h>
 
+#include "input.h"
+
 #define SEP '\t'
 #define OUTPUTFORMAT "%e\t"
 
 char * outputformat = "%e\t";
 
+/** write doubles instead of text, see input.h */
+int binary_output = 0;
+/** the first row is kept until its length is known for the binary header */
+double * first_row = NULL;
+unsigned int first_row_length = 0;
+int header_written = 0;
+
+void output(double v) {
+	if (!binary_output) {
+		printf(outputformat, v);
+	} else if (header_written) {
+		fwrite(&v, sizeof(double), 1, stdout);
+	} else {
+		first_row = (double*) realloc(first_row, (first_row_length + 1)
+				* sizeof(double));
+		if (first_row == NULL) {
+			perror("could not allocate buffer");
+			exit(-1);
+		}
+		first_row[first_row_length++] = v;
+	}
+}
+
+void end_row() {
+	if (!binary_output) {
+		printf("\n");
+	} else if (!header_written) {
+		input_write_binary_header(stdout, first_row_length);
+		fwrite(first_row, sizeof(double), first_row_length, stdout);
+		free(first_row);
+		header_written = 1;
+	}
+}
+
 #ifdef DEBUG
 #define IFDEBUG if(1)
 #else
@@ -42,11 +78,12 @@ char * outputformat = "%e\t";
 #endif
 
 void usage(char * progname) {
-	printf("%s: SYNOPSIS: <command>\n"
+	printf("%s: SYNOPSIS: [-f <format>] [-b] <command>\n"
 		"\n"
 		"matrix_man allows manipulation of double values tables\n"
 		"It reads csv or tab-seperated values (double) from stdin,\n"
 		"performs the commands and prints the result to stdout.\n"
+		"The input may also be in the binary format, -b writes it.\n"
 		"\ncurrently supported commands\n", progname);
 	printf(""
 		"\trm <i>           remove column i\n"
@@ -179,45 +216,41 @@ void command_rm(int count, gsl_vector * current, char * qualification) {
 	int i;
 	for (i = 0; i < count; i++) {
 		if (!qualifies(i, qualification))
-			printf(outputformat, gsl_vector_get(current, i));
+			output(gsl_vector_get(current, i));
 	}
-	printf("\n");
-	fflush(stdout);
+	end_row();
 }
 void command_inva(int count, gsl_vector * current, char * qualification) {
 	int i;
 	for (i = 0; i < count; i++) {
 		if (qualifies(i, qualification))
-			printf(outputformat, -gsl_vector_get(current, i));
+			output(-gsl_vector_get(current, i));
 		else
-			printf(outputformat, gsl_vector_get(current, i));
+			output(gsl_vector_get(current, i));
 	}
-	printf("\n");
-	fflush(stdout);
+	end_row();
 }
 void command_invm(int count, gsl_vector * current, char * qualification) {
 	int i;
 	for (i = 0; i < count; i++) {
 		if (qualifies(i, qualification))
-			printf(outputformat, 1.0 / gsl_vector_get(current, i));
+			output(1.0 / gsl_vector_get(current, i));
 		else
-			printf(outputformat, gsl_vector_get(current, i));
+			output(gsl_vector_get(current, i));
 	}
-	printf("\n");
-	fflush(stdout);
+	end_row();
 }
 void command_diff(int count, gsl_vector * prev, gsl_vector * current,
 		char * qualification) {
 	int i;
 	for (i = 0; i < count; i++) {
 		if (qualifies(i, qualification))
-			printf(outputformat, gsl_vector_get(current, i) - gsl_vector_get(
+			output(gsl_vector_get(current, i) - gsl_vector_get(
 					prev, i));
 		else
-			printf(outputformat, gsl_vector_get(current, i));
+			output(gsl_vector_get(current, i));
 	}
-	printf("\n");
-	fflush(stdout);
+	end_row();
 }
 
 void command_new(int count, gsl_vector * current, char * qualification) {
@@ -225,18 +258,17 @@ void command_new(int count, gsl_vector * current, char * qualification) {
 	int i;
 	for (i = 0; i < count; i++) {
 		if (qualifies(i + offset, qualification)) {
-			printf(outputformat, 0.0);
+			output(0.0);
 			offset++;
 			i--;
 		} else {
-			printf(outputformat, gsl_vector_get(current, i));
+			output(gsl_vector_get(current, i));
 		}
 	}
 	if (qualifies(i, qualification))
-		printf(outputformat, 0.0);
+		output(0.0);
 
-	printf("\n");
-	fflush(stdout);
+	end_row();
 }
 void command_add(int count, gsl_vector * current, char * qualification_source,
 		char * qualification_target) {
@@ -261,13 +293,12 @@ void command_add(int count, gsl_vector * current, char * qualification_source,
 	}
 	for (i = 0; i < count; i++) {
 		if (i == target)
-			printf(outputformat, gsl_vector_get(current, i) + gsl_vector_get(
+			output(gsl_vector_get(current, i) + gsl_vector_get(
 					current, source));
 		else
-			printf(outputformat, gsl_vector_get(current, i));
+			output(gsl_vector_get(current, i));
 	}
-	printf("\n");
-	fflush(stdout);
+	end_row();
 }
 void command_add_rel(int count, gsl_vector * current,
 		char * qualification_source, char * offset_str) {
@@ -275,14 +306,13 @@ void command_add_rel(int count, gsl_vector * current,
 	int offset = atoi(offset_str);
 	for (i = 0; i < count; i++) {
 		if (qualifies(i, qualification_source)) {
-			printf(outputformat, gsl_vector_get(current, i) + gsl_vector_get(
+			output(gsl_vector_get(current, i) + gsl_vector_get(
 					current, i + offset));
 		} else {
-			printf(outputformat, gsl_vector_get(current, i));
+			output(gsl_vector_get(current, i));
 		}
 	}
-	printf("\n");
-	fflush(stdout);
+	end_row();
 }
 
 void command_addc(int count, gsl_vector * current, char * qualification_source,
@@ -292,13 +322,12 @@ void command_addc(int count, gsl_vector * current, char * qualification_source,
 	sscanf(value_str, "%lf", &value);
 	for (i = 0; i < count; i++) {
 		if (qualifies(i, qualification_source)) {
-			printf(outputformat, gsl_vector_get(current, i) + value);
+			output(gsl_vector_get(current, i) + value);
 		} else {
-			printf(outputformat, gsl_vector_get(current, i));
+			output(gsl_vector_get(current, i));
 		}
 	}
-	printf("\n");
-	fflush(stdout);
+	end_row();
 }
 void command_mul(int count, gsl_vector * current, char * qualification_source,
 		char * qualification_target) {
@@ -323,13 +352,12 @@ void command_mul(int count, gsl_vector * current, char * qualification_source,
 	}
 	for (i = 0; i < count; i++) {
 		if (i == target)
-			printf(outputformat, gsl_vector_get(current, i) * gsl_vector_get(
+			output(gsl_vector_get(current, i) * gsl_vector_get(
 					current, source));
 		else
-			printf(outputformat, gsl_vector_get(current, i));
+			output(gsl_vector_get(current, i));
 	}
-	printf("\n");
-	fflush(stdout);
+	end_row();
 }
 void command_mul_rel(int count, gsl_vector * current,
 		char * qualification_source, char * offset_str) {
@@ -337,14 +365,13 @@ void command_mul_rel(int count, gsl_vector * current,
 	int offset = atoi(offset_str);
 	for (i = 0; i < count; i++) {
 		if (qualifies(i, qualification_source)) {
-			printf(outputformat, gsl_vector_get(current, i) * gsl_vector_get(
+			output(gsl_vector_get(current, i) * gsl_vector_get(
 					current, i + offset));
 		} else {
-			printf(outputformat, gsl_vector_get(current, i));
+			output(gsl_vector_get(current, i));
 		}
 	}
-	printf("\n");
-	fflush(stdout);
+	end_row();
 }
 void command_mulc(int count, gsl_vector * current, char * qualification_source,
 		char * value_str) {
@@ -353,61 +380,41 @@ void command_mulc(int count, gsl_vector * current, char * qualification_source,
 	sscanf(value_str, "%lf", &value);
 	for (i = 0; i < count; i++) {
 		if (qualifies(i, qualification_source)) {
-			printf(outputformat, gsl_vector_get(current, i) * value);
+			output(gsl_vector_get(current, i) * value);
 		} else {
-			printf(outputformat, gsl_vector_get(current, i));
+			output(gsl_vector_get(current, i));
 		}
 	}
-	printf("\n");
-	fflush(stdout);
+	end_row();
 }
 
-void row_man(int argc, char ** argv) {
-	gsl_vector * prev = NULL;
-	gsl_vector * current = NULL;
-	FILE * input = stdin;
-	char buf[10000];
-	int count;
-	int i;
-	int col;
-	int at_whitespace;
-	int line = 0;
+typedef struct {
+	int argc;
+	char ** argv;
+	gsl_vector * prev;
+	gsl_vector * current;
+	int have_prev;
+} row_man_state;
+
+void row_man_block(const double * values, unsigned long nrows,
+		unsigned int ncolumns, int thread, void * state) {
+	row_man_state * s = (row_man_state*) state;
+	int argc = s->argc;
+	char ** argv = s->argv;
 	char * command = argv[1];
-	double v;
-
-	while (!feof(input)) {
-		line++;
-		current = gsl_vector_alloc(300);
-		if (fgets(buf, 10000, input) == NULL || feof(input))
-			break;
-		count = 0;
-		i = 0;
-		at_whitespace = 1;
-		while (buf[i] != 0) {
-			if (isspace(buf[i])) {
-				if (at_whitespace == 0)
-					count++;
-				at_whitespace = 1;
-			} else {
-				if (at_whitespace == 1) {
-					col = sscanf(&buf[i], "%lf", &v);
-					IFDEBUG
-						printf("field %d: %f\n", count, v);
-					gsl_vector_set(current, count, v);
-
-					if (col != 1) {
-						fprintf(stderr,
-								"field could not be read: %d, line %d\n", i
-										+ count, line);
-						exit(1);
-					}
-				}
-				at_whitespace = 0;
-			}
-			i++;
+	int count = ncolumns;
+	gsl_vector * current;
+	unsigned long j;
+	unsigned int i;
+	(void) thread;
+
+	for (j = 0; j < nrows; j++) {
+		current = s->current;
+		for (i = 0; i < ncolumns; i++) {
+			gsl_vector_set(current, i, values[j * ncolumns + i]);
+			IFDEBUG
+				printf("field %d: %f\n", i, gsl_vector_get(current, i));
 		}
-		if (at_whitespace == 0)
-			count++;
 
 		IFDEBUG
 			printf("command: %s; nargs = %d\n", command, argc);
@@ -433,21 +440,35 @@ void row_man(int argc, char ** argv) {
 		else if (0 == strcmp(command, "inva") && argc == 3)
 			command_inva(count, current, argv[2]);
 		else if (0 == strcmp(command, "diff") && argc == 3) {
-			if (prev != NULL) {
-				command_diff(count, prev, current, argv[2]);
-				gsl_vector_free(prev);
-			}
-			prev = current;
-			current = NULL;
+			if (s->have_prev)
+				command_diff(count, s->prev, current, argv[2]);
+			s->current = s->prev;
+			s->prev = current;
+			s->have_prev = 1;
 		} else {
 			fprintf(stderr, "Unknown command\n");
 			usage(argv[0]);
 		}
-		if (current != NULL)
-			gsl_vector_free(current);
-		fflush(stdout);
 	}
+}
+
+void row_man(int argc, char ** argv) {
+	row_man_state s;
+	input_file * input = input_open(NULL);
+
+	s.argc = argc;
+	s.argv = argv;
+	s.prev = gsl_vector_alloc(input_columns(input));
+	s.current = gsl_vector_alloc(input_columns(input));
+	s.have_prev = 0;
 
+	/* parsed in parallel, but the rows are handled in order */
+	input_process(input, row_man_block, &s, 1);
+
+	input_close(input);
+	gsl_vector_free(s.prev);
+	gsl_vector_free(s.current);
+	fflush(stdout);
 }
 
 int main(int argc, char ** argv) {
@@ -461,6 +482,12 @@ int main(int argc, char ** argv) {
 			argc -= 2;
 			argv += 2;
 		}
+		if (argc > 2 && strcmp(argv[1], "-b") == 0) {
+			binary_output = 1;
+
+			argc -= 1;
+			argv += 1;
+		}
 
 		row_man(argc, argv);
 	}
@@ -17,7 +17,9 @@
  */
  
 /**
- * creates a histogram.
+ * measures the features of the distribution of values, like peaks, but
+ * from a summary (t-digest) of the values, so it needs only one pass and
+ * bounded memory.
  */
 
 #include <stdio.h>
@@ -34,76 +36,24 @@
 #include "debug.h"
 #include "utils.h"
 #include "histogram.h"
+#include "tdigest.h"
 
 void usage(char * progname) {
-	fprintf(stderr, "%s: SYNOPSIS: min max file\n"
+	fprintf(stderr, "%s: SYNOPSIS: [-c compression] min max file\n"
 		"\n"
-		"\tfile\tfile containing one row of data\n"
+		"\tfile\tfile containing one row of data (text or binary)\n"
 		"\tmin\tminimal value\n"
 		"\tmax\tmaximum value\n"
+		"\tcompression\taccuracy of the summary (default: %d)\n"
 		"\n"
 		"This program interpretes a histogram from datafiles.\n"
 		"It prints out the median, deviation and probability of "
-		"the features.\n", progname);
+		"the features.\n", progname, TDIGEST_COMPRESSION);
 }
 
-void output_hist(gsl_histogram * h) {
-	double lower;
-	double upper;
-	unsigned int count;
+void run(char * filename, double min, double max, double compression) {
 	unsigned int i;
-
-	for (i = 0; i < gsl_histogram_bins(h); i++) {
-		gsl_histogram_get_range(h, i, &lower, &upper);
-		count = gsl_histogram_get(h, i);
-
-		printf("%f..%f\t:\t%10d\n", lower, upper, count);
-	}
-}
-
-void analyse_part(gsl_histogram * h, unsigned int left, unsigned int right,
-		unsigned long nvalues, double * median, double * leftquartile,
-		double * rightquartile, double * percentage) {
-	unsigned long n = 0;
-	unsigned long c = 0;
-	unsigned int i;
-	double min;
-	double max;
-	for (i = left; i <= right; i++) {
-		n += gsl_histogram_get(h, i);
-	}
-	dump_ul("number of values in this part", n);
-	*percentage = 1.0 * n / nvalues;
-	dump_d("equal to percentage of", *percentage);
-	for (i = left; i <= right; i++) {
-		c += gsl_histogram_get(h, i);
-		gsl_histogram_get_range(h, i, &min, &max);
-		if (c < (right - left) * 1 / 4) {
-			*leftquartile = min;
-		}
-		if (c < (right - left) * 2 / 4) {
-			*median = min;
-		}
-		if (c < (right - left) * 3 / 4) {
-			*rightquartile = min;
-		}
-	}
-	dump_d("leftquartile", *leftquartile);
-	dump_d("median", *median);
-	dump_d("rightquartile", *rightquartile);
-}
-
-
-void run(char * filename, unsigned long nmaxvalues, double min, double max) {
-	unsigned int i;
-	gsl_histogram * h;
-	unsigned int nbins;
-	unsigned long nvalues;
-	unsigned int empty_in_a_row = 0;
-	unsigned int empty_in_a_row_needed;
-	unsigned int left;
-	unsigned int right;
-	double median, leftquartile, rightquartile, percentage;
+	tdigest * t;
 	gsl_vector * medians = gsl_vector_alloc(100);
 	gsl_vector * leftquartiles = gsl_vector_alloc(100);
 	gsl_vector * rightquartiles = gsl_vector_alloc(100);
@@ -115,51 +65,13 @@ void run(char * filename, unsigned long nmaxvalues, double min, double max) {
 	vectors[2] = leftquartiles;
 	vectors[3] = rightquartiles;
 
-	dump_ul("nmaxvalues", nmaxvalues);
-	h = create_hist(nmaxvalues, min, max);
-	append_to_hists(&h, 1, filename);
-	nvalues = gsl_histogram_sum(h);
-	debug("histogram ready!");
-
-	nbins = gsl_histogram_bins(h);
-	dump_ui("nbins", nbins);
+	/* features are separated by 1% of parameter space */
+	t = tdigest_read(filename, min, max, compression, (max - min) / 100);
+	dump_ul("number of centroids", t->n);
+	debug("summary ready!");
 
-	/* 1% of parameter space */
-	empty_in_a_row_needed = nbins / 100;
-
-	dump_ui("nbins", nbins);
-	right = 0;
-	while (1) {
-		left = right;
-		while (left < nbins && (gsl_histogram_get(h, left) == 0))
-			left++;
-		left--;
-		if (left == nbins - 1)
-			break;
-		dump_ui("found left side", left);
-		right = left + 1;
-		for (; right < nbins; right++) {
-			if (gsl_histogram_get(h, right) == 0) {
-				empty_in_a_row++;
-				if (empty_in_a_row > empty_in_a_row_needed)
-					break;
-			} else {
-				empty_in_a_row = 0;
-			}
-		}
-		right--;
-		dump_ui("found right side", right);
-		analyse_part(h, left, right, nvalues, &median, &leftquartile,
-				&rightquartile, &percentage);
-		gsl_vector_set(medians, npeaks, median);
-		gsl_vector_set(leftquartiles, npeaks, leftquartile);
-		gsl_vector_set(rightquartiles, npeaks, rightquartile);
-		gsl_vector_set(percentages, npeaks, percentage);
-		npeaks++;
-
-		if (right == nbins - 1)
-			break;
-	}
+	npeaks = tdigest_features(t, medians->data, leftquartiles->data,
+			rightquartiles->data, percentages->data, medians->size);
 
 #ifndef NOSORT
 	sort(vectors, 4, npeaks);
@@ -173,16 +85,27 @@ void run(char * filename, unsigned long nmaxvalues, double min, double max) {
 				gsl_vector_get(percentages, i));
 	}
 
-	free(h);
+	tdigest_free(t);
+	gsl_vector_free(medians);
+	gsl_vector_free(leftquartiles);
+	gsl_vector_free(rightquartiles);
+	gsl_vector_free(percentages);
 }
 
-/* see usage. nvalues min max file */
+/* see usage. [-c compression] min max file */
 int main(int argc, char ** argv) {
-	if (argc <= 3) {
-		usage(argv[0]);
+	double compression = TDIGEST_COMPRESSION;
+	char * progname = argv[0];
+
+	if (argc > 2 && strcmp(argv[1], "-c") == 0) {
+		compression = atof(argv[2]);
+		argc -= 2;
+		argv += 2;
+	}
+	if (argc <= 3 || compression <= 0) {
+		usage(progname);
 	} else {
-		run(argv[3], countlines(argv[3]), atof(argv[1]), atof(argv[2]));
+		run(argv[3], atof(argv[1]), atof(argv[2]), compression);
 	}
 	return 0;
 }
-
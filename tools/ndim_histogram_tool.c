@@ -35,63 +35,115 @@
 #include "debug.h"
 #include "utils.h"
 #include "histogram.h"
+#include "input.h"
 
+/**
+ * Only the occupied cells are stored, in a hash table with open addressing.
+ * The key of a cell is the Morton code of its bin numbers (the bits of the
+ * dimensions interleaved).
+ */
 typedef struct {
-	long * values;
+	unsigned long * keys;
+	/** a count of 0 marks a free slot */
+	long * counts;
+	/** a power of two */
+	unsigned long capacity;
+	unsigned long used;
 	/* minima */
 	gsl_vector * min;
 	/* maxima */
 	gsl_vector * max;
 	unsigned int nbins;
-	unsigned int size;
+	/** bits per dimension in the key */
+	unsigned int bits;
 	unsigned int dimensions;
 } ndim_histogram;
 
-int get_index_for(ndim_histogram * h, gsl_vector * value) {
+unsigned int get_bin_for(ndim_histogram * h, unsigned int i, double value) {
+	double bin = (h->nbins - 1) * ((value - gsl_vector_get(h->min, i))
+			/ (gsl_vector_get(h->max, i) - gsl_vector_get(h->min, i)));
+	if (!(bin >= 0))
+		return 0;
+	if (bin > h->nbins - 1)
+		return h->nbins - 1;
+	return (unsigned int) bin;
+}
+
+unsigned long get_key_for_bins(ndim_histogram * h, const unsigned int * bins) {
+	unsigned int b;
+	unsigned int i;
+	unsigned long key = 0;
+
+	for (b = 0; b < h->bits; b++) {
+		for (i = 0; i < h->dimensions; i++) {
+			key |= (unsigned long) ((bins[i] >> b) & 1) << (b * h->dimensions
+					+ i);
+		}
+	}
+	return key;
+}
+
+void get_bins_for_key(ndim_histogram * h, unsigned long key,
+		unsigned int * bins) {
+	unsigned int b;
+	unsigned int i;
+
+	for (i = 0; i < h->dimensions; i++)
+		bins[i] = 0;
+	for (b = 0; b < h->bits; b++) {
+		for (i = 0; i < h->dimensions; i++) {
+			bins[i] |= ((key >> (b * h->dimensions + i)) & 1) << b;
+		}
+	}
+}
+
+unsigned long get_key_for(ndim_histogram * h, const double * value) {
+	unsigned int bins[sizeof(unsigned long) * 8];
 	unsigned int i;
-	unsigned int index = 0;
-	unsigned int subindex;
 
-	assert(value->size == h->dimensions);
 	for (i = 0; i < h->dimensions; i++) {
-		subindex = (h->nbins - 1) * ((gsl_vector_get(value, i)
-				- gsl_vector_get(h->min, i)) / (gsl_vector_get(h->max, i)
-				- gsl_vector_get(h->min, i)));
-		index = index * h->nbins + subindex;
+		bins[i] = get_bin_for(h, i, value[i]);
 	}
-	return index;
+	return get_key_for_bins(h, bins);
 }
 
-gsl_vector * get_lower_corner_for_index(ndim_histogram * h, unsigned int index) {
-	int subindex;
-	int i;
+gsl_vector * get_lower_corner_for_bins(ndim_histogram * h,
+		const unsigned int * bins) {
+	unsigned int i;
 	gsl_vector * lower = gsl_vector_alloc(h->dimensions);
 
-	for (i = h->dimensions - 1; i >= 0; i--) {
-		subindex = index % h->nbins;
-		gsl_vector_set(lower, i, subindex * (gsl_vector_get(h->max, i)
+	for (i = 0; i < h->dimensions; i++) {
+		gsl_vector_set(lower, i, bins[i] * (gsl_vector_get(h->max, i)
 				- gsl_vector_get(h->min, i)) / (h->nbins - 1) + gsl_vector_get(
 				h->min, i));
-		index /= h->nbins;
 	}
 	return lower;
 }
 
-gsl_vector * get_upper_corner_for_index(ndim_histogram * h, unsigned int index) {
-	int subindex;
-	int i;
+gsl_vector * get_upper_corner_for_bins(ndim_histogram * h,
+		const unsigned int * bins) {
+	unsigned int i;
 	gsl_vector * upper = gsl_vector_alloc(h->dimensions);
 
-	for (i = h->dimensions - 1; i >= 0; i--) {
-		subindex = index % h->nbins;
-		gsl_vector_set(upper, i, (subindex + 1) * (gsl_vector_get(h->max, i)
+	for (i = 0; i < h->dimensions; i++) {
+		gsl_vector_set(upper, i, (bins[i] + 1) * (gsl_vector_get(h->max, i)
 				- gsl_vector_get(h->min, i)) / (h->nbins - 1) + gsl_vector_get(
 				h->min, i));
-		index /= h->nbins;
 	}
 	return upper;
 }
 
+void ndim_histogram_allocate_table(ndim_histogram * h, unsigned long capacity) {
+	h->capacity = capacity;
+	h->used = 0;
+	h->keys = (unsigned long*) malloc(capacity * sizeof(unsigned long));
+	h->counts = (long*) calloc(capacity, sizeof(long));
+	if (h->keys == NULL || h->counts == NULL) {
+		perror("could not allocate that much");
+		exit(1);
+	}
+}
+
 ndim_histogram * ndim_histogram_alloc(unsigned int nbins, gsl_vector * min,
 		gsl_vector * max) {
 	ndim_histogram * h;
@@ -103,92 +155,234 @@ ndim_histogram * ndim_histogram_alloc(unsigned int nbins, gsl_vector * min,
 	h->nbins = nbins;
 	assert(min->size == max->size);
 	h->dimensions = min->size;
-	if (pow(h->nbins, h->dimensions) > INT_MAX) {
-		printf("I can not make %e cubes. choose less bins.\n", pow(h->nbins,
-				h->dimensions));
-		printf("Maximum: %d^%e, %d\n", INT_MAX, (1 / (double) h->dimensions),
-				(int) pow((double) INT_MAX, 1 / (double) h->dimensions));
-		exit(1);
-	}
-	h->size = pow(h->nbins, h->dimensions);
-
-	dump_i("used size", h->size);
-
-	h->values = (long*) calloc(h->size, sizeof(long));
-	if (h->values == NULL) {
-		perror("could not allocate that much");
+	for (h->bits = 1; (1UL << h->bits) < nbins; h->bits++)
+		;
+	if (h->bits * h->dimensions > sizeof(unsigned long) * 8) {
+		printf("I can not number %d^%d cubes. choose less bins.\n", nbins,
+				h->dimensions);
+		printf("Maximum: %d bits for %d dimensions\n",
+				(int) sizeof(unsigned long) * 8, h->dimensions);
 		exit(1);
-	} else {
-		debug("allocating succeeded.");
 	}
+	dump_i("bits per dimension", h->bits);
 
+	ndim_histogram_allocate_table(h, 1024);
 	return h;
 }
+
 void ndim_histogram_free(ndim_histogram * h) {
-	free(h->values);
+	free(h->keys);
+	free(h->counts);
 	free(h);
 }
 
-void ndim_histogram_increment(ndim_histogram * h, gsl_vector * current) {
-	h->values[get_index_for(h, current)]++;
+unsigned long ndim_histogram_slot(ndim_histogram * h, unsigned long key) {
+	unsigned long slot = key;
+
+	/* spread the bits (murmur3 finalizer) */
+	slot ^= slot >> 16;
+	slot *= 0x85ebca6bUL;
+	slot ^= slot >> 13;
+	slot *= 0xc2b2ae35UL;
+	slot ^= slot >> 16;
+	slot &= h->capacity - 1;
+	while (h->counts[slot] != 0 && h->keys[slot] != key)
+		slot = (slot + 1) & (h->capacity - 1);
+	return slot;
 }
 
-long ndim_histogram_get(ndim_histogram * h, int index) {
-	return h->values[index];
+void ndim_histogram_add(ndim_histogram * h, unsigned long key, long count) {
+	unsigned long slot;
+	unsigned long * old_keys;
+	long * old_counts;
+	unsigned long old_capacity;
+	unsigned long i;
+
+	if (10 * (h->used + 1) > 7 * h->capacity) {
+		old_keys = h->keys;
+		old_counts = h->counts;
+		old_capacity = h->capacity;
+		ndim_histogram_allocate_table(h, 2 * old_capacity);
+		for (i = 0; i < old_capacity; i++) {
+			if (old_counts[i] != 0)
+				ndim_histogram_add(h, old_keys[i], old_counts[i]);
+		}
+		free(old_keys);
+		free(old_counts);
+	}
+	slot = ndim_histogram_slot(h, key);
+	if (h->counts[slot] == 0) {
+		h->keys[slot] = key;
+		h->used++;
+	}
+	h->counts[slot] += count;
 }
 
-void append_to_hist(ndim_histogram * h, const char * filename) {
-	FILE * input;
-	unsigned int i;
-	int col;
-	double v;
-	int line = 0;
-	gsl_vector * current = gsl_vector_alloc(h->dimensions);
+void ndim_histogram_increment(ndim_histogram * h, const double * current) {
+	ndim_histogram_add(h, get_key_for(h, current), 1);
+}
 
-	input = openfile(filename);
-	while (!feof(input)) {
-		for (i = 0; i < h->dimensions; i++) {
-			col = fscanf(input, "%lf", &v);
-			if (col != 1) {
-				if (feof(input))
-					break;
-				fprintf(stderr, "field could not be read: %d, line %d in %s\n",
-						i + 1, line + 1, filename);
-				exit(1);
-			}
-			gsl_vector_set(current, i, v);
-		}
-		ndim_histogram_increment(h, current);
-		line++;
+long ndim_histogram_get(ndim_histogram * h, unsigned long key) {
+	return h->counts[ndim_histogram_slot(h, key)];
+}
+
+/**
+ * adds the counts of b to a and frees b.
+ */
+void ndim_histogram_merge(ndim_histogram * a, ndim_histogram * b) {
+	unsigned long i;
+	for (i = 0; i < b->capacity; i++) {
+		if (b->counts[i] != 0)
+			ndim_histogram_add(a, b->keys[i], b->counts[i]);
 	}
-	dump_i("read lines", line);
-	fclose(input);
+	ndim_histogram_free(b);
 }
 
-void output_hist(ndim_histogram * h) {
+/**
+ * marginal distribution over the given dimensions
+ */
+ndim_histogram * ndim_histogram_project(ndim_histogram * h,
+		const unsigned int * dimensions, unsigned int n) {
+	unsigned int bins[sizeof(unsigned long) * 8];
+	unsigned int projected_bins[sizeof(unsigned long) * 8];
+	unsigned long i;
+	unsigned int j;
+	gsl_vector * min = gsl_vector_alloc(n);
+	gsl_vector * max = gsl_vector_alloc(n);
+	ndim_histogram * p;
+
+	for (j = 0; j < n; j++) {
+		gsl_vector_set(min, j, gsl_vector_get(h->min, dimensions[j]));
+		gsl_vector_set(max, j, gsl_vector_get(h->max, dimensions[j]));
+	}
+	p = ndim_histogram_alloc(h->nbins, min, max);
+	for (i = 0; i < h->capacity; i++) {
+		if (h->counts[i] == 0)
+			continue;
+		get_bins_for_key(h, h->keys[i], bins);
+		for (j = 0; j < n; j++)
+			projected_bins[j] = bins[dimensions[j]];
+		ndim_histogram_add(p, get_key_for_bins(p, projected_bins),
+				h->counts[i]);
+	}
+	return p;
+}
+
+typedef struct {
+	/** one histogram per thread */
+	ndim_histogram ** hists;
+} fill_state;
+
+void fill_block(const double * values, unsigned long nrows,
+		unsigned int ncolumns, int thread, void * state) {
+	fill_state * s = (fill_state*) state;
+	unsigned long j;
+
+	for (j = 0; j < nrows; j++) {
+		ndim_histogram_increment(s->hists[thread], &values[j * ncolumns]);
+	}
+}
+
+void append_to_hist(ndim_histogram * h, const char * filename) {
+	input_file * input;
+	fill_state s;
+	unsigned long lines;
+	int t;
+	const int n_threads = input_max_threads();
+
+	s.hists = (ndim_histogram**) calloc(n_threads, sizeof(ndim_histogram*));
+	assert(s.hists != NULL);
+	s.hists[0] = h;
+	for (t = 1; t < n_threads; t++)
+		s.hists[t] = ndim_histogram_alloc(h->nbins, h->min, h->max);
+
+	input = input_open(filename);
+	lines = input_process(input, fill_block, &s, 0);
+	input_close(input);
+	dump_ul("read lines", lines);
+
+	for (t = 1; t < n_threads; t++)
+		ndim_histogram_merge(h, s.hists[t]);
+	free(s.hists);
+	dump_ul("occupied cells", h->used);
+}
+
+/** bin numbers of the occupied cells, for sorting */
+static const unsigned int * sort_bins;
+static unsigned int sort_dimensions;
+
+int compare_cells(const void * av, const void * bv) {
+	const unsigned int * a = &sort_bins[*(const unsigned long*) av
+			* sort_dimensions];
+	const unsigned int * b = &sort_bins[*(const unsigned long*) bv
+			* sort_dimensions];
 	unsigned int i;
-	long value;
+	for (i = 0; i < sort_dimensions; i++) {
+		if (a[i] != b[i])
+			return a[i] < b[i] ? -1 : 1;
+	}
+	return 0;
+}
 
-	for (i = 0; i < h->size; i++) {
-		value = ndim_histogram_get(h, i);
-		if (value == 0)
+void output_hist(ndim_histogram * h) {
+	unsigned long i;
+	unsigned long n = 0;
+	unsigned long * order = (unsigned long*) malloc(h->used
+			* sizeof(unsigned long));
+	unsigned int * bins = (unsigned int*) malloc(h->used * h->dimensions
+			* sizeof(unsigned int));
+	long * counts = (long*) malloc(h->used * sizeof(long));
+	gsl_vector * lower;
+	gsl_vector * upper;
+
+	assert(order != NULL && bins != NULL && counts != NULL);
+	for (i = 0; i < h->capacity; i++) {
+		if (h->counts[i] == 0)
 			continue;
-		dump_vector(get_lower_corner_for_index(h, i));
+		get_bins_for_key(h, h->keys[i], &bins[n * h->dimensions]);
+		counts[n] = h->counts[i];
+		order[n] = n;
+		n++;
+	}
+	/* the cells are printed in the same order as the dense cube had */
+	sort_bins = bins;
+	sort_dimensions = h->dimensions;
+	qsort(order, n, sizeof(unsigned long), compare_cells);
+
+	for (i = 0; i < n; i++) {
+		lower = get_lower_corner_for_bins(h, &bins[order[i] * h->dimensions]);
+		upper = get_upper_corner_for_bins(h, &bins[order[i] * h->dimensions]);
+		dump_vector(lower);
 		printf("..");
-		dump_vector(get_upper_corner_for_index(h, i));
-		printf("\t%lu\n", value);
+		dump_vector(upper);
+		printf("\t%lu\n", counts[order[i]]);
+		gsl_vector_free(lower);
+		gsl_vector_free(upper);
 	}
+	free(order);
+	free(bins);
+	free(counts);
 }
 
-void run(unsigned int nbins, char * filename) {
+void run(unsigned int nbins, char * filename, const unsigned int * projection,
+		unsigned int nprojection) {
 	gsl_vector * min;
 	gsl_vector * max;
 	ndim_histogram * h;
+	ndim_histogram * p;
 	unsigned int ncolumns;
+	unsigned int i;
 
 	debug("looking for number of columns ...");
-	ncolumns = get_column_count(filename);
+	ncolumns = input_column_count(filename);
 	dump_i("number of columns", ncolumns);
+	for (i = 0; i < nprojection; i++) {
+		if (projection[i] >= ncolumns) {
+			fprintf(stderr, "there is no column %d in %s\n", projection[i]
+					+ 1, filename);
+			exit(1);
+		}
+	}
 	min = gsl_vector_alloc(ncolumns);
 	max = gsl_vector_alloc(ncolumns);
 
@@ -203,28 +397,72 @@ void run(unsigned int nbins, char * filename) {
 	debug("filling histogram ... ");
 	append_to_hist(h, filename);
 
-	output_hist(h);
+	if (nprojection > 0) {
+		p = ndim_histogram_project(h, projection, nprojection);
+		output_hist(p);
+		gsl_vector_free(p->min);
+		gsl_vector_free(p->max);
+		ndim_histogram_free(p);
+	} else {
+		output_hist(h);
+	}
 	ndim_histogram_free(h);
+	gsl_vector_free(min);
+	gsl_vector_free(max);
 }
 
 void usage(char * progname) {
 	fprintf(
 			stderr,
-			"%s: SYNOPSIS: nbins file...\n"
+			"%s: SYNOPSIS: [-p columns] nbins file...\n"
 				"\n"
+				"\tcolumns\tonly output the marginal distribution of these columns,\n"
+				"\t\te.g. 1,3 (counted from 1)\n"
 				"\tnbins\tNumber of bins to use for each dimension\n"
 				"\tfile\tfile to include. these should contain float values in one or more rows\n"
 				"\n"
-				"This program calculates a n-dimensional histogram cube from datafiles.\n",
+				"This program calculates a n-dimensional histogram cube from datafiles.\n"
+				"Only bins that contain values are stored and printed.\n",
 			progname);
 }
 
+/**
+ * parses a list like 1,3 into 0-based column numbers
+ * @return number of columns
+ */
+unsigned int parse_projection(char * list, unsigned int * projection) {
+	unsigned int n = 0;
+	char * next;
+	long column;
+
+	while (*list != 0) {
+		column = strtol(list, &next, 10);
+		if (next == list || column < 1 || n == sizeof(unsigned long) * 8) {
+			fprintf(stderr, "invalid column list: %s\n", list);
+			exit(1);
+		}
+		projection[n++] = column - 1;
+		list = next;
+		if (*list == ',')
+			list++;
+	}
+	return n;
+}
+
 int main(int argc, char ** argv) {
+	unsigned int projection[sizeof(unsigned long) * 8];
+	unsigned int nprojection = 0;
+	char * progname = argv[0];
+
+	if (argc == 5 && strcmp(argv[1], "-p") == 0) {
+		nprojection = parse_projection(argv[2], projection);
+		argc -= 2;
+		argv += 2;
+	}
 	if (argc != 3) {
-		usage(argv[0]);
+		usage(progname);
 	} else {
-		run(atoi(argv[1]), argv[2]);
+		run(atoi(argv[1]), argv[2], projection, nprojection);
 	}
 	return 0;
 }
-
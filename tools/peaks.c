@@ -40,17 +40,22 @@
 #include "debug.h"
 #include "utils.h"
 #include "histogram.h"
+#include "input.h"
+#include "tdigest.h"
 
 void usage(char * progname) {
-	fprintf(stderr, "%s: SYNOPSIS: min max file\n"
+	fprintf(stderr, "%s: SYNOPSIS: [-c compression] min max file\n"
 		"\n"
-		"\tfile\tfile containing one row of data\n"
+		"\tfile\tfile containing one row of data (text or binary)\n"
 		"\tmin\tminimal value\n"
 		"\tmax\tmaximum value\n"
+		"\tcompression\tdo not sort all values, but summarize them in one\n"
+		"\t\tpass with bounded memory. Higher values are more accurate\n"
+		"\t\t(0: %d).\n"
 		"\n"
 		"This program interpretes a histogram from datafiles.\n"
 		"It prints out the median, deviation and probability of "
-		"the features.\n", progname);
+		"the features.\n", progname, TDIGEST_COMPRESSION);
 }
 
 void analyse_part(gsl_vector * v, unsigned int left, unsigned int right,
@@ -79,35 +84,86 @@ void analyse_part(gsl_vector * v, unsigned int left, unsigned int right,
 	dump_d("rightquartile", *rightquartile);
 }
 
-unsigned int fill_vector(gsl_vector * values, char * filename, double min,
-		double max) {
-	FILE * input;
-	int col;
-	double v;
-	int line = 0;
-	unsigned int i = 0;
+typedef struct {
+	/** values within min and max found by each thread */
+	double ** values;
+	unsigned long * nvalues;
+	unsigned long * sizes;
+	double min;
+	double max;
+} fill_state;
 
-	input = openfile(filename);
+void fill_block(const double * values, unsigned long nrows,
+		unsigned int ncolumns, int thread, void * state) {
+	fill_state * s = (fill_state*) state;
+	/* work on copies, the arrays are shared between threads */
+	double * kept = s->values[thread];
+	unsigned long n = s->nvalues[thread];
+	unsigned long size = s->sizes[thread];
+	unsigned long j;
+	double v;
 
-	while (!feof(input)) {
-		col = fscanf(input, "%lf", &v);
-		if (col != 1) {
-			if (feof(input))
-				break;
-			fprintf(stderr, "field could not be read: %d, line %d in %s\n", i
-					+ 1, line + 1, filename);
-			exit(1);
-		}
-		if (v >= min && v <= max) {
-			gsl_vector_set(values, i, v);
-			i++;
+	for (j = 0; j < nrows * ncolumns; j++) {
+		v = values[j];
+		if (v >= s->min && v <= s->max) {
+			if (n == size) {
+				size = size * 2 + 1024;
+				kept = (double*) realloc(kept, size * sizeof(double));
+				assert(kept != NULL);
+			}
+			kept[n++] = v;
 		}
-		line++;
 	}
-	dump_i("read lines", line);
-	dump_i("accepted lines", i);
-	fclose(input);
-	return i;
+	s->values[thread] = kept;
+	s->nvalues[thread] = n;
+	s->sizes[thread] = size;
+}
+
+/**
+ * @return all values of the file within min and max, in no particular order
+ */
+gsl_vector * fill_vector(char * filename, double min, double max) {
+	input_file * input;
+	fill_state s;
+	unsigned long lines;
+	unsigned long n = 0;
+	int t;
+	const int n_threads = input_max_threads();
+	gsl_vector * values;
+
+	s.min = min;
+	s.max = max;
+	s.values = (double**) calloc(n_threads, sizeof(double*));
+	s.nvalues = (unsigned long*) calloc(n_threads, sizeof(unsigned long));
+	s.sizes = (unsigned long*) calloc(n_threads, sizeof(unsigned long));
+	assert(s.values != NULL && s.nvalues != NULL && s.sizes != NULL);
+
+	input = input_open(filename);
+	lines = input_process(input, fill_block, &s, 0);
+	input_close(input);
+
+	for (t = 0; t < n_threads; t++)
+		n += s.nvalues[t];
+	dump_ul("read lines", lines);
+	dump_ul("accepted values", n);
+	if (n == 0) {
+		fprintf(stderr, "no values between %f and %f in %s\n", min, max,
+				filename);
+		exit(1);
+	}
+	values = gsl_vector_alloc(n);
+	n = 0;
+	for (t = 0; t < n_threads; t++) {
+		if (s.nvalues[t] > 0)
+			memcpy(values->data + n, s.values[t], s.nvalues[t]
+					* sizeof(double));
+		n += s.nvalues[t];
+		free(s.values[t]);
+	}
+	free(s.values);
+	free(s.nvalues);
+	free(s.sizes);
+	return values;
 }
 
 int double_comp(const void * av, const void * bv) {
@@ -121,28 +177,20 @@ int double_comp(const void * av, const void * bv) {
 		return 1;
 }
 
-void run(char * filename, unsigned long nmaxvalues, double min, double max) {
-	unsigned int i;
+unsigned int find_peaks_sorted(char * filename, double min, double max,
+		gsl_vector * medians, gsl_vector * leftquartiles,
+		gsl_vector * rightquartiles, gsl_vector * percentages) {
 	unsigned int nvalues;
 	double empty_space_needed;
 	unsigned int left;
 	unsigned int right;
 	double median = 0, leftquartile = 0, rightquartile = 0, percentage = 0;
-	gsl_vector * values = gsl_vector_alloc(nmaxvalues);
-	gsl_vector * medians = gsl_vector_alloc(100);
-	gsl_vector * leftquartiles = gsl_vector_alloc(100);
-	gsl_vector * rightquartiles = gsl_vector_alloc(100);
-	gsl_vector * percentages = gsl_vector_alloc(100);
-	gsl_vector * vectors[4];
+	gsl_vector * values;
 	unsigned int npeaks = 0;
-	vectors[0] = percentages;
-	vectors[1] = medians;
-	vectors[2] = leftquartiles;
-	vectors[3] = rightquartiles;
 
-	dump_ul("nmaxvalues", nmaxvalues);
-	nvalues = fill_vector(values, filename, min, max);
-	dump_ul("nvalues", nmaxvalues);
+	values = fill_vector(filename, min, max);
+	nvalues = values->size;
+	dump_ui("nvalues", nvalues);
 	debug("data ready!");
 	qsort(values->data, nvalues, sizeof(double), double_comp);
 	debug("data sorted!");
@@ -187,6 +235,52 @@ void run(char * filename, unsigned long nmaxvalues, double min, double max) {
 			break;
 		left = right + 1;
 	}
+	gsl_vector_free(values);
+	return npeaks;
+}
+
+/**
+ * like find_peaks_sorted, but in one pass and bounded memory with a t-digest
+ */
+unsigned int find_peaks_sketch(char * filename, double min, double max,
+		double compression, gsl_vector * medians, gsl_vector * leftquartiles,
+		gsl_vector * rightquartiles, gsl_vector * percentages) {
+	unsigned int npeaks;
+	/* 1% of parameter space */
+	tdigest * t = tdigest_read(filename, min, max, compression, (max - min)
+			/ 100);
+
+	dump_ul("number of centroids", t->n);
+	if (t->n == 0) {
+		fprintf(stderr, "no values between %f and %f in %s\n", min, max,
+				filename);
+		exit(1);
+	}
+	npeaks = tdigest_features(t, medians->data, leftquartiles->data,
+			rightquartiles->data, percentages->data, medians->size);
+	tdigest_free(t);
+	return npeaks;
+}
+
+void run(char * filename, double min, double max, double compression) {
+	unsigned int i;
+	gsl_vector * medians = gsl_vector_alloc(100);
+	gsl_vector * leftquartiles = gsl_vector_alloc(100);
+	gsl_vector * rightquartiles = gsl_vector_alloc(100);
+	gsl_vector * percentages = gsl_vector_alloc(100);
+	gsl_vector * vectors[4];
+	unsigned int npeaks = 0;
+	vectors[0] = percentages;
+	vectors[1] = medians;
+	vectors[2] = leftquartiles;
+	vectors[3] = rightquartiles;
+
+	if (compression > 0)
+		npeaks = find_peaks_sketch(filename, min, max, compression, medians,
+				leftquartiles, rightquartiles, percentages);
+	else
+		npeaks = find_peaks_sorted(filename, min, max, medians,
+				leftquartiles, rightquartiles, percentages);
 
 #ifndef NOSORT
 	sort(vectors, 4, npeaks);
@@ -200,20 +294,28 @@ void run(char * filename, unsigned long nmaxvalues, double min, double max) {
 				gsl_vector_get(percentages, i));
 	}
 
-	gsl_vector_free(values);
 	gsl_vector_free(medians);
 	gsl_vector_free(leftquartiles);
 	gsl_vector_free(rightquartiles);
 	gsl_vector_free(percentages);
 }
 
-/* see usage. nvalues min max file */
+/* see usage. [-c compression] min max file */
 int main(int argc, char ** argv) {
+	double compression = 0;
+	char * progname = argv[0];
+
+	if (argc > 2 && strcmp(argv[1], "-c") == 0) {
+		compression = atof(argv[2]);
+		if (compression <= 0)
+			compression = TDIGEST_COMPRESSION;
+		argc -= 2;
+		argv += 2;
+	}
 	if (argc <= 3) {
-		usage(argv[0]);
+		usage(progname);
 	} else {
-		run(argv[3], countlines(argv[3]), atof(argv[1]), atof(argv[2]));
+		run(argv[3], atof(argv[1]), atof(argv[2]), compression);
 	}
 	return 0;
 }
-
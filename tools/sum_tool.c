@@ -12,6 +12,7 @@
 #include "debug.h"
 #include "histogram.h"
 #include "utils.h"
+#include "input.h"
 
 void usage(char * progname) {
 	fprintf(stderr, "%s: SYNOPSIS: [-s] [-1] file1 file2 ...\n"
@@ -20,37 +21,67 @@ void usage(char * progname) {
 		"\t1\tat the end, sum all columns up to one value\n"
 		"\n"
 		"This program sums up the values of the given files. They should contain \n"
-		"float values in one or more columns\n"
+		"float values in one or more columns (text or binary)\n"
 		"\n", progname);
 }
 
-void sum_up(gsl_vector * sum, unsigned int n, const char * filename, int square) {
-	FILE * input;
+typedef struct {
+	/** sums of each thread, stride apart */
+	double * sums;
+	unsigned int stride;
+	int square;
+} sum_state;
+
+void sum_block(const double * values, unsigned long nrows,
+		unsigned int ncolumns, int thread, void * state) {
+	sum_state * s = (sum_state*) state;
+	double * sum = &s->sums[thread * s->stride];
+	unsigned long j;
 	unsigned int i;
-	int col;
 	double v;
-	int line = 0;
 
-	input = openfile(filename);
-	while (!feof(input)) {
-		for (i = 0; i < n; i++) {
-			col = fscanf(input, "%lf", &v);
-			if (col != 1) {
-				if (feof(input))
-					break;
-				fprintf(stderr, "field could not be read: %d, line %d in %s\n",
-						i + 1, line + 1, filename);
-				exit(1);
-			}
-			if (square)
-				gsl_vector_add_constant(sum, v * v);
+	for (j = 0; j < nrows; j++) {
+		for (i = 0; i < ncolumns; i++) {
+			v = values[j * ncolumns + i];
+			if (s->square)
+				sum[i] += v * v;
 			else
-				gsl_vector_add_constant(sum, v);
+				sum[i] += v;
+		}
+	}
+}
+
+void sum_up(gsl_vector * sum, unsigned int n, const char * filename, int square) {
+	input_file * input;
+	sum_state s;
+	unsigned long lines;
+	unsigned int i;
+	int t;
+	const int n_threads = input_max_threads();
+
+	input = input_open(filename);
+	if (input_columns(input) != n) {
+		fprintf(stderr, "expected %d columns, got %d in %s\n", n,
+				input_columns(input), filename);
+		exit(1);
+	}
+	/* keep the sums of different threads in different cache lines */
+	s.stride = n + 8;
+	s.square = square;
+	s.sums = (double*) calloc(n_threads * s.stride, sizeof(double));
+	assert(s.sums != NULL);
+
+	lines = input_process(input, sum_block, &s, 0);
+	dump_ul("read lines", lines);
+	input_close(input);
+
+	for (t = 0; t < n_threads; t++) {
+		for (i = 0; i < n; i++) {
+			gsl_vector_set(sum, i, gsl_vector_get(sum, i) + s.sums[t * s.stride
+					+ i]);
 		}
-		line++;
 	}
-	dump_i("read lines", line);
-	fclose(input);
+	free(s.sums);
 }
 
 void run(char ** filenames, unsigned int filecount, int square, int one_value) {
@@ -59,12 +90,12 @@ void run(char ** filenames, unsigned int filecount, int square, int one_value) {
 	unsigned int ncolumns;
 
 	debug("looking for number of columns ...");
-	ncolumns = get_column_count(filenames[0]);
+	ncolumns = input_column_count(filenames[0]);
 	dump_i("number of columns", ncolumns);
 	sum = gsl_vector_alloc(ncolumns);
 	gsl_vector_set_zero(sum);
 
-	debug("filling histograms ... ");
+	debug("summing up ... ");
 	for (i = 0; i < filecount; i++) {
 		dump_s("with file", filenames[i]);
 		sum_up(sum, ncolumns, filenames[i], square);